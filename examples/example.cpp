@@ -1,4 +1,6 @@
 #include <gpuip.h>
+#include <gpuip_io.h>
+#include <vector>
 
 void print_timings(const char * func_name, double ms, std::string * err)
 {
@@ -12,9 +14,14 @@ void print_timings(const char * func_name, double ms, std::string * err)
 void use_gpuip()
 {
     std::string err;
-    float * data;
-    unsigned int width, height;
-    ReadImage(&data, &width, &height); // definied somewhere else
+    gpuip::io::ImageReader reader;
+    if (!reader.Open("input.exr", &err)) {
+        // ... deal with error - throw exception, return function etc
+    }
+    const unsigned int width = reader.Width();
+    const unsigned int height = reader.Height();
+    std::vector<float> data(width * height * 4);
+    reader.Read(&data[0], gpuip::Buffer::FLOAT, 4, &err);
 
     if (!gpuip::ImageProcessor::CanCreateGpuEnvironment(gpuip::GLSL)) {
         // ... deal with error - throw exception, return function etc
@@ -30,7 +37,7 @@ void use_gpuip()
     kernel->paramsFloat.push_back(gpuip::Parameter<float>("alpha", 0.4));
     print_timings("Build", ip->Build(&err), &err);
     print_timings("Allocate", ip->Allocate(&err), &err);
-    print_timings("Copy", ip->Copy(b0, gpuip::Buffer::COPY_TO_GPU, data, &err), &err);
+    print_timings("Copy", ip->Copy(b0, gpuip::Buffer::COPY_TO_GPU, &data[0], &err), &err);
     print_timings("Run", ip->Run(&err), &err);
-    print_timings("Copy", ip->Copy(b1, gpuip::Buffer::COPY_FROM_GPU, data, &err), &err);
+    print_timings("Copy", ip->Copy(b1, gpuip::Buffer::COPY_FROM_GPU, &data[0], &err), &err);
 }
@@ -131,6 +131,12 @@ def runCommandLine(ipsettings, verbose):
             timeStr = utils.getTimeStr() if time else ""
             print timeStr + text + " " + stopwatchStr
 
+    def device_time(ip):
+        timing = ip.timing
+        kernels = ", ".join("%s %.2f ms" % k for k in timing.kernels)
+        return "(device %.2f ms%s)" % (timing.time,
+                                       " [%s]" % kernels if kernels else "")
+
     overall_clock = utils.StopWatch()
 
     ### 0. Create gpuip items from settings
@@ -140,7 +146,8 @@ def runCommandLine(ipsettings, verbose):
     ### 1. Build
     c = utils.StopWatch()
     check_error(ip.Build())
-    log("Building kernels [%s]." %  [k.name for k in kernels], c)
+    log("Building kernels [%s] %s." % ([k.name for k in kernels],
+                                        device_time(ip)), c)
     
     ### 2. Import data from images
     c = utils.StopWatch()
@@ -155,7 +162,7 @@ def runCommandLine(ipsettings, verbose):
     width, height = utils.allocateBufferData(buffers)
     ip.SetDimensions(width, height)
     check_error(ip.Allocate())
-    log("Allocating done.", c)
+    log("Allocating done %s." % device_time(ip), c)
     c = utils.StopWatch()
     for b in ipsettings.buffers:
         if b.input:
@@ -165,7 +172,7 @@ def runCommandLine(ipsettings, verbose):
     ### 4. Process
     c = utils.StopWatch()
     check_error(ip.Run())
-    log("Processing done.", c)
+    log("Processing done %s." % device_time(ip), c)
 
     ### 5. Export buffers to images
     c = utils.StopWatch()
@@ -173,9 +180,13 @@ def runCommandLine(ipsettings, verbose):
         if b.output:
             log("Exporting data from %s to %s" %(b.name, b.output))
             check_error(ip.ReadBufferFromGPU(buffers[b.name]))
-            check_error(buffers[b.name].Write(b.output,utils.getNumCores()))
+            check_error(buffers[b.name].Write(b.output, utils.getNumCores(),
+                                              [], b.exrOptions()))
     log("Exporting data done.", c)
 
+    stats = ip.stats
+    log("Device time: upload %.2f ms, run %.2f ms, download %.2f ms." %
+        (stats.uploadTime, stats.runTime, stats.downloadTime), time = False)
     log("\nAll steps done. Total runtime:", overall_clock, time = False)
 
 if __name__ == "__main__":
@@ -182,7 +182,8 @@ class MainWindow(QtGui.QMainWindow):
         clock = utils.StopWatch()
         err = self.ip.Build()
         if not err:
-            self.logSuccess("All kernels were built.", clock)
+            self.logSuccess("All kernels were built (device %.2f ms)." %
+                            self.ip.timing.time, clock)
             self.needsBuild = False
             return True
         else:
@@ -224,7 +225,8 @@ class MainWindow(QtGui.QMainWindow):
             self.logError(err)
             return False
         else:
-            self.logSuccess("All buffers were allocated.", clock)
+            self.logSuccess("All buffers were allocated (device %.2f ms)." %
+                            self.ip.timing.time, clock)
             self.needsAllocate = False
 
         clock = utils.StopWatch()
@@ -259,7 +261,8 @@ class MainWindow(QtGui.QMainWindow):
             self.logError(err)
             return False
 
-        self.logSuccess("All kernels processed.", clock)
+        self.logSuccess("All kernels processed (device %.2f ms)." %
+                        self.ip.timing.time, clock)
 
         clock = utils.StopWatch()
         for b in self.buffers:
@@ -279,7 +282,8 @@ class MainWindow(QtGui.QMainWindow):
             if b.output:
                 self.log("Exporting data from buffer <i>%s</i> to <i>%s</i>." \
                          % (b.name, b.output))
-                err = self.buffers[b.name].Write(b.output, utils.getNumCores())
+                err = self.buffers[b.name].Write(b.output, utils.getNumCores(),
+                                                 [], b.exrOptions())
                 if err:
                     self.logError(err)
                     return False
@@ -12,6 +12,21 @@ class Settings(object):
             self.channels = channels
             self.input = ""
             self.output = ""
+            self.compression = ""
+            self.lineorder = ""
+            self.chunkrows = ""
+
+        def exrOptions(self):
+            options = pygpuip.ExrOptions()
+            if self.compression:
+                options.compression = \
+                    pygpuip.ExrCompression.names[self.compression.upper()]
+            if self.lineorder:
+                options.lineOrder = \
+                    pygpuip.ExrLineOrder.names[self.lineorder.upper()]
+            if self.chunkrows:
+                options.chunkRows = int(self.chunkrows)
+            return options
 
     class Param(object):
         def __init__(self, name, type, default, min, max):
@@ -34,6 +49,7 @@ class Settings(object):
             self.name = name
             self.code = ""
             self.code_file = code_file
+            self.radius = 0
             self.params = []
             self.inBuffers = []
             self.outBuffers = []
@@ -84,6 +100,10 @@ class Settings(object):
                 buffer.input = os.path.join(path,self.data(b, "input"))
             if b.getElementsByTagName("output"):
                 buffer.output = os.path.join(path,self.data(b, "output"))
+                output = b.getElementsByTagName("output")[0]
+                buffer.compression = str(output.getAttribute("compression"))
+                buffer.lineorder = str(output.getAttribute("lineorder"))
+                buffer.chunkrows = str(output.getAttribute("chunkrows"))
                 if not os.path.exists(os.path.dirname(buffer.output)):
                     os.makedirs(os.path.dirname(buffer.output))
             self.buffers.append(buffer)
@@ -93,6 +113,8 @@ class Settings(object):
             kernel = Settings.Kernel(
                 self.data(k, "name"),
                 os.path.join(path, self.data(k, "code_file")))
+            if k.getElementsByTagName("radius"):
+                kernel.radius = int(self.data(k, "radius"))
 
             # In Buffers
             for inb in k.getElementsByTagName("inbuffer"):
@@ -144,6 +166,10 @@ class Settings(object):
                     node = doc.createElement(attr)
                     bufferNode.appendChild(node)
                     node.appendChild(doc.createTextNode(value))
+                    if attr == "output":
+                        for a in ["compression", "lineorder", "chunkrows"]:
+                            if getattr(b, a):
+                                node.setAttribute(a, getattr(b, a))
 
         # Kernels
         paramAttrs = ["name", "type", "value", "default", "min", "max"]
@@ -163,6 +189,11 @@ class Settings(object):
             kernelNode.appendChild(node)
             node.appendChild(doc.createTextNode(k.code_file))
 
+            if k.radius:
+                node = doc.createElement("radius")
+                kernelNode.appendChild(node)
+                node.appendChild(doc.createTextNode(str(k.radius)))
+
             # In Buffers
             for inb in k.inBuffers:
                 inbufferNode = doc.createElement("inbuffer")
@@ -276,4 +307,5 @@ class Settings(object):
 
             # Code
             kernel.code = k.code
+            kernel.radius = k.radius
 
@@ -36,10 +36,19 @@ inline int _cudaGetMaxGflopsDeviceId();
 //----------------------------------------------------------------------------//
 inline std::string _GetTypeStr(Buffer::Ptr buffer);
 //----------------------------------------------------------------------------//
-CUDAImpl::CUDAImpl()
+CUDAImpl::CUDAImpl(const Device & device)
         : ImageProcessor(CUDA), _cudaBuild(false)
 {
-    if (cudaSetDevice(_cudaGetMaxGflopsDeviceId()) != cudaSuccess) {
+    // CUDA devices are always GPUs
+    if (device.type != Device::GPU && device.type != Device::ALL) {
+        throw std::logic_error("gpuip::CUDAImpl() only supports GPU devices");
+    }
+    int device_count = 0;
+    cudaGetDeviceCount(&device_count);
+    const int device_id = device.index == GPUIP_FASTEST_DEVICE ?
+            _cudaGetMaxGflopsDeviceId() : device.index;
+    if (device_id < 0 || device_id >= device_count ||
+        cudaSetDevice(device_id) != cudaSuccess) {
         throw std::logic_error("gpuip::CUDAImpl() could not set device id");
     };
     cudaFree(0); //use runtime api to create a CUDA context implicitly
@@ -59,6 +68,28 @@ CUDAImpl::~CUDAImpl()
     if(!_UnloadModule(&err)) {
         std::cerr << err << std::endl;
     }
+
+    for(size_t i = 0; i < _kernelEvents.size(); ++i) {
+        cudaEventDestroy(_kernelEvents[i]);
+    }
+}
+//----------------------------------------------------------------------------//
+std::vector<Device> CUDAImpl::ListDevices()
+{
+    std::vector<Device> devices;
+    int device_count = 0;
+    if (cudaGetDeviceCount(&device_count) != cudaSuccess) {
+        return devices;
+    }
+    for(int i = 0; i < device_count; ++i) {
+        cudaDeviceProp device_properties;
+        cudaGetDeviceProperties(&device_properties, i);
+        Device device(Device::GPU, i);
+        device.name = device_properties.name;
+        device.platformName = "CUDA";
+        devices.push_back(device);
+    }
+    return devices;
 }
 //----------------------------------------------------------------------------//
 double CUDAImpl::Allocate(std::string * err)
@@ -113,6 +144,20 @@ inline int _removeFile(const char * filename)
     std::string command = std::string("rm ") + std::string(filename);
     return system(command.c_str());
 }
+inline size_t _TileBytes(const Kernel & kernel)
+{
+    // Bytes of shared memory taken by the tiles from _GetTileCode
+    const size_t side = GPUIP_TILE_SIZE + 2 * kernel.radius;
+    size_t bytes = 0;
+    for(size_t i = 0; i < kernel.inBuffers.size(); ++i) {
+        const Buffer::Ptr & buf = kernel.inBuffers[i].buffer;
+        // half tiles are float
+        bytes += side * side * buf->channels *
+                (buf->type == Buffer::UNSIGNED_BYTE ? 1 : sizeof(float));
+    }
+    return bytes;
+}
+//----------------------------------------------------------------------------//
 double CUDAImpl::Build(std::string * err)
 {
     _StartTimer();
@@ -121,6 +166,27 @@ double CUDAImpl::Build(std::string * err)
         return GPUIP_ERROR;
     }
 
+    // A tile that does not fit shared memory would only fail when compiling
+    // or launching, with a less helpful error
+    int device;
+    cudaDeviceProp device_properties;
+    if (cudaGetDevice(&device) == cudaSuccess &&
+        cudaGetDeviceProperties(&device_properties, device) == cudaSuccess) {
+        for(size_t i = 0; i < _kernels.size(); ++i) {
+            const size_t tile_bytes = _TileBytes(*_kernels[i].get());
+            if (_kernels[i]->radius > 0 &&
+                tile_bytes > device_properties.sharedMemPerBlock) {
+                std::stringstream ss;
+                ss << "Cuda error: radius " << _kernels[i]->radius
+                   << " of kernel " << _kernels[i]->name << " needs "
+                   << tile_bytes << " bytes of shared memory, the device has "
+                   << device_properties.sharedMemPerBlock << "\n";
+                (*err) += ss.str();
+                return GPUIP_ERROR;
+            }
+        }
+    }
+
     const char * file_helper_math_h = ".helper_math.h";
     const char * file_temp_cu = ".temp.cu";
     const char * file_temp_ptx = ".temp.ptx";
@@ -199,29 +265,54 @@ double CUDAImpl::Build(std::string * err)
 double CUDAImpl::Run(std::string * err)
 {
     _StartTimer();
+
+    // One event after each kernel splits the run into kernel times
+    while(_timing && _kernelEvents.size() < _kernels.size()) {
+        cudaEvent_t event;
+        cudaEventCreate(&event);
+        _kernelEvents.push_back(event);
+    }
+
     for(size_t i = 0; i < _kernels.size(); ++i) {
         if (!_LaunchKernel(*_kernels[i].get(), _cudaKernels[i], err)) {
             return GPUIP_ERROR;
         }
+        if (_timing) {
+            cudaEventRecord(_kernelEvents[i], 0);
+        }
     }
     cudaDeviceSynchronize();
-    return  _StopTimer();
+    const double time = _StopTimer();
+
+    _kernelTimes.assign(_timing ? _kernels.size() : 0, 0);
+    for(size_t i = 0; i < _kernelTimes.size(); ++i) {
+        float t;
+        cudaEventElapsedTime(&t, i == 0 ? _start : _kernelEvents[i-1],
+                             _kernelEvents[i]);
+        _kernelTimes[i] = t;
+    }
+    return time;
 }
 //----------------------------------------------------------------------------//
-double CUDAImpl::Copy(Buffer::Ptr buffer,
-                      Buffer::CopyOperation op,
-                      void * data,
-                      std::string * err)
+double CUDAImpl::CopyRows(Buffer::Ptr buffer,
+                          Buffer::CopyOperation op,
+                          void * data,
+                          unsigned int y0,
+                          unsigned int y1,
+                          std::string * err)
 {
+    if (!_ValidRows(buffer, y0, y1, err)) {
+        return GPUIP_ERROR;
+    }
     _StartTimer();
     cudaError_t e = cudaSuccess;
-    const size_t size = _BufferSize(buffer);
+    const size_t row = _BytesPerPixel(buffer) * _w;
+    const size_t size = (y1 - y0) * row;
+    char * gpu = reinterpret_cast<char *>(_cudaBuffers[buffer->name]) + y0*row;
     if (op == Buffer::COPY_FROM_GPU) {
-        e =cudaMemcpy(data, _cudaBuffers[buffer->name],
-                      size, cudaMemcpyDeviceToHost);
+        e =cudaMemcpy(data, gpu, size, cudaMemcpyDeviceToHost);
     } else if (op == Buffer::COPY_TO_GPU) {
-        e = cudaMemcpy(_cudaBuffers[buffer->name],data,
-                       size, cudaMemcpyHostToDevice);
+        e = cudaMemcpy(gpu, data, size, cudaMemcpyHostToDevice);
     }
     if (_cudaErrorCopy(e, err, buffer->name, op)) {
         return GPUIP_ERROR;
@@ -229,6 +320,39 @@ double CUDAImpl::Copy(Buffer::Ptr buffer,
     return _StopTimer();
 }
 //----------------------------------------------------------------------------//
+void * CUDAImpl::AllocateHostMemory(Buffer::Ptr buffer, std::string * err)
+{
+    // Page-locked memory is copied with DMA without an extra staging copy
+    void * data = NULL;
+    cudaError_t c_err = cudaHostAlloc(&data, _BufferSize(buffer),
+                                      cudaHostAllocDefault);
+    if (_cudaErrorMalloc(c_err, err)) {
+        return NULL;
+    }
+    return data;
+}
+//----------------------------------------------------------------------------//
+bool CUDAImpl::FreeHostMemory(void * data, std::string * err)
+{
+    cudaError_t c_err = cudaFreeHost(data);
+    return !_cudaErrorFree(c_err, err);
+}
+//----------------------------------------------------------------------------//
+bool CUDAImpl::RegisterHostMemory(void * data,
+                                  size_t bytes,
+                                  std::string * err)
+{
+    cudaError_t c_err = cudaHostRegister(data, bytes,
+                                         cudaHostRegisterPortable);
+    return !_cudaErrorMalloc(c_err, err);
+}
+//----------------------------------------------------------------------------//
+bool CUDAImpl::UnregisterHostMemory(void * data, std::string * err)
+{
+    cudaError_t c_err = cudaHostUnregister(data);
+    return !_cudaErrorFree(c_err, err);
+}
+//----------------------------------------------------------------------------//
 bool CUDAImpl::_LaunchKernel(Kernel & kernel,
                              const CUfunction & cudaKernel,
                              std::string * err)
@@ -275,9 +399,9 @@ bool CUDAImpl::_LaunchKernel(Kernel & kernel,
     }
 
     // Launch the CUDA kernel
-    const int nBlocksHor = _w / 16 + 1;
-    const int nBlocksVer = _h / 16 + 1;
-    cuFuncSetBlockShape(cudaKernel, 16, 16, 1);
+    const int nBlocksHor = _w / GPUIP_TILE_SIZE + 1;
+    const int nBlocksVer = _h / GPUIP_TILE_SIZE + 1;
+    cuFuncSetBlockShape(cudaKernel, GPUIP_TILE_SIZE, GPUIP_TILE_SIZE, 1);
     c_err = cuLaunchGrid(cudaKernel, nBlocksHor, nBlocksVer);
     if (_cudaErrorLaunchKernel(c_err, err, kernel.name)) {
         return false;
@@ -286,6 +410,77 @@ bool CUDAImpl::_LaunchKernel(Kernel & kernel,
     return true;
 }
 //----------------------------------------------------------------------------//
+inline std::string _GetTileCode(const Kernel & kernel,
+                                const std::map<std::string,Buffer::Ptr> & buffers)
+{
+    // All kernels are compiled in the same file, so the sizes are local
+    // constants instead of defines
+    std::stringstream ss;
+    ss << "    // stencil radius and block size\n";
+    ss << "    const int RADIUS = " << kernel.radius << ";\n";
+    ss << "    const int TILE = " << GPUIP_TILE_SIZE << ";\n\n";
+    ss << "    // tile plus halo of the inputs in shared memory, pixel (x+dx,y+dy)"
+       << " is\n"
+       << "    // X_tile[ly + RADIUS + dy][lx + RADIUS + dx] "
+       << "where -RADIUS <= dx,dy <= RADIUS\n";
+    for(size_t i = 0; i < kernel.inBuffers.size(); ++i) {
+        Buffer::Ptr buf = buffers.find(kernel.inBuffers[i].buffer->name)->second;
+        ss << "    __shared__ ";
+        if (buf->type == Buffer::HALF) {
+            ss << "float";
+            if (buf->channels > 1) {
+                ss << buf->channels;
+            }
+        } else {
+            ss << _GetTypeStr(buf);
+        }
+        ss << " " << kernel.inBuffers[i].name
+           << "_tile[TILE + 2 * RADIUS][TILE + 2 * RADIUS];\n";
+    }
+    ss << "    const int lx = threadIdx.x;\n";
+    ss << "    const int ly = threadIdx.y;\n\n";
+    ss << "    // cooperative load, clamped to the image edges\n";
+    ss << "    for (int j = ly; j < TILE + 2 * RADIUS; j += TILE) {\n";
+    ss << "        for (int i = lx; i < TILE + 2 * RADIUS; i += TILE) {\n";
+    ss << "            const int gx = min(max(x - lx - RADIUS + i, 0), width - 1);\n";
+    ss << "            const int gy = min(max(y - ly - RADIUS + j, 0), height - 1);\n";
+    for(size_t i = 0; i < kernel.inBuffers.size(); ++i) {
+        Buffer::Ptr buf = buffers.find(kernel.inBuffers[i].buffer->name)->second;
+        const std::string & name = kernel.inBuffers[i].name;
+        ss << "            " << name << "_tile[j][i] = ";
+        if (buf->type != Buffer::HALF) {
+            ss << name << "[gx + width * gy];\n";
+        } else if (buf->channels == 1) {
+            ss << "__half2float(" << name << "_half[gx + width * gy]);\n";
+        } else {
+            ss << "make_float" << buf->channels << "(";
+            for (unsigned int j = 0; j < buf->channels; ++j) {
+                ss << (j == 0 ? "" : ",\n                " )
+                   << "__half2float(" << name << "_half[" << buf->channels
+                   << " * (gx + width * gy) + " << j << "])";
+            }
+            ss << ");\n";
+        }
+    }
+    ss << "        }\n";
+    ss << "    }\n";
+    ss << "    __syncthreads();\n\n";
+    return ss.str();
+}
+//----------------------------------------------------------------------------//
+double CUDAImpl::PeakBandwidth() const
+{
+    int device;
+    cudaDeviceProp device_properties;
+    if (cudaGetDevice(&device) != cudaSuccess ||
+        cudaGetDeviceProperties(&device_properties, device) != cudaSuccess) {
+        return 0;
+    }
+    // Double data rate memory, clock in kHz and bus width in bits
+    return 2.0 * device_properties.memoryClockRate * 1e3 *
+            (device_properties.memoryBusWidth / 8) / 1e9;
+}
+//----------------------------------------------------------------------------//
 std::string CUDAImpl::BoilerplateCode(Kernel::Ptr kernel) const 
 {
     std::stringstream ss;
@@ -333,6 +528,13 @@ std::string CUDAImpl::BoilerplateCode(Kernel::Ptr kernel) const
     ss << "    const int y = blockIdx.y * blockDim.y + threadIdx.y;\n\n";
     ss << "    // array index\n";
     ss << "    const int idx = x + width * y;\n\n";
+
+    // All threads have to reach __syncthreads, so the tile is loaded
+    // before the bounds check
+    if (kernel->radius > 0) {
+        ss << _GetTileCode(*kernel.get(), _buffers);
+    }
+
     ss << "    // inside image bounds check\n";
     ss << "    if (x >= width || y >= height) {\n";
     ss << "        return;\n";
@@ -342,7 +544,7 @@ std::string CUDAImpl::BoilerplateCode(Kernel::Ptr kernel) const
     for(size_t i = 0; i < kernel->inBuffers.size(); ++i) {
         const std::string & bname = kernel->inBuffers[i].buffer->name;
         Buffer::Ptr buf = _buffers.find(bname)->second;
-        if (buf->type == Buffer::HALF) {
+        if (buf->type == Buffer::HALF && kernel->radius == 0) {
             if (!i) {
                 ss << "    // half to float conversion\n";
             }
@@ -449,11 +651,16 @@ std::string CUDAImpl::BoilerplateCode(Kernel::Ptr kernel) const
 //----------------------------------------------------------------------------//
 void CUDAImpl::_StartTimer()
 {
-    cudaEventRecord(_start, 0);
+    if (_timing) {
+        cudaEventRecord(_start, 0);
+    }
 }
 //----------------------------------------------------------------------------//
 double CUDAImpl::_StopTimer()
 {
+    if (!_timing) {
+        return 0;
+    }
     cudaEventRecord(_stop, 0);
     cudaEventSynchronize(_stop);
     float time;
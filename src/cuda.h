@@ -34,9 +34,11 @@ namespace gpuip {
 class CUDAImpl : public ImageProcessor
 {
   public:
-    CUDAImpl();
+    CUDAImpl(const Device & device = Device());
 
     virtual ~CUDAImpl();
+
+    static std::vector<Device> ListDevices();
     
     virtual double Allocate(std::string * err);
     
@@ -44,18 +46,33 @@ class CUDAImpl : public ImageProcessor
 
     virtual double Run(std::string * err);
     
-    virtual double Copy(Buffer::Ptr buffer,
-                        Buffer::CopyOperation op,
-                        void * data,
-                        std::string * err);
+    virtual double CopyRows(Buffer::Ptr buffer,
+                            Buffer::CopyOperation op,
+                            void * data,
+                            unsigned int y0,
+                            unsigned int y1,
+                            std::string * err);
+
+    virtual void * AllocateHostMemory(Buffer::Ptr buffer, std::string * err);
+
+    virtual bool FreeHostMemory(void * data, std::string * err);
+
+    virtual bool RegisterHostMemory(void * data,
+                                    size_t bytes,
+                                    std::string * err);
+
+    virtual bool UnregisterHostMemory(void * data, std::string * err);
 
     virtual std::string BoilerplateCode(Kernel::Ptr kernel) const;
+
+    virtual double PeakBandwidth() const;
     
   protected:
     std::vector<CUfunction> _cudaKernels;
     bool _cudaBuild;
     CUmodule _cudaModule;
     cudaEvent_t _start,_stop;
+    std::vector<cudaEvent_t> _kernelEvents;
     std::map<std::string, float*> _cudaBuffers;
     
     bool _LaunchKernel(Kernel & kernel,
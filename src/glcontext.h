@@ -37,7 +37,12 @@ extern "C" {
 #    include <GL/glx.h>
 #  endif
 #endif
+#ifdef _GPUIP_GL_EGL
+#  include <EGL/egl.h>
+#  include <EGL/eglext.h>
+#endif
 #include <GLFW/glfw3.h>
+#include <cstdlib>
 #include <string>
 
 //----------------------------------------------------------------------------//
@@ -48,6 +53,11 @@ class GLContext
   public:
     static bool Exists()
     {
+#ifdef _GPUIP_GL_EGL
+        if (eglGetCurrentContext() != EGL_NO_CONTEXT) {
+            return true;
+        }
+#endif
 #ifdef __APPLE__
         if (_HasNSGLContext()) {
             return true;
@@ -65,28 +75,168 @@ class GLContext
 #endif
         return false;
     }
-    
+
+    // The context type is picked with the GPUIP_GL_CONTEXT environment
+    // variable: "glfw" creates a hidden window, "egl" a headless context
+    // without any window system. By default EGL is used when there is no X
+    // display and GLFW otherwise, falling back to EGL if GLFW fails. Mesa
+    // renders EGL contexts on the CPU (llvmpipe) when there is no GPU or
+    // when LIBGL_ALWAYS_SOFTWARE is set.
     static bool Create(std::string * err)
+    {
+        const char * type = getenv("GPUIP_GL_CONTEXT");
+        const std::string context = type != NULL ? type : "";
+#ifdef _GPUIP_GL_EGL
+        if (context == "egl") {
+            return _CreateEGL(err);
+        }
+        const char * display = getenv("DISPLAY");
+        if (context.empty() && (display == NULL || display[0] == '\0')) {
+            return _CreateEGL(err);
+        }
+        if (context.empty()) {
+            std::string glfw_err;
+            return _CreateGLFW(&glfw_err) || _CreateEGL(err);
+        }
+#else
+        if (context == "egl") {
+            (*err) += "gpuip was built without EGL support\n";
+            return false;
+        }
+#endif
+        return _CreateGLFW(err);
+    }
+
+    static void Delete()
+    {
+#ifdef _GPUIP_GL_EGL
+        EGLDisplay & display = _EGLDisplay();
+        if (display != EGL_NO_DISPLAY) {
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                           EGL_NO_CONTEXT);
+            eglTerminate(display);
+            display = EGL_NO_DISPLAY;
+            return;
+        }
+#endif
+        if(glfwGetCurrentContext()) {
+            glfwTerminate();
+        }
+    }
+
+  private:
+    static bool _CreateGLFW(std::string * err)
     {
         if (!glfwInit()) {
-            (*err) += "gpuip could not initiate GLFW";
+            (*err) += "gpuip could not initiate GLFW\n";
             return false;
         }
         GLFWwindow * window = glfwCreateWindow(1, 1, "", NULL, NULL);
         if (!window) {
-            (*err) += "gpuip could not create window with glfw";
+            (*err) += "gpuip could not create window with glfw\n";
             return false;
         }
         glfwMakeContextCurrent(window);
         return true;
     }
 
-    static void Delete()
+#ifdef _GPUIP_GL_EGL
+    static EGLDisplay & _EGLDisplay()
     {
-        if(glfwGetCurrentContext()) {
-            glfwTerminate();
+        static EGLDisplay display = EGL_NO_DISPLAY;
+        return display;
+    }
+
+    // Client extensions are queried without a display, EGL 1.5 or
+    // EGL_EXT_client_extensions
+    static bool _HasEGLClientExtension(const char * name)
+    {
+        const char * extensions = eglQueryString(EGL_NO_DISPLAY,
+                                                 EGL_EXTENSIONS);
+        if (extensions == NULL) {
+            eglGetError(); // clears EGL_BAD_DISPLAY
+            return false;
         }
+        const std::string list = std::string(" ") + extensions + " ";
+        return list.find(std::string(" ") + name + " ") != std::string::npos;
     }
+
+    static bool _FailEGL(EGLDisplay display,
+                         const char * message,
+                         std::string * err)
+    {
+        eglTerminate(display);
+        (*err) += message;
+        return false;
+    }
+
+    static bool _CreateEGL(std::string * err)
+    {
+        // Prefer a display that does not need a window system or a gpu
+        EGLDisplay display = EGL_NO_DISPLAY;
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+                (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+                eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay != NULL &&
+            _HasEGLClientExtension("EGL_MESA_platform_surfaceless")) {
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                         EGL_DEFAULT_DISPLAY, NULL);
+            if (display != EGL_NO_DISPLAY &&
+                !eglInitialize(display, NULL, NULL)) {
+                display = EGL_NO_DISPLAY;
+            }
+        }
+        if (display == EGL_NO_DISPLAY) {
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+            if (display == EGL_NO_DISPLAY ||
+                !eglInitialize(display, NULL, NULL)) {
+                (*err) += "gpuip could not initiate EGL\n";
+                return false;
+            }
+        }
+
+        if (!eglBindAPI(EGL_OPENGL_API)) {
+            return _FailEGL(display, "gpuip could not bind OpenGL with EGL\n",
+                            err);
+        }
+
+        const EGLint config_attribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE };
+        EGLConfig config = NULL;
+        EGLint num_configs = 0;
+        if (!eglChooseConfig(display, config_attribs, &config, 1,
+                             &num_configs) || num_configs == 0) {
+            config = NULL;
+        }
+
+        EGLContext ctx = eglCreateContext(display, config,
+                                          EGL_NO_CONTEXT, NULL);
+        if (ctx == EGL_NO_CONTEXT) {
+            return _FailEGL(display, "gpuip could not create EGL context\n",
+                            err);
+        }
+
+        // All rendering goes to framebuffer objects so no surface is needed.
+        // Without surfaceless support, use a 1x1 pbuffer instead.
+        if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx)) {
+            const EGLint pbuffer_attribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1,
+                                               EGL_NONE };
+            EGLSurface surface = config != NULL ?
+                    eglCreatePbufferSurface(display, config, pbuffer_attribs) :
+                    EGL_NO_SURFACE;
+            if (surface == EGL_NO_SURFACE ||
+                !eglMakeCurrent(display, surface, surface, ctx)) {
+                return _FailEGL(display,
+                                "gpuip could not make EGL context current\n",
+                                err);
+            }
+        }
+        _EGLDisplay() = display;
+        return true;
+    }
+#endif
 };
 //----------------------------------------------------------------------------//
 }// end namespace gpuip
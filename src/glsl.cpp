@@ -26,6 +26,12 @@ SOFTWARE.
 #include "glsl_error.h"
 #include "glcontext.h"
 #include <string.h>
+#include <algorithm>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
 //----------------------------------------------------------------------------//
 namespace gpuip {
 //----------------------------------------------------------------------------//
@@ -35,8 +41,24 @@ inline GLenum _GetFormat(const Buffer::Ptr & b);
 //----------------------------------------------------------------------------//
 inline GLenum _GetInternalFormat(const Buffer::Ptr & b);
 //----------------------------------------------------------------------------//
-GLSLImpl::GLSLImpl()
-        : ImageProcessor(gpuip::GLSL), _glewInit(false),_glContextCreated(false)
+inline GLenum _GetImageFormat(const Buffer::Ptr & b);
+//----------------------------------------------------------------------------//
+inline std::string _GetImageFormatStr(const Buffer::Ptr & b);
+//----------------------------------------------------------------------------//
+// Number of pixel buffer objects that uploads rotate between
+#define GPUIP_GL_UPLOAD_PBOS 2
+//----------------------------------------------------------------------------//
+// Number of pixel buffer objects that downloads rotate between, and the number
+// of bands that a download is split into so that the bands can overlap
+#define GPUIP_GL_READ_PBOS 2
+#define GPUIP_GL_READ_BANDS 4
+//----------------------------------------------------------------------------//
+// Number of timer queries per kind of call that can be in flight
+#define GPUIP_GL_TIMER_QUERIES 4
+//----------------------------------------------------------------------------//
+GLSLImpl::GLSLImpl(GLSLShader shader)
+        : ImageProcessor(gpuip::GLSL), _glewInit(false),_glContextCreated(false),
+          _shader(shader), _uploadPbo(0), _readFbo(0)
 {
 }
 //----------------------------------------------------------------------------//
@@ -48,6 +70,10 @@ GLSLImpl::~GLSLImpl()
     for(size_t i = 0; i < _programs.size(); ++i) {
         glDeleteProgram(_programs[i]);
     }
+
+    _DeleteQueries(_runQueries);
+    _DeleteQueries(_uploadQueries);
+    _DeleteQueries(_downloadQueries);
     
     if(_glContextCreated) {
         GLContext::Delete();
@@ -64,6 +90,13 @@ bool GLSLImpl::_InitGLEW(std::string * err)
     }
     
     GLenum result = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // GLX extensions are not available in headless EGL contexts but the
+    // OpenGL functions are still loaded
+    if (result == GLEW_ERROR_NO_GLX_DISPLAY) {
+        result = GLEW_OK;
+    }
+#endif
     if (result != GLEW_OK) {
         std::stringstream ss;
         ss << glewGetErrorString(result) << "\ngpuip could not initiate GLEW\n";
@@ -75,17 +108,105 @@ bool GLSLImpl::_InitGLEW(std::string * err)
     return true;
 }
 //----------------------------------------------------------------------------//
+// Wall clock in milliseconds. Allocate and Build mostly wait for the
+// driver, which cpu time would not count.
+inline double _Now()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart * 1000.0 / frequency.QuadPart;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+#endif
+}
+//----------------------------------------------------------------------------//
 void GLSLImpl::_StartTimer()
 {
-    glGetInteger64v(GL_TIMESTAMP, &_timer);
+    _start = _Now();
 }
 //----------------------------------------------------------------------------//
 double GLSLImpl::_StopTimer()
 {
-    const GLint64 timerStart = _timer;
-    glFinish();
-    glGetInteger64v(GL_TIMESTAMP, &_timer);
-    return (_timer - timerStart) / 1000000.0;
+    if (!_timing) {
+        return 0;
+    }
+    return _Now() - _start;
+}
+//----------------------------------------------------------------------------//
+inline bool _GetQueryTime(GLuint query, bool wait, double * time)
+{
+    if (!wait) {
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            return false;
+        }
+    }
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+    *time = elapsed / 1000000.0;
+    return true;
+}
+//----------------------------------------------------------------------------//
+void GLSLImpl::_BeginQuery(TimerQueries & queries)
+{
+    if (!_timing) {
+        return;
+    }
+
+    if (queries.ids.empty()) {
+        queries.ids.resize(GPUIP_GL_TIMER_QUERIES);
+        queries.pending.resize(queries.ids.size(), false);
+        glGenQueries(queries.ids.size(), &queries.ids[0]);
+    }
+
+    // All queries are in flight, the oldest has to finish before it is reused
+    const size_t i = queries.next;
+    if (queries.pending[i]) {
+        _GetQueryTime(queries.ids[i], true, &queries.last);
+        queries.pending[i] = false;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, queries.ids[i]);
+    queries.active = true;
+}
+//----------------------------------------------------------------------------//
+double GLSLImpl::_EndQuery(TimerQueries & queries, bool wait)
+{
+    if (!queries.active) {
+        return 0;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    queries.active = false;
+    queries.pending[queries.next] = true;
+    queries.next = (queries.next + 1) % queries.ids.size();
+
+    // Collect the finished queries from oldest to newest. The gpu runs the
+    // commands in order so the first unfinished query ends the search.
+    for(size_t i = 0; i < queries.ids.size(); ++i) {
+        const size_t j = (queries.next + i) % queries.ids.size();
+        if (!queries.pending[j]) {
+            continue;
+        }
+        if (!_GetQueryTime(queries.ids[j], wait, &queries.last)) {
+            break;
+        }
+        queries.pending[j] = false;
+    }
+    return queries.last;
+}
+//----------------------------------------------------------------------------//
+void GLSLImpl::_DeleteQueries(TimerQueries & queries)
+{
+    if (!queries.ids.empty()) {
+        glDeleteQueries(queries.ids.size(), &queries.ids[0]);
+    }
+    queries.ids.clear();
+    queries.pending.clear();
+    queries.next = 0;
 }
 //----------------------------------------------------------------------------//
 void GLSLImpl::_DeleteBuffers()
@@ -100,6 +221,20 @@ void GLSLImpl::_DeleteBuffers()
     }
     _fbos.clear();
     _textures.clear(); 
+
+    if (!_uploadPbos.empty()) {
+        for(size_t i = 0; i < _uploadFences.size(); ++i) {
+            if (_uploadFences[i]) {
+                glDeleteSync(_uploadFences[i]);
+            }
+        }
+        glDeleteBuffers(_uploadPbos.size(), _uploadPbos.data());
+        glDeleteBuffers(_readPbos.size(), _readPbos.data());
+        glDeleteFramebuffers(1, &_readFbo);
+    }
+    _uploadPbos.clear();
+    _uploadFences.clear();
+    _readPbos.clear();
 }
 //----------------------------------------------------------------------------//
 double GLSLImpl::Allocate(std::string * err)
@@ -108,12 +243,24 @@ double GLSLImpl::Allocate(std::string * err)
         return GPUIP_ERROR;
     }
 
+    if (_shader == COMPUTE_SHADER && _glErrorComputeShader(err)) {
+        return GPUIP_ERROR;
+    }
+
     _StartTimer();
 
     _DeleteBuffers();
         
     std::map<std::string,Buffer::Ptr>::const_iterator it;
     for(it = _buffers.begin(); it != _buffers.end(); ++it) {
+        // Image load/store only works with sized 1, 2 and 4 channel formats
+        if (_shader == COMPUTE_SHADER && !_GetImageFormat(it->second)) {
+            (*err) += "GLSL error: compute shader buffer ";
+            (*err) += it->second->name;
+            (*err) += " must have 1, 2 or 4 channels.\n";
+            return GPUIP_ERROR;
+        }
+
         GLuint texID;
         glGenTextures(1, &texID);
         glBindTexture(GL_TEXTURE_2D, texID);
@@ -131,7 +278,8 @@ double GLSLImpl::Allocate(std::string * err)
 
         // Allocate memory on gpu (needed to bind framebuffer)
         Buffer::Ptr b = it->second;
-        glTexImage2D(GL_TEXTURE_2D, 0, _GetInternalFormat(b),
+        glTexImage2D(GL_TEXTURE_2D, 0, _shader == COMPUTE_SHADER ?
+                     _GetImageFormat(b) : _GetInternalFormat(b),
                      _w, _h, 0, _GetFormat(b), _GetType(b), 0);
         
         _textures[it->second->name] = texID;
@@ -140,6 +288,37 @@ double GLSLImpl::Allocate(std::string * err)
             return GPUIP_ERROR;
         }
     }
+
+    // Pixel buffer objects for the transfers, large enough for any buffer
+    size_t pboSize = 0;
+    for(it = _buffers.begin(); it != _buffers.end(); ++it) {
+        pboSize = std::max(pboSize, _BufferSize(it->second));
+    }
+    _uploadPbos.resize(GPUIP_GL_UPLOAD_PBOS);
+    _uploadFences.resize(GPUIP_GL_UPLOAD_PBOS, 0);
+    _uploadPbo = 0;
+    glGenBuffers(_uploadPbos.size(), _uploadPbos.data());
+    for(size_t i = 0; i < _uploadPbos.size(); ++i) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _uploadPbos[i]);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, pboSize, 0, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    _readPbos.resize(GPUIP_GL_READ_PBOS);
+    glGenBuffers(_readPbos.size(), _readPbos.data());
+    for(size_t i = 0; i < _readPbos.size(); ++i) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, _readPbos[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, pboSize, 0, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glGenFramebuffers(1, &_readFbo);
+    if (_glErrorCreateTexture(err)) {
+        return GPUIP_ERROR;
+    }
+
+    // Compute shaders write directly to the textures
+    if (_shader == COMPUTE_SHADER) {
+        return _StopTimer();
+    }
             
     // Create FBOs
     _fbos.reserve(_kernels.size());
@@ -191,6 +370,32 @@ double GLSLImpl::Build(std::string * err)
         glDeleteProgram(_programs[i]);
     }
 
+    if (_shader == COMPUTE_SHADER) {
+        if (_glErrorComputeShader(err)) {
+            return GPUIP_ERROR;
+        }
+
+        _programs.resize(_kernels.size());
+        for(size_t i = 0; i < _kernels.size(); ++i) {
+            const char * code = _kernels[i]->code.c_str();
+            const GLuint computeShaderID = glCreateShader(GL_COMPUTE_SHADER);
+            const int length = strlen(code);
+            glShaderSource(computeShaderID, 1, &code, &length);
+            glCompileShader(computeShaderID);
+
+            _programs[i] = glCreateProgram();
+            glAttachShader(_programs[i], computeShaderID);
+            glLinkProgram(_programs[i]);
+            const bool failed = _glCheckComputeBuildError(
+                _programs[i], computeShaderID, err);
+            glDeleteShader(computeShaderID);
+            if (failed) {
+                return GPUIP_ERROR;
+            }
+        }
+        return _StopTimer();
+    }
+
     // Simple vert shader code for a quad with texture coordinates
     static const char * vert_shader_code =  
             "#version 120\n"
@@ -231,7 +436,17 @@ double GLSLImpl::Build(std::string * err)
 //----------------------------------------------------------------------------//
 double GLSLImpl::Run(std::string * err)
 {
-    _StartTimer();
+    _BeginQuery(_runQueries);
+
+    if (_shader == COMPUTE_SHADER) {
+        for(size_t i = 0; i < _kernels.size(); ++i) {
+            if (!_Dispatch(*_kernels[i].get(), _programs[i], err)) {
+                _EndQuery(_runQueries, false);
+                return GPUIP_ERROR;
+            }
+        }
+        return _EndQuery(_runQueries, false);
+    }
     
     glPushAttrib( GL_VIEWPORT_BIT );
     
@@ -240,37 +455,208 @@ double GLSLImpl::Run(std::string * err)
     
     for(size_t i = 0; i < _kernels.size(); ++i) {
         if (!_DrawQuad(*_kernels[i].get(), _fbos[i], _programs[i], err)) {
+            glPopAttrib();
+            _EndQuery(_runQueries, false);
             return GPUIP_ERROR;
         }
     }
 
     // Reset back to the previous viewport
     glPopAttrib();
-    return _StopTimer();
+    return _EndQuery(_runQueries, false);
 }
 //----------------------------------------------------------------------------//
-double GLSLImpl::Copy(Buffer::Ptr b,
-                      Buffer::CopyOperation op,
-                      void * data,
-                      std::string * err)
+double GLSLImpl::CopyRows(Buffer::Ptr b,
+                          Buffer::CopyOperation op,
+                          void * data,
+                          unsigned int y0,
+                          unsigned int y1,
+                          std::string * err)
 {
-    _StartTimer();
+    if (!_ValidRows(b, y0, y1, err)) {
+        return GPUIP_ERROR;
+    }
+    if (y0 == y1) {
+        return 0;
+    }
+
+    TimerQueries & queries = op == Buffer::COPY_FROM_GPU ?
+            _downloadQueries : _uploadQueries;
+    _BeginQuery(queries);
+
+    // Rows are tightly packed in the cpu memory
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
     if (op == Buffer::COPY_FROM_GPU) {
-        glBindTexture(GL_TEXTURE_2D, _textures[b->name]);
-        glGetTexImage(GL_TEXTURE_2D, 0, _GetFormat(b), _GetType(b), data);
+        if (!_Download(b, data, y0, y1, err)) {
+            _EndQuery(queries, false);
+            return GPUIP_ERROR;
+        }
     } else if (op == Buffer::COPY_TO_GPU) {
-        glBindTexture(GL_TEXTURE_2D, _textures[b->name]);
-        glTexImage2D(GL_TEXTURE_2D, 0, _GetInternalFormat(b),
-                     _w, _h, 0, _GetFormat(b), _GetType(b), data);
+        if (!_Upload(b, data, y0, y1, err)) {
+            _EndQuery(queries, false);
+            return GPUIP_ERROR;
+        }
     }
     if (_glErrorCopy(err, b->name, op)) {
+        _EndQuery(queries, false);
         return GPUIP_ERROR;
     }
-    return _StopTimer();
+
+    // Uploads continue in the background while the next commands are
+    // issued. Downloads have already waited for the gpu.
+    return _EndQuery(queries, op == Buffer::COPY_FROM_GPU);
+}
+//----------------------------------------------------------------------------//
+bool GLSLImpl::Finish(std::string * err)
+{
+    glFinish();
+    GLenum gl_err = glGetError();
+    if (gl_err != GL_NO_ERROR) {
+        (*err) += "GLSL error when waiting for the gpu.\n";
+        (*err) += _glErrorToString(gl_err);
+        return false;
+    }
+    return true;
+}
+//----------------------------------------------------------------------------//
+bool GLSLImpl::_Upload(Buffer::Ptr b,
+                       const void * data,
+                       unsigned int y0,
+                       unsigned int y1,
+                       std::string * err)
+{
+    // Wait until the texture upload that last used this pbo has read from it.
+    // With rotating pbos this is normally done long ago.
+    GLsync & fence = _uploadFences[_uploadPbo];
+    if (fence) {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(fence);
+        fence = 0;
+    }
+
+    const size_t size = _BytesPerPixel(b) * _w * (y1 - y0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _uploadPbos[_uploadPbo]);
+    void * ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                  GL_MAP_WRITE_BIT |
+                                  GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!ptr) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        (*err) += "GLSL: could not map pixel buffer of buffer ";
+        (*err) += b->name;
+        (*err) += "\n";
+        return false;
+    }
+    memcpy(ptr, data, size);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    // Texture storage is already allocated with the right format. With a pbo
+    // bound the data pointer is an offset into the pbo.
+    glBindTexture(GL_TEXTURE_2D, _textures[b->name]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y0, _w, y1 - y0,
+                    _GetFormat(b), _GetType(b), 0);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    _uploadPbo = (_uploadPbo + 1) % _uploadPbos.size();
+    return true;
+}
+//----------------------------------------------------------------------------//
+bool GLSLImpl::_Download(Buffer::Ptr b,
+                         void * data,
+                         unsigned int y0,
+                         unsigned int y1,
+                         std::string * err)
+{
+    const size_t row = _BytesPerPixel(b) * _w;
+    char * dst = (char *)data;
+
+    // Read from the texture through a framebuffer. Formats that can not be
+    // rendered to are read whole with glGetTexImage instead.
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _readFbo);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, _textures[b->name], 0);
+    if (glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) !=
+        GL_FRAMEBUFFER_COMPLETE) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, _readPbos[0]);
+        glBindTexture(GL_TEXTURE_2D, _textures[b->name]);
+        glGetTexImage(GL_TEXTURE_2D, 0, _GetFormat(b), _GetType(b), 0);
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        return _ReadPbo(b, _readPbos[0], fence, y0 * row,
+                        (y1 - y0) * row, dst, err);
+    }
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+    // The rows are read in bands that rotate between the pbos. The gpu reads
+    // the next band while the previous one is copied to the cpu memory.
+    const unsigned int band = std::max(
+        1u, (y1 - y0 + GPUIP_GL_READ_BANDS - 1) / GPUIP_GL_READ_BANDS);
+    const unsigned int bands = (y1 - y0 + band - 1) / band;
+    GLsync fences[GPUIP_GL_READ_PBOS];
+    bool ok = true;
+    for(unsigned int i = 0; i <= bands && ok; ++i) {
+        if (i < bands) {
+            const unsigned int ya = y0 + i * band;
+            const unsigned int yb = std::min(y1, ya + band);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER,
+                         _readPbos[i % GPUIP_GL_READ_PBOS]);
+            glReadPixels(0, ya, _w, yb - ya, _GetFormat(b), _GetType(b), 0);
+            fences[i % GPUIP_GL_READ_PBOS] =
+                    glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+        if (i > 0) {
+            const unsigned int j = i - 1;
+            const unsigned int ya = y0 + j * band;
+            const unsigned int yb = std::min(y1, ya + band);
+            ok = _ReadPbo(b, _readPbos[j % GPUIP_GL_READ_PBOS],
+                          fences[j % GPUIP_GL_READ_PBOS], 0,
+                          (yb - ya) * row, dst + (ya - y0) * row, err);
+            if (!ok && i < bands) {
+                glDeleteSync(fences[i % GPUIP_GL_READ_PBOS]);
+            }
+        }
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    return ok;
+}
+//----------------------------------------------------------------------------//
+bool GLSLImpl::_ReadPbo(Buffer::Ptr b,
+                        GLuint pbo,
+                        GLsync fence,
+                        size_t offset,
+                        size_t size,
+                        void * data,
+                        std::string * err)
+{
+    // Only wait for the read into this pbo, later reads keep running
+    glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    glDeleteSync(fence);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+    const void * ptr = glMapBufferRange(GL_PIXEL_PACK_BUFFER, offset, size,
+                                        GL_MAP_READ_BIT);
+    if (ptr) {
+        memcpy(data, ptr, size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!ptr) {
+        (*err) += "GLSL: could not map pixel buffer of buffer ";
+        (*err) += b->name;
+        (*err) += "\n";
+        return false;
+    }
+    return true;
 }
 //----------------------------------------------------------------------------//
 std::string GLSLImpl::BoilerplateCode(Kernel::Ptr kernel) const
 {
+    if (_shader == COMPUTE_SHADER) {
+        return _ComputeBoilerplateCode(kernel);
+    }
+
     std::stringstream ss;
     ss << "#version 120\n";
     for(size_t i = 0; i < kernel->inBuffers.size(); ++i) {
@@ -298,6 +684,147 @@ std::string GLSLImpl::BoilerplateCode(Kernel::Ptr kernel) const
     return ss.str();
 }
 //----------------------------------------------------------------------------//
+std::string GLSLImpl::_ComputeBoilerplateCode(Kernel::Ptr kernel) const
+{
+    std::stringstream ss;
+    ss << "#version 430\n";
+    if (kernel->radius > 0) {
+        ss << "#define RADIUS " << kernel->radius << "\n";
+    }
+    ss << "#define TILE " << GPUIP_TILE_SIZE << "\n"
+       << "layout(local_size_x = TILE, local_size_y = TILE) in;\n";
+    for(size_t i = 0; i < kernel->inBuffers.size(); ++i) {
+        const Buffer::Ptr & b =
+                _buffers.find(kernel->inBuffers[i].buffer->name)->second;
+        ss << "layout(" << _GetImageFormatStr(b) << ") readonly uniform image2D "
+           << kernel->inBuffers[i].name << ";\n";
+    }
+    for(size_t i = 0; i < kernel->outBuffers.size(); ++i) {
+        const Buffer::Ptr & b =
+                _buffers.find(kernel->outBuffers[i].buffer->name)->second;
+        ss << "layout(" << _GetImageFormatStr(b) << ") writeonly uniform image2D "
+           << kernel->outBuffers[i].name << ";\n";
+    }
+    for(size_t i = 0; i < kernel->paramsInt.size(); ++i) {
+        ss << "uniform int " << kernel->paramsInt[i].name <<";\n";
+    }
+    for(size_t i = 0; i < kernel->paramsFloat.size(); ++i) {
+        ss << "uniform float " << kernel->paramsFloat[i].name <<";\n";
+    }
+    ss << "uniform int width;\n"
+       << "uniform int height;\n";
+
+    // Shared memory has to be declared in global scope
+    if (kernel->radius > 0) {
+        ss << "\n// tile plus halo of the inputs, pixel (x+dx,y+dy) is\n"
+           << "// X_tile[ly + RADIUS + dy][lx + RADIUS + dx] "
+           << "where -RADIUS <= dx,dy <= RADIUS\n";
+        for(size_t i = 0; i < kernel->inBuffers.size(); ++i) {
+            ss << "shared vec4 " << kernel->inBuffers[i].name
+               << "_tile[TILE + 2 * RADIUS][TILE + 2 * RADIUS];\n";
+        }
+    }
+
+    ss << "\n"
+       << "void main()\n"
+       << "{\n"
+       << "    ivec2 x = ivec2(gl_GlobalInvocationID.xy);\n\n";
+
+    // All invocations have to reach the barrier, so the tile is loaded
+    // before the bounds check
+    if (kernel->radius > 0) {
+        ss << "    int lx = int(gl_LocalInvocationID.x);\n"
+           << "    int ly = int(gl_LocalInvocationID.y);\n\n"
+           << "    // cooperative load, clamped to the image edges\n"
+           << "    for (int j = ly; j < TILE + 2 * RADIUS; j += TILE) {\n"
+           << "        for (int i = lx; i < TILE + 2 * RADIUS; i += TILE) {\n"
+           << "            ivec2 g = clamp(x - ivec2(lx, ly) - RADIUS + "
+           << "ivec2(i, j),\n"
+           << "                            ivec2(0), "
+           << "ivec2(width - 1, height - 1));\n";
+        for(size_t i = 0; i < kernel->inBuffers.size(); ++i) {
+            ss << "            " << kernel->inBuffers[i].name
+               << "_tile[j][i] = imageLoad(" << kernel->inBuffers[i].name
+               << ", g);\n";
+        }
+        ss << "        }\n"
+           << "    }\n"
+           << "    memoryBarrierShared();\n"
+           << "    barrier();\n\n";
+    }
+
+    ss << "    // inside image bounds check\n"
+       << "    if (x.x >= width || x.y >= height) {\n"
+       << "        return;\n"
+       << "    }\n";
+    for(size_t i = 0; i < kernel->outBuffers.size(); ++i) {
+        ss << "\n"
+           << "    // imageStore to buffer " << kernel->outBuffers[i].name << "\n"
+           << "    imageStore(" << kernel->outBuffers[i].name
+           << ", x, vec4(0,0,0,1));\n";
+    }
+    ss << "}";
+    return ss.str();
+}
+//----------------------------------------------------------------------------//
+bool GLSLImpl::_Dispatch(const Kernel & kernel,
+                         GLuint program,
+                         std::string * error)
+{
+    // Load program (kernel)
+    glUseProgram(program);
+
+    // Uniform data setup
+    GLint loc;
+    for(size_t i = 0; i < kernel.paramsInt.size(); ++i) {
+        loc = glGetUniformLocation(program, kernel.paramsInt[i].name.c_str());
+        glUniform1i(loc, kernel.paramsInt[i].value);
+    }
+    for(size_t i = 0; i < kernel.paramsFloat.size(); ++i) {
+        loc = glGetUniformLocation(program, kernel.paramsFloat[i].name.c_str());
+        glUniform1f(loc, kernel.paramsFloat[i].value);
+    }
+    glUniform1i(glGetUniformLocation(program, "width"), _w);
+    glUniform1i(glGetUniformLocation(program, "height"), _h);
+
+    // Image units setup, inputs first and then outputs
+    GLuint unit = 0;
+    for(size_t i = 0; i < kernel.inBuffers.size(); ++i, ++unit) {
+        const Buffer::Ptr & b = kernel.inBuffers[i].buffer;
+        loc = glGetUniformLocation(program, kernel.inBuffers[i].name.c_str());
+        glUniform1i(loc, unit);
+        glBindImageTexture(unit, _textures[b->name], 0, GL_FALSE, 0,
+                           GL_READ_ONLY, _GetImageFormat(b));
+    }
+    for(size_t i = 0; i < kernel.outBuffers.size(); ++i, ++unit) {
+        const Buffer::Ptr & b = kernel.outBuffers[i].buffer;
+        loc = glGetUniformLocation(program, kernel.outBuffers[i].name.c_str());
+        glUniform1i(loc, unit);
+        glBindImageTexture(unit, _textures[b->name], 0, GL_FALSE, 0,
+                           GL_WRITE_ONLY, _GetImageFormat(b));
+    }
+
+    if (_glErrorDrawSetup(error, kernel.name)) {
+        return false;
+    }
+
+    glDispatchCompute((_w + GPUIP_TILE_SIZE - 1) / GPUIP_TILE_SIZE,
+                      (_h + GPUIP_TILE_SIZE - 1) / GPUIP_TILE_SIZE, 1);
+
+    // Writes have to be visible to the next kernel and to the copies, which
+    // read through the read framebuffer or with glGetTexImage
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT |
+                    GL_FRAMEBUFFER_BARRIER_BIT |
+                    GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    if (_glErrorDraw(error, kernel.name)) {
+        return false;
+    }
+
+    glUseProgram(0);
+    return true;
+}
+//----------------------------------------------------------------------------//
 bool GLSLImpl::_DrawQuad(const Kernel & kernel,
                          GLuint fbo,
                          GLuint program,
@@ -437,4 +964,47 @@ GLenum _GetInternalFormat(const Buffer::Ptr & b)
     return format;
 }
 //----------------------------------------------------------------------------//
+GLenum _GetImageFormat(const Buffer::Ptr & b)
+{
+    const GLenum format = _GetFormat(b);
+    if (format == GL_RGB) {
+        return 0;
+    }
+    if (b->type == Buffer::UNSIGNED_BYTE) {
+        switch(format){
+            case GL_RED:
+                return GL_R8;
+            case GL_RG:
+                return GL_RG8;
+            default:
+                return GL_RGBA8;
+        }
+    }
+    return _GetInternalFormat(b);
+}
+//----------------------------------------------------------------------------//
+std::string _GetImageFormatStr(const Buffer::Ptr & b)
+{
+    switch(_GetImageFormat(b)) {
+        case GL_R8:
+            return "r8";
+        case GL_RG8:
+            return "rg8";
+        case GL_RGBA8:
+            return "rgba8";
+        case GL_R16F:
+            return "r16f";
+        case GL_RG16F:
+            return "rg16f";
+        case GL_RGBA16F:
+            return "rgba16f";
+        case GL_R32F:
+            return "r32f";
+        case GL_RG32F:
+            return "rg32f";
+        default:
+            return "rgba32f";
+    }
+}
+//----------------------------------------------------------------------------//
 } // end namespace gpuip
@@ -33,7 +33,7 @@ namespace gpuip {
 class GLSLImpl : public ImageProcessor
 {
   public:
-    GLSLImpl();
+    GLSLImpl(GLSLShader shader);
 
     virtual ~GLSLImpl();
 
@@ -43,35 +43,94 @@ class GLSLImpl : public ImageProcessor
 
     virtual double Run(std::string * err);
     
-    virtual double Copy(Buffer::Ptr buffer,
-                        Buffer::CopyOperation op,
-                        void * data,
-                        std::string * err);
+    virtual double CopyRows(Buffer::Ptr buffer,
+                            Buffer::CopyOperation op,
+                            void * data,
+                            unsigned int y0,
+                            unsigned int y1,
+                            std::string * err);
+
+    virtual bool Finish(std::string * err);
 
     virtual std::string BoilerplateCode(Kernel::Ptr kernel) const;
     
   protected:
     bool _glewInit;
     bool _glContextCreated;
-    GLint64 _timer;
+    const GLSLShader _shader;
+    double _start; // ms
     GLuint _vbo;
     GLuint _rboId;
     GLuint _vertexShaderID;
     std::vector<GLuint> _fbos;
     std::vector<GLuint> _programs;
     std::map<std::string, GLuint> _textures;
+    std::vector<GLuint> _uploadPbos;
+    std::vector<GLsync> _uploadFences;
+    size_t _uploadPbo;
+    std::vector<GLuint> _readPbos;
+    GLuint _readFbo;
 
     bool _DrawQuad(const Kernel & kernel,
                    GLuint fbo,
                    GLuint program,
                    std::string * error);
 
+    bool _Dispatch(const Kernel & kernel,
+                   GLuint program,
+                   std::string * error);
+
+    std::string _ComputeBoilerplateCode(Kernel::Ptr kernel) const;
+
+    bool _Upload(Buffer::Ptr buffer,
+                 const void * data,
+                 unsigned int y0,
+                 unsigned int y1,
+                 std::string * err);
+
+    bool _Download(Buffer::Ptr buffer,
+                   void * data,
+                   unsigned int y0,
+                   unsigned int y1,
+                   std::string * err);
+
+    // Waits for the read into pbo and copies size bytes from offset to data
+    bool _ReadPbo(Buffer::Ptr buffer,
+                  GLuint pbo,
+                  GLsync fence,
+                  size_t offset,
+                  size_t size,
+                  void * data,
+                  std::string * err);
+
     bool _InitGLEW(std::string * err);
 
+    // Ring of GL_TIME_ELAPSED queries for one kind of call
+    struct TimerQueries
+    {
+        TimerQueries() : next(0), last(0), active(false) {}
+        std::vector<GLuint> ids;
+        std::vector<bool> pending;
+        size_t next;
+        double last;
+        bool active;
+    };
+    TimerQueries _runQueries;
+    TimerQueries _uploadQueries;
+    TimerQueries _downloadQueries;
+
+    // Cpu timer for Allocate and Build
     void _StartTimer();
 
     double _StopTimer();
 
+    // Asynchronous gpu timer for Run and Copy
+    void _BeginQuery(TimerQueries & queries);
+
+    double _EndQuery(TimerQueries & queries, bool wait);
+
+    void _DeleteQueries(TimerQueries & queries);
+
     void _DeleteBuffers();
 };
 //----------------------------------------------------------------------------//
@@ -71,6 +71,41 @@ inline bool _glCheckBuildError(GLuint shader,
     return false;
 }
 //----------------------------------------------------------------------------//
+inline bool _glCheckComputeBuildError(GLuint program,
+                                      GLuint compute_shader,
+                                      std::string * err)
+{
+    GLint gl_err;
+    glGetProgramiv(program, GL_LINK_STATUS, &gl_err);
+    if (gl_err == 0) {
+        std::stringstream ss;
+        GLchar errorLog[ERROR_BUFSIZE];
+        GLsizei length;
+
+        ss << "GLSL build error.\n";
+
+        glGetShaderInfoLog(compute_shader, ERROR_BUFSIZE, &length, errorLog);
+        ss << "Compute shader errors:\n" << std::string(errorLog, length);
+
+        glGetProgramInfoLog(program, ERROR_BUFSIZE, &length, errorLog);
+        ss << "\nLinker errors:\n" << std::string(errorLog, length);
+
+        (*err) += ss.str();
+
+        return true;
+    }
+    return false;
+}
+//----------------------------------------------------------------------------//
+inline bool _glErrorComputeShader(std::string * err)
+{
+    if (!GLEW_VERSION_4_3) {
+        (*err) += "GLSL error: compute shaders require OpenGL 4.3.\n";
+        return true;
+    }
+    return false;
+}
+//----------------------------------------------------------------------------//
 inline bool _glErrorFramebuffer(std::string * err)
 {
     GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
@@ -23,6 +23,8 @@ SOFTWARE.
 */
 
 #include "gpuip.h"
+#include <cstdlib>
+#include <sstream>
 //----------------------------------------------------------------------------//
 #ifdef _GPUIP_OPENCL
 #include "opencl.h"
@@ -39,23 +41,36 @@ SOFTWARE.
 namespace gpuip {
 //----------------------------------------------------------------------------//
 ImageProcessor::Ptr ImageProcessor::Create(GpuEnvironment env)
+{
+    return Create(env, DefaultDevice(env));
+}
+//----------------------------------------------------------------------------//
+Device ImageProcessor::DefaultDevice(GpuEnvironment env)
+{
+    // CUDA has always picked the fastest device. OpenCL benchmarks every
+    // device to find it, which is too slow to do by default.
+    return Device(Device::GPU, env == CUDA ? GPUIP_FASTEST_DEVICE : 0);
+}
+//----------------------------------------------------------------------------//
+ImageProcessor::Ptr ImageProcessor::Create(GpuEnvironment env,
+                                           const Device & device)
 {
     switch(env) {
         case OpenCL:
 #ifdef _GPUIP_OPENCL
-            return ImageProcessor::Ptr(new OpenCLImpl());
+            return ImageProcessor::Ptr(new OpenCLImpl(device));
 #else
             throw std::logic_error("gpuip was not built with OpenCL");
 #endif
         case CUDA:
 #ifdef _GPUIP_CUDA
-            return ImageProcessor::Ptr(new CUDAImpl());
+            return ImageProcessor::Ptr(new CUDAImpl(device));
 #else
             throw std::logic_error("gpuip was not built with CUDA");
 #endif
         case GLSL:
 #ifdef _GPUIP_GLSL
-            return ImageProcessor::Ptr(new GLSLImpl());
+            return ImageProcessor::Ptr(new GLSLImpl(FRAGMENT_SHADER));
 #else
             throw std::logic_error("gpuip was not built with GLSL");
 #endif
@@ -65,6 +80,30 @@ ImageProcessor::Ptr ImageProcessor::Create(GpuEnvironment env)
     }
 }
 //----------------------------------------------------------------------------//
+ImageProcessor::Ptr
+ImageProcessor::Create(GpuEnvironment env, const std::vector<Device> & devices)
+{
+    if (devices.empty()) {
+        throw std::logic_error("gpuip::ImageProcessor::Create needs at least "
+                               "one device");
+    }
+#ifdef _GPUIP_OPENCL
+    if (env == OpenCL) {
+        return ImageProcessor::Ptr(new OpenCLImpl(devices));
+    }
+#endif
+    return Create(env, devices.front());
+}
+//----------------------------------------------------------------------------//
+ImageProcessor::Ptr ImageProcessor::CreateGLSL(GLSLShader shader)
+{
+#ifdef _GPUIP_GLSL
+    return ImageProcessor::Ptr(new GLSLImpl(shader));
+#else
+    throw std::logic_error("gpuip was not built with GLSL");
+#endif
+}
+//----------------------------------------------------------------------------//
 bool ImageProcessor::CanCreate(GpuEnvironment env)
 {
     switch(env) {
@@ -91,23 +130,70 @@ bool ImageProcessor::CanCreate(GpuEnvironment env)
     }
 }
 //----------------------------------------------------------------------------//
+std::vector<Device> ImageProcessor::ListDevices(GpuEnvironment env)
+{
+    switch(env) {
+        case OpenCL:
+#ifdef _GPUIP_OPENCL
+            return OpenCLImpl::ListDevices();
+#else
+            break;
+#endif
+        case CUDA:
+#ifdef _GPUIP_CUDA
+            return CUDAImpl::ListDevices();
+#else
+            break;
+#endif
+        default:
+            break;
+    }
+    return std::vector<Device>();
+}
+//----------------------------------------------------------------------------//
+Device::Device(Type type_, int index_, int platform_)
+        : type(type_), index(index_), platform(platform_)
+{
+}
+//----------------------------------------------------------------------------//
 Buffer::Buffer(const std::string & name_, Type type_, unsigned int channels_)
-        : name(name_), type(type_), channels(channels_)
+        : name(name_), type(type_), channels(channels_), storage(LINEAR)
 {
 }
 //----------------------------------------------------------------------------//
 Kernel::Kernel(const std::string & name_)
-        : name(name_)
+        : name(name_), radius(0), flopsPerPixel(0)
+{
+}
+//----------------------------------------------------------------------------//
+KernelReport::KernelReport()
+        : bytesRead(0), bytesWritten(0), flops(0), time(0)
 {
 }
 //----------------------------------------------------------------------------//
+double KernelReport::Bandwidth() const
+{
+    return time > 0 ? (bytesRead + bytesWritten) / (time * 1e6) : 0;
+}
+//----------------------------------------------------------------------------//
+double KernelReport::FlopRate() const
+{
+    return time > 0 ? flops / (time * 1e6) : 0;
+}
+//----------------------------------------------------------------------------//
+double KernelReport::Intensity() const
+{
+    const double bytes = bytesRead + bytesWritten;
+    return bytes > 0 ? flops / bytes : 0;
+}
+//----------------------------------------------------------------------------//
 Kernel::BufferLink::BufferLink(Buffer::Ptr buffer_, const std::string & name_)
         : buffer(buffer_), name(name_)
 {
 }
 //----------------------------------------------------------------------------//
 ImageProcessor::ImageProcessor(GpuEnvironment env)
-        : _env(env), _w(0), _h(0)
+        : _env(env), _w(0), _h(0), _timing(true)
 {
     
 }
@@ -160,7 +246,78 @@ double ImageProcessor::Copy(Buffer::Ptr buffer,
                             void * data,
                             std::string * error)
 {
-    throw std::logic_error("'Copy' not implemented in subclass");
+    return CopyRows(buffer, operation, data, 0, _h, error);
+}
+//----------------------------------------------------------------------------//
+double ImageProcessor::CopyRows(Buffer::Ptr buffer,
+                                Buffer::CopyOperation operation,
+                                void * data,
+                                unsigned int y0,
+                                unsigned int y1,
+                                std::string * error)
+{
+    throw std::logic_error("'CopyRows' not implemented in subclass");
+}
+//----------------------------------------------------------------------------//
+bool ImageProcessor::Finish(std::string * error)
+{
+    return true;
+}
+//----------------------------------------------------------------------------//
+void * ImageProcessor::AllocateHostMemory(Buffer::Ptr buffer,
+                                          std::string * error)
+{
+    // Ordinary memory unless the environment can do better
+    void * data = std::malloc(_BufferSize(buffer));
+    if (data == NULL) {
+        (*error) += "Could not allocate host memory for buffer ";
+        (*error) += buffer->name;
+        (*error) += "\n";
+    }
+    return data;
+}
+//----------------------------------------------------------------------------//
+bool ImageProcessor::FreeHostMemory(void * data, std::string * error)
+{
+    std::free(data);
+    return true;
+}
+//----------------------------------------------------------------------------//
+bool ImageProcessor::RegisterHostMemory(void * data,
+                                        size_t bytes,
+                                        std::string * error)
+{
+    // Ordinary memory is copied as it is
+    return true;
+}
+//----------------------------------------------------------------------------//
+bool ImageProcessor::UnregisterHostMemory(void * data, std::string * error)
+{
+    return true;
+}
+//----------------------------------------------------------------------------//
+std::vector<KernelReport> ImageProcessor::KernelReports() const
+{
+    std::vector<KernelReport> reports(_kernels.size());
+    for(size_t i = 0; i < _kernels.size(); ++i) {
+        const Kernel & kernel = *_kernels[i];
+        KernelReport & r = reports[i];
+        r.name = kernel.name;
+        for(size_t j = 0; j < kernel.inBuffers.size(); ++j) {
+            r.bytesRead += _BufferSize(kernel.inBuffers[j].buffer);
+        }
+        for(size_t j = 0; j < kernel.outBuffers.size(); ++j) {
+            r.bytesWritten += _BufferSize(kernel.outBuffers[j].buffer);
+        }
+        r.flops = kernel.flopsPerPixel * _w * _h;
+        r.time = i < _kernelTimes.size() ? _kernelTimes[i] : 0;
+    }
+    return reports;
+}
+//----------------------------------------------------------------------------//
+double ImageProcessor::PeakBandwidth() const
+{
+    return 0;
 }
 //----------------------------------------------------------------------------//
 std::string ImageProcessor::BoilerplateCode(Kernel::Ptr kernel) const
@@ -168,9 +325,15 @@ std::string ImageProcessor::BoilerplateCode(Kernel::Ptr kernel) const
     throw std::logic_error("'BoilerplateCode' not implemented in subclass");
 }
 //----------------------------------------------------------------------------//
-unsigned int  ImageProcessor::_BufferSize(Buffer::Ptr buffer) const
+size_t ImageProcessor::_BufferSize(Buffer::Ptr buffer) const
+{
+    // size_t first, 16K x 16K pixels of 4 floats do not fit 32 bits
+    return _BytesPerPixel(buffer) * _w * _h;
+}
+//----------------------------------------------------------------------------//
+size_t ImageProcessor::_BytesPerPixel(Buffer::Ptr buffer) const
 {
-    unsigned int bpp = 0; // bytes per pixel
+    size_t bpp = 0; // bytes per pixel
     switch(buffer->type) {
         case Buffer::UNSIGNED_BYTE:
             bpp = buffer->channels;
@@ -182,7 +345,22 @@ unsigned int  ImageProcessor::_BufferSize(Buffer::Ptr buffer) const
             bpp = sizeof(float) * buffer->channels;
             break;
     }
-    return bpp * _w * _h;
+    return bpp;
+}
+//----------------------------------------------------------------------------//
+bool ImageProcessor::_ValidRows(Buffer::Ptr buffer,
+                                unsigned int y0,
+                                unsigned int y1,
+                                std::string * error) const
+{
+    if (y0 > y1 || y1 > _h) {
+        std::stringstream ss;
+        ss << "Invalid rows [" << y0 << ", " << y1 << ") for buffer "
+           << buffer->name << " of height " << _h << "\n";
+        (*error) += ss.str();
+        return false;
+    }
+    return true;
 }
 //----------------------------------------------------------------------------//
 } // end namespace gpuip
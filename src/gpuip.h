@@ -45,6 +45,18 @@ namespace gpuip {
   it will return this value instead. */
 #define GPUIP_ERROR -1.0
 //----------------------------------------------------------------------------//
+/*! Device::index value that picks the fastest matching device. OpenCL runs a
+  small benchmark kernel on each device, CUDA compares multiprocessor count
+  and clock rate. */
+#define GPUIP_FASTEST_DEVICE -1
+//----------------------------------------------------------------------------//
+/*! Device::platform value that searches the devices of all platforms. */
+#define GPUIP_ANY_PLATFORM -1
+//----------------------------------------------------------------------------//
+/*! Width and height in pixels of the blocks/work groups that kernels are
+  launched in. Tiled stencil kernels load one tile of this size plus halo. */
+#define GPUIP_TILE_SIZE 16
+//----------------------------------------------------------------------------//
 /*! Different GPU environments available. */
 enum GpuEnvironment {
     /*! <a href="https://www.khronos.org/opencl/">
@@ -59,6 +71,68 @@ enum GpuEnvironment {
       GLSL, OpenGL Shading Language by Khronos Group.</a> */
     GLSL };
 //----------------------------------------------------------------------------//
+/*! Shader stage that GLSL kernels are written for, see
+  ImageProcessor::CreateGLSL. */
+enum GLSLShader {
+    /*! Fragment shader (version 120) drawn as a fullscreen quad into a
+      framebuffer. This is the default. */
+    FRAGMENT_SHADER,
+
+    /*! Compute shader (version 430) dispatched in \ref GPUIP_TILE_SIZE
+      squared work groups. Buffers are image2D uniforms accessed with
+      imageLoad/imageStore, so there is no limit on the number of outputs and
+      stencils can use shared memory. Requires OpenGL 4.3 and buffers with
+      1, 2 or 4 channels. */
+    COMPUTE_SHADER };
+//----------------------------------------------------------------------------//
+/*!
+  \struct Device
+  \brief Describes which compute device an ImageProcessor should run on.
+
+  Passed to ImageProcessor::Create to choose something else than the first GPU
+  of the first platform. ImageProcessor::ListDevices returns one Device per
+  available device, each of which can be passed straight back to
+  ImageProcessor::Create.
+*/
+struct Device
+{
+    /*! \brief Kinds of compute devices */
+    enum Type{
+        /*! Graphics card */
+        GPU,
+
+        /*! Host processor. Needs a CPU runtime, i.e. OpenCL on the CPU. */
+        CPU,
+
+        /*! Dedicated accelerator card */
+        ACCELERATOR,
+
+        /*! Any kind of device */
+        ALL };
+
+    Device(Type type = GPU, int index = 0, int platform = 0);
+
+    /*! \brief Kind of device to look for. */
+    Type type;
+
+    /*! \brief Index among the devices of the given type.
+
+      \ref GPUIP_FASTEST_DEVICE runs a benchmark on all matching devices and
+      picks the fastest one. */
+    int index;
+
+    /*! \brief Index of the platform (OpenCL only).
+
+      \ref GPUIP_ANY_PLATFORM searches the devices of all platforms. */
+    int platform;
+
+    /*! \brief Name of the device. Set by ImageProcessor::ListDevices. */
+    std::string name;
+
+    /*! \brief Name of the platform. Set by ImageProcessor::ListDevices. */
+    std::string platformName;
+};
+//----------------------------------------------------------------------------//
 /*!
   \struct Buffer
   \brief A chunk of memory allocated on the GPU.
@@ -91,6 +165,18 @@ struct Buffer
         /*! 32 bits per channel. Used in exr images, typically when half is
           not supported in the current environemnt. */
         FLOAT };
+
+    /*! \brief How the buffer is stored on the GPU */
+    enum Storage{
+        /*! Linear memory, indexed manually in the kernel. */
+        LINEAR,
+
+        /*! 2D image, accessed with read_imagef/write_imagef through a
+          sampler. Reads go through the texture cache and are clamped to the
+          image edges. Only OpenCL supports images and only with 1, 2 or 4
+          channels. UNSIGNED_BYTE images are normalized to [0,1] in the
+          kernel. Other environments treat it as LINEAR. */
+        IMAGE };
     
     Buffer(const std::string & name, Type type, unsigned int channels);
 
@@ -107,6 +193,11 @@ struct Buffer
       A typical RGBA image has 4 channels. Gpuip buffers  with 2 or 3 channels
       have not been tested as much as 1 or 4 channel buffers. */
     unsigned int channels;
+
+    /*! \brief Storage on the GPU. Default is LINEAR.
+
+      Has to be set before gpuip::ImageProcessor::Allocate is called. */
+    Storage storage;
 };
 //----------------------------------------------------------------------------//
 /*!
@@ -182,6 +273,69 @@ struct Kernel
 
      Must be set before the ImageProcessor::Run call. */
     std::vector<Parameter<float> > paramsFloat;
+
+    /*! \brief Radius in pixels of the neighbourhood read around each pixel.
+
+     0 (the default) means the kernel only reads the pixel it writes to.
+     Stencils such as blurs should set this to their kernel radius. Used to
+     size the overlap between devices when the image is split over several
+     of them. Must be set before the ImageProcessor::Run call.
+
+     In OpenCL and CUDA, a radius above 0 also makes
+     ImageProcessor::BoilerplateCode generate a tiled stencil kernel that
+     loads a 16x16 tile plus halo of every input buffer into local/shared
+     memory, and makes OpenCL launch the kernel in 16x16 work groups.
+     ImageProcessor::Build then fails if the (16 + 2 * radius)^2 tiles do
+     not fit the local/shared memory of the device. */
+    unsigned int radius;
+
+    /*! \brief Estimated floating point operations per output pixel.
+
+     Only used to report FLOP rates and arithmetic intensity in
+     ImageProcessor::KernelReports. 0 (the default) means unknown. */
+    double flopsPerPixel;
+};
+//----------------------------------------------------------------------------//
+/*!
+  \struct KernelReport
+  \brief Memory traffic and achieved throughput of a kernel in the latest
+  ImageProcessor::Run.
+
+  The traffic is the size of every bound input buffer read once and every
+  bound output buffer written once. Stencils that read neighbours from
+  caches or local memory come close to this, so the bandwidth compared with
+  ImageProcessor::PeakBandwidth shows how close a kernel is to being
+  bandwidth-bound, e.g. whether fusing it with its neighbours or storing
+  its buffers as halves would pay off.
+*/
+struct KernelReport
+{
+    KernelReport();
+
+    /*! \brief Kernel::name */
+    std::string name;
+
+    /*! \brief Bytes of the input buffers. */
+    double bytesRead;
+
+    /*! \brief Bytes of the output buffers. */
+    double bytesWritten;
+
+    /*! \brief Kernel::flopsPerPixel times the number of pixels. */
+    double flops;
+
+    /*! \brief Execution time in milliseconds from
+      ImageProcessor::KernelTimes, 0 if it was not measured. */
+    double time;
+
+    /*! \brief Achieved bandwidth in GB/s, 0 if the time is unknown. */
+    double Bandwidth() const;
+
+    /*! \brief Achieved GFLOP/s, 0 if the time or the flops are unknown. */
+    double FlopRate() const;
+
+    /*! \brief Floating point operations per byte of traffic. */
+    double Intensity() const;
 };
 //----------------------------------------------------------------------------//
 /*!
@@ -198,8 +352,64 @@ class ImageProcessor
     typedef std::tr1::shared_ptr<ImageProcessor> Ptr;
 #endif
 
-    /*! \brief Factory function to create an ImageProcessor entity. */
+    /*! \brief Factory function to create an ImageProcessor entity.
+
+      Runs on ImageProcessor::DefaultDevice of the environment. */
     static ImageProcessor::Ptr Create(GpuEnvironment env);
+
+    /*! \brief Device used by ImageProcessor::Create without a device.
+
+      CUDA picks the device with the most GFLOPS (\ref GPUIP_FASTEST_DEVICE,
+      estimated from the device properties), OpenCL the first GPU of the
+      first platform. */
+    static Device DefaultDevice(GpuEnvironment env);
+
+    /*! \brief Factory function to create an ImageProcessor entity that runs
+      on a specific device.
+      \param env gpu environment
+      \param device platform, device type and index to pick the device from
+
+      Throws std::logic_error if no matching device is found. GLSL runs on the
+      device of the OpenGL context and ignores \c device.
+    */
+    static ImageProcessor::Ptr Create(GpuEnvironment env,
+                                      const Device & device);
+
+    /*! \brief Factory function to create an ImageProcessor entity that splits
+      the work over several devices.
+      \param env gpu environment
+      \param devices devices to run on
+
+      Only OpenCL supports more than one device. Each ImageProcessor::Run then
+      splits the image into horizontal bands, one per device, sized by the
+      measured throughput of each device. Kernels with a Kernel::radius
+      compute an overlapping halo so that chained stencils stay correct.
+      Input buffers are copied in full to every device, output buffers are
+      gathered band by band. The halo of a buffer that is written by a kernel
+      and read again in the next ImageProcessor::Run is not exchanged between
+      devices, so such buffers have to be copied to the GPU again.
+
+      The other environments run on the first device of the list.
+    */
+    static ImageProcessor::Ptr Create(GpuEnvironment env,
+                                      const std::vector<Device> & devices);
+
+    /*! \brief Factory function to create a GLSL ImageProcessor for a shader
+      stage.
+      \param shader fragment or compute shader the kernels are written for
+
+      Textures, programs and boilerplate code differ between the stages, so
+      the stage is fixed for the lifetime of the ImageProcessor.
+      ImageProcessor::Create uses \ref FRAGMENT_SHADER. Throws
+      std::logic_error if gpuip was not built with GLSL.
+    */
+    static ImageProcessor::Ptr CreateGLSL(GLSLShader shader);
+
+    /*! \brief Lists the devices available in a GpuEnvironment.
+
+      Returns an empty list for GLSL and for environments gpuip was not
+      compiled with. */
+    static std::vector<Device> ListDevices(GpuEnvironment env);
     
     virtual ~ImageProcessor() {}
 
@@ -227,6 +437,59 @@ class ImageProcessor
         return _h;
     }
 
+    /*! \brief Enables or disables measuring of execution times.
+
+      Timing is enabled by default. When disabled, ImageProcessor::Allocate,
+      ImageProcessor::Build, ImageProcessor::Run and ImageProcessor::Copy
+      return 0 instead of their execution time and skip any synchronization
+      that is only done for timing.
+
+      GLSL times Run and Copy with asynchronous GL_TIME_ELAPSED queries so
+      that the GPU is never drained just to read a timer. They return the
+      time of the latest call of the same kind whose query has finished,
+      usually the previous call, and 0 until one has finished. Copies from
+      the GPU wait for their own query since they wait for the GPU anyway.
+    */
+    void SetTiming(bool enabled)
+    {
+        _timing = enabled;
+    }
+
+    /*! \brief Returns true if execution times are measured. */
+    bool Timing() const
+    {
+        return _timing;
+    }
+
+    /*! \brief Execution time of each kernel in the latest ImageProcessor::Run.
+
+      Times are in milliseconds and in the order the kernels were created.
+      OpenCL reports the slowest device of each kernel. The list is empty
+      when timing is disabled and in GLSL, whose asynchronous timer only
+      measures the whole run.
+    */
+    const std::vector<double> & KernelTimes() const
+    {
+        return _kernelTimes;
+    }
+
+    /*! \brief Memory traffic and throughput of each kernel in the latest
+      ImageProcessor::Run, in the order the kernels were created.
+
+      The traffic is computed from the current dimensions and the buffers
+      bound to each kernel, so it is available for every environment. The
+      times, and with them the bandwidth, are only known where
+      ImageProcessor::KernelTimes is.
+    */
+    std::vector<KernelReport> KernelReports() const;
+
+    /*! \brief Theoretical peak memory bandwidth of the device in GB/s.
+
+      CUDA computes it from the memory clock and bus width of the device.
+      OpenCL and GLSL have no way to query it and return 0.
+    */
+    virtual double PeakBandwidth() const;
+
     /*! \brief Creates a Buffer object with allocation info
 
       \param name Unique identifying name of buffer
@@ -305,6 +568,84 @@ class ImageProcessor
                         void * data,
                         std::string * error);
 
+    /*! \brief Data transfer of a range of rows between the CPU and the GPU.
+      \param buffer buffer on the gpu to copy to/from
+      \param operation decides if the copy is from the gpu or to the gpu
+      \param data points to the first row, row \c y0, in the CPU memory
+      \param y0 first row to copy
+      \param y1 one past the last row to copy
+      \param error if function fails, the explaining error string is stored here
+      \return execution time in milliseconds. \ref GPUIP_ERROR on failure
+
+      Copies the rows [y0, y1) of the buffer. \c data only needs to hold
+      those rows, tightly packed. Copying an image band by band lets the
+      next band be produced, e.g. decoded from a file, while the previous
+      one is transferred. ImageProcessor::Copy copies all rows.
+    */
+    virtual double CopyRows(Buffer::Ptr buffer,
+                            Buffer::CopyOperation operation,
+                            void * data,
+                            unsigned int y0,
+                            unsigned int y1,
+                            std::string * error);
+
+    /*! \brief Waits until the device has finished all issued work.
+      \param error if function fails, the explaining error string is stored here
+      \return false on failure
+
+      GLSL returns from ImageProcessor::Run and from copies to the GPU before
+      the GPU is done with them, so timing them with a host clock needs a
+      call to this function before reading the clock. OpenCL and CUDA
+      already wait in every call and do nothing.
+    */
+    virtual bool Finish(std::string * error);
+
+    /*! \brief Allocates host memory for staging copies of a buffer.
+      \param buffer buffer whose size (at the current dimensions) to allocate
+      \param error if function fails, the explaining error string is stored here
+      \return pointer to the memory, NULL on failure
+
+      Passing this memory to ImageProcessor::Copy avoids the extra copy into
+      driver owned memory. CUDA allocates page-locked memory with
+      cudaHostAlloc, OpenCL maps a CL_MEM_ALLOC_HOST_PTR buffer in the context
+      of the first device and GLSL, which already uploads through pixel buffer
+      objects, returns ordinary memory. The memory stays valid until
+      ImageProcessor::FreeHostMemory is called and must be freed before the
+      ImageProcessor is destroyed.
+    */
+    virtual void * AllocateHostMemory(Buffer::Ptr buffer, std::string * error);
+
+    /*! \brief Frees memory from ImageProcessor::AllocateHostMemory.
+      \param data pointer returned by ImageProcessor::AllocateHostMemory
+      \param error if function fails, the explaining error string is stored here
+      \return false on failure
+    */
+    virtual bool FreeHostMemory(void * data, std::string * error);
+
+    /*! \brief Pins memory that was not allocated by the ImageProcessor.
+      \param data start of the memory, e.g. a mapped shared memory segment
+      \param bytes size of the memory in bytes
+      \param error if function fails, the explaining error string is stored here
+      \return false on failure
+
+      Lets ImageProcessor::Copy transfer from and to memory owned by someone
+      else as fast as from ImageProcessor::AllocateHostMemory. CUDA
+      page-locks the memory with cudaHostRegister. The other environments
+      copy from ordinary memory and do nothing. The memory must be
+      unregistered with ImageProcessor::UnregisterHostMemory before it is
+      unmapped or freed.
+    */
+    virtual bool RegisterHostMemory(void * data,
+                                    size_t bytes,
+                                    std::string * error);
+
+    /*! \brief Undoes ImageProcessor::RegisterHostMemory.
+      \param data pointer passed to ImageProcessor::RegisterHostMemory
+      \param error if function fails, the explaining error string is stored here
+      \return false on failure
+    */
+    virtual bool UnregisterHostMemory(void * data, std::string * error);
+
     /*! \brief Returns a boilerplate code for a given kernel.
       \param kernel Kernel to be processed
       \return boilerplate code
@@ -322,10 +663,19 @@ class ImageProcessor
     const GpuEnvironment _env;
     unsigned int _w; // width
     unsigned int _h; // height
+    bool _timing;
+    std::vector<double> _kernelTimes;
     std::map<std::string, Buffer::Ptr> _buffers;
     std::vector<Kernel::Ptr> _kernels;
 
-    unsigned int _BufferSize(Buffer::Ptr buffer) const;
+    size_t _BufferSize(Buffer::Ptr buffer) const;
+
+    size_t _BytesPerPixel(Buffer::Ptr buffer) const;
+
+    bool _ValidRows(Buffer::Ptr buffer,
+                    unsigned int y0,
+                    unsigned int y1,
+                    std::string * error) const;
   
   private:
     ImageProcessor();
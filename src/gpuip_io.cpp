@@ -0,0 +1,1101 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Per Karlsson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "gpuip_io.h"
+#ifdef __APPLE__
+#define cimg_OS 0
+#endif
+#include <CImg.h>
+#include <OpenEXR/half.h>
+#include <OpenEXR/ImfHeader.h>
+#include <OpenEXR/ImfInputFile.h>
+#include <OpenEXR/ImfOutputFile.h>
+#include <OpenEXR/ImfChannelList.h>
+#include <OpenEXR/ImfFrameBuffer.h>
+#include <OpenEXR/ImfCompression.h>
+#include <OpenEXR/ImfLineOrder.h>
+#include <OpenEXR/ImfThreading.h>
+#include <OpenEXR/IlmThreadPool.h>
+#include <OpenEXR/IlmThreadSemaphore.h>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// Paths for newer instruction sets are compiled with a target attribute and
+// picked at run time, so they do not depend on the compiler flags
+#include <immintrin.h>
+#define GPUIP_IO_CPU_DISPATCH
+#endif
+//----------------------------------------------------------------------------//
+namespace gpuip {
+//----------------------------------------------------------------------------//
+namespace io {
+//----------------------------------------------------------------------------//
+// Conversion between the planar layout of CImg (one plane per channel) and
+// the interleaved layout of buffers. Both are walked row by row and the
+// common 8-bit RGB and RGBA cases are done 16 pixels at a time with SSE.
+template<typename T>
+struct _PlanarImage
+{
+    T * planar;
+    T * interleaved;
+    unsigned int width;
+    unsigned int height;
+    unsigned int planes;   // channels in the planar image
+    unsigned int channels; // channels in the interleaved image
+    bool toInterleaved;
+
+    void operator()(unsigned int y0, unsigned int y1) const;
+};
+//----------------------------------------------------------------------------//
+// Vectorized part of a row, returns the number of pixels done. Types and
+// channel counts without a fast path do no pixels.
+template<typename T>
+inline unsigned int _InterleaveRowSIMD(const T * const * from, T * to,
+                                       unsigned int width,
+                                       unsigned int channels)
+{
+    return 0;
+}
+//----------------------------------------------------------------------------//
+template<typename T>
+inline unsigned int _PlanarizeRowSIMD(const T * from, T * const * to,
+                                      unsigned int width,
+                                      unsigned int channels)
+{
+    return 0;
+}
+//----------------------------------------------------------------------------//
+#ifdef GPUIP_IO_CPU_DISPATCH
+inline bool _HasSSSE3()
+{
+    return __builtin_cpu_supports("ssse3");
+}
+//----------------------------------------------------------------------------//
+// 8-bit RGB rows 16 pixels at a time, returns the number of pixels done
+__attribute__((target("ssse3")))
+inline unsigned int _InterleaveRGBSSSE3(const unsigned char * const * from,
+                                        unsigned char * to,
+                                        unsigned int width)
+{
+    unsigned int i = 0;
+    // Each output vector gathers its bytes from the three planes
+    const char z = -1; // pshufb writes 0 for negative indices
+    const __m128i r0 = _mm_setr_epi8(0,z,z,1,z,z,2,z,z,3,z,z,4,z,z,5);
+    const __m128i g0 = _mm_setr_epi8(z,0,z,z,1,z,z,2,z,z,3,z,z,4,z,z);
+    const __m128i b0 = _mm_setr_epi8(z,z,0,z,z,1,z,z,2,z,z,3,z,z,4,z);
+    const __m128i r1 = _mm_setr_epi8(z,z,6,z,z,7,z,z,8,z,z,9,z,z,10,z);
+    const __m128i g1 = _mm_setr_epi8(5,z,z,6,z,z,7,z,z,8,z,z,9,z,z,10);
+    const __m128i b1 = _mm_setr_epi8(z,5,z,z,6,z,z,7,z,z,8,z,z,9,z,z);
+    const __m128i r2 = _mm_setr_epi8(z,11,z,z,12,z,z,13,z,z,14,z,z,15,z,z);
+    const __m128i g2 = _mm_setr_epi8(z,z,11,z,z,12,z,z,13,z,z,14,z,z,15,z);
+    const __m128i b2 = _mm_setr_epi8(10,z,z,11,z,z,12,z,z,13,z,z,14,z,z,15);
+    for(; i + 16 <= width; i += 16) {
+        const __m128i r = _mm_loadu_si128((const __m128i *)(from[0]+i));
+        const __m128i g = _mm_loadu_si128((const __m128i *)(from[1]+i));
+        const __m128i b = _mm_loadu_si128((const __m128i *)(from[2]+i));
+        __m128i * out = (__m128i *)(to + 3*i);
+        _mm_storeu_si128(out, _mm_or_si128(
+            _mm_or_si128(_mm_shuffle_epi8(r, r0), _mm_shuffle_epi8(g, g0)),
+            _mm_shuffle_epi8(b, b0)));
+        _mm_storeu_si128(out+1, _mm_or_si128(
+            _mm_or_si128(_mm_shuffle_epi8(r, r1), _mm_shuffle_epi8(g, g1)),
+            _mm_shuffle_epi8(b, b1)));
+        _mm_storeu_si128(out+2, _mm_or_si128(
+            _mm_or_si128(_mm_shuffle_epi8(r, r2), _mm_shuffle_epi8(g, g2)),
+            _mm_shuffle_epi8(b, b2)));
+    }
+    return i;
+}
+//----------------------------------------------------------------------------//
+__attribute__((target("ssse3")))
+inline unsigned int _PlanarizeRGBSSSE3(const unsigned char * from,
+                                       unsigned char * const * to,
+                                       unsigned int width)
+{
+    unsigned int i = 0;
+    // Each plane gathers its bytes from the three input vectors
+    const char z = -1; // pshufb writes 0 for negative indices
+    const __m128i r0 = _mm_setr_epi8(0,3,6,9,12,15,z,z,z,z,z,z,z,z,z,z);
+    const __m128i g0 = _mm_setr_epi8(1,4,7,10,13,z,z,z,z,z,z,z,z,z,z,z);
+    const __m128i b0 = _mm_setr_epi8(2,5,8,11,14,z,z,z,z,z,z,z,z,z,z,z);
+    const __m128i r1 = _mm_setr_epi8(z,z,z,z,z,z,2,5,8,11,14,z,z,z,z,z);
+    const __m128i g1 = _mm_setr_epi8(z,z,z,z,z,0,3,6,9,12,15,z,z,z,z,z);
+    const __m128i b1 = _mm_setr_epi8(z,z,z,z,z,1,4,7,10,13,z,z,z,z,z,z);
+    const __m128i r2 = _mm_setr_epi8(z,z,z,z,z,z,z,z,z,z,z,1,4,7,10,13);
+    const __m128i g2 = _mm_setr_epi8(z,z,z,z,z,z,z,z,z,z,z,2,5,8,11,14);
+    const __m128i b2 = _mm_setr_epi8(z,z,z,z,z,z,z,z,z,z,0,3,6,9,12,15);
+    for(; i + 16 <= width; i += 16) {
+        const __m128i * in = (const __m128i *)(from + 3*i);
+        const __m128i p0 = _mm_loadu_si128(in);
+        const __m128i p1 = _mm_loadu_si128(in+1);
+        const __m128i p2 = _mm_loadu_si128(in+2);
+        _mm_storeu_si128((__m128i *)(to[0]+i), _mm_or_si128(
+            _mm_or_si128(_mm_shuffle_epi8(p0,r0), _mm_shuffle_epi8(p1,r1)),
+            _mm_shuffle_epi8(p2, r2)));
+        _mm_storeu_si128((__m128i *)(to[1]+i), _mm_or_si128(
+            _mm_or_si128(_mm_shuffle_epi8(p0,g0), _mm_shuffle_epi8(p1,g1)),
+            _mm_shuffle_epi8(p2, g2)));
+        _mm_storeu_si128((__m128i *)(to[2]+i), _mm_or_si128(
+            _mm_or_si128(_mm_shuffle_epi8(p0,b0), _mm_shuffle_epi8(p1,b1)),
+            _mm_shuffle_epi8(p2, b2)));
+    }
+    return i;
+}
+#endif
+//----------------------------------------------------------------------------//
+#ifdef __SSE2__
+template<>
+inline unsigned int _InterleaveRowSIMD(const unsigned char * const * from,
+                                       unsigned char * to,
+                                       unsigned int width,
+                                       unsigned int channels)
+{
+    unsigned int i = 0;
+    if (channels == 4) {
+        for(; i + 16 <= width; i += 16) {
+            const __m128i r = _mm_loadu_si128((const __m128i *)(from[0]+i));
+            const __m128i g = _mm_loadu_si128((const __m128i *)(from[1]+i));
+            const __m128i b = _mm_loadu_si128((const __m128i *)(from[2]+i));
+            const __m128i a = _mm_loadu_si128((const __m128i *)(from[3]+i));
+            const __m128i rg_lo = _mm_unpacklo_epi8(r, g);
+            const __m128i rg_hi = _mm_unpackhi_epi8(r, g);
+            const __m128i ba_lo = _mm_unpacklo_epi8(b, a);
+            const __m128i ba_hi = _mm_unpackhi_epi8(b, a);
+            __m128i * out = (__m128i *)(to + 4*i);
+            _mm_storeu_si128(out,   _mm_unpacklo_epi16(rg_lo, ba_lo));
+            _mm_storeu_si128(out+1, _mm_unpackhi_epi16(rg_lo, ba_lo));
+            _mm_storeu_si128(out+2, _mm_unpacklo_epi16(rg_hi, ba_hi));
+            _mm_storeu_si128(out+3, _mm_unpackhi_epi16(rg_hi, ba_hi));
+        }
+    }
+#ifdef GPUIP_IO_CPU_DISPATCH
+    else if (channels == 3 && _HasSSSE3()) {
+        i = _InterleaveRGBSSSE3(from, to, width);
+    }
+#endif
+    return i;
+}
+//----------------------------------------------------------------------------//
+template<>
+inline unsigned int _PlanarizeRowSIMD(const unsigned char * from,
+                                      unsigned char * const * to,
+                                      unsigned int width,
+                                      unsigned int channels)
+{
+    unsigned int i = 0;
+    if (channels == 4) {
+        // Shift each channel down to the low byte of its 32-bit pixel and
+        // pack 4x4 pixels together
+        const __m128i mask = _mm_set1_epi32(0xff);
+        for(; i + 16 <= width; i += 16) {
+            const __m128i * in = (const __m128i *)(from + 4*i);
+            const __m128i p0 = _mm_loadu_si128(in);
+            const __m128i p1 = _mm_loadu_si128(in+1);
+            const __m128i p2 = _mm_loadu_si128(in+2);
+            const __m128i p3 = _mm_loadu_si128(in+3);
+            for(int k = 0; k < 4; ++k) {
+                const __m128i shift = _mm_cvtsi32_si128(8*k);
+                const __m128i c0 = _mm_and_si128(_mm_srl_epi32(p0,shift),mask);
+                const __m128i c1 = _mm_and_si128(_mm_srl_epi32(p1,shift),mask);
+                const __m128i c2 = _mm_and_si128(_mm_srl_epi32(p2,shift),mask);
+                const __m128i c3 = _mm_and_si128(_mm_srl_epi32(p3,shift),mask);
+                _mm_storeu_si128((__m128i *)(to[k]+i), _mm_packus_epi16(
+                    _mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3)));
+            }
+        }
+    }
+#ifdef GPUIP_IO_CPU_DISPATCH
+    else if (channels == 3 && _HasSSSE3()) {
+        i = _PlanarizeRGBSSSE3(from, to, width);
+    }
+#endif
+    return i;
+}
+#endif // __SSE2__
+//----------------------------------------------------------------------------//
+template<typename T>
+void _InterleaveRows(const _PlanarImage<T> & image,
+                     unsigned int y0,
+                     unsigned int y1)
+{
+    const unsigned int w = image.width;
+    const unsigned int c = image.channels;
+    const unsigned int n = std::min(image.planes, c);
+    const size_t stride = (size_t)w * image.height;
+    const T * from[4];
+    for(unsigned int j = y0; j < y1; ++j) {
+        const T * row = image.planar + (size_t)w * j;
+        T * to = image.interleaved + (size_t)c * w * j;
+        if (c == 1) {
+            std::memcpy(to, row, w * sizeof(T));
+            continue;
+        }
+        unsigned int i = 0;
+        if (n == c && c <= 4) {
+            for(unsigned int k = 0; k < n; ++k) {
+                from[k] = row + stride * k;
+            }
+            i = _InterleaveRowSIMD(from, to, w, c);
+        }
+        for(; i < w; ++i) {
+            for(unsigned int k = 0; k < n; ++k) {
+                to[c*i+k] = row[stride*k + i];
+            }
+            for(unsigned int k = n; k < c; ++k) {
+                to[c*i+k] = 0;
+            }
+        }
+    }
+}
+//----------------------------------------------------------------------------//
+template<typename T>
+void _PlanarizeRows(const _PlanarImage<T> & image,
+                    unsigned int y0,
+                    unsigned int y1)
+{
+    const unsigned int w = image.width;
+    const unsigned int c = image.channels;
+    const unsigned int n = std::min(image.planes, c);
+    const size_t stride = (size_t)w * image.height;
+    T * to[4];
+    for(unsigned int j = y0; j < y1; ++j) {
+        T * row = image.planar + (size_t)w * j;
+        const T * from = image.interleaved + (size_t)c * w * j;
+        if (c == 1) {
+            std::memcpy(row, from, w * sizeof(T));
+            continue;
+        }
+        unsigned int i = 0;
+        if (n == c && c <= 4) {
+            for(unsigned int k = 0; k < n; ++k) {
+                to[k] = row + stride * k;
+            }
+            i = _PlanarizeRowSIMD(from, to, w, c);
+        }
+        for(; i < w; ++i) {
+            for(unsigned int k = 0; k < n; ++k) {
+                row[stride*k + i] = from[c*i+k];
+            }
+        }
+    }
+}
+//----------------------------------------------------------------------------//
+template<typename T>
+void _PlanarImage<T>::operator()(unsigned int y0, unsigned int y1) const
+{
+    if (toInterleaved) {
+        _InterleaveRows(*this, y0, y1);
+    } else {
+        _PlanarizeRows(*this, y0, y1);
+    }
+}
+//----------------------------------------------------------------------------//
+template<typename F>
+class _BandTask : public IlmThread::Task
+{
+  public:
+    _BandTask(IlmThread::TaskGroup * group,
+              const F & f,
+              unsigned int y0,
+              unsigned int y1)
+            : IlmThread::Task(group), _f(f), _y0(y0), _y1(y1) {}
+
+    virtual void execute()
+    {
+        _f(_y0, _y1);
+    }
+  private:
+    const F _f;
+    const unsigned int _y0, _y1;
+};
+//----------------------------------------------------------------------------//
+// Runs f(y0, y1) over numThreads horizontal bands of rows. The bands run on
+// a pool of their own, the global OpenEXR pool is left to the files, and the
+// calling thread takes the last band.
+template<typename F>
+void _RunBands(const F & f, unsigned int height, int numThreads)
+{
+    const unsigned int bands = std::min(std::max(numThreads, 1),
+                                        (int)height);
+    if (bands <= 1) {
+        f(0, height);
+        return;
+    }
+
+    IlmThread::ThreadPool pool(bands - 1);
+    {
+        // The task group waits for all bands when it goes out of scope
+        IlmThread::TaskGroup group;
+        for(unsigned int b = 0; b + 1 < bands; ++b) {
+            pool.addTask(new _BandTask<F>(
+                &group, f, height * b / bands, height * (b+1) / bands));
+        }
+        f(height * (bands - 1) / bands, height);
+    }
+}
+//----------------------------------------------------------------------------//
+// The global OpenEXR pool is shared by all files that are read or written at
+// the same time. It only grows, since shrinking it waits for the tasks of the
+// other files. Each file is still limited to the threads it asks for.
+inline void _GrowGlobalThreads(int numThreads)
+{
+    static IlmThread::Semaphore lock(1);
+    lock.wait();
+    if (numThreads > Imf::globalThreadCount()) {
+        Imf::setGlobalThreadCount(numThreads);
+    }
+    lock.post();
+}
+//----------------------------------------------------------------------------//
+// Names of the EXR channels that hold the channels of a buffer. Without
+// explicit names a single channel is luminance (Y) and more channels are
+// R, G, B and A. When reading, a file with only luminance feeds R, G and B.
+inline std::vector<std::string>
+_ExrChannelNames(const std::vector<std::string> & names,
+                 unsigned int channels,
+                 const Imf::ChannelList * fileChannels)
+{
+    if (!names.empty()) {
+        if (names.size() != channels) {
+            throw std::runtime_error("gpuip::io: number of channel names does "
+                                     "not match the channels of the buffer");
+        }
+        return names;
+    }
+
+    static const char * rgba[] = { "R", "G", "B", "A" };
+    std::vector<std::string> out;
+    for(unsigned int k = 0; k < channels && k < 4; ++k) {
+        out.push_back(rgba[k]);
+        if (fileChannels == NULL) {
+            continue;
+        }
+        if (k < 3 && fileChannels->findChannel(rgba[k]) == NULL &&
+            fileChannels->findChannel("Y") != NULL) {
+            out.back() = "Y";
+        }
+    }
+    if (channels == 1 && fileChannels == NULL) {
+        out[0] = "Y";
+    }
+    return out;
+}
+//----------------------------------------------------------------------------//
+// Describes interleaved pixels as one slice per channel. Pixels are read
+// and written in place, OpenEXR converts between the pixel type of the file
+// and the slices.
+inline Imf::FrameBuffer _ExrFrameBuffer(char * data,
+                                        Imf::PixelType type,
+                                        const Imath::Box2i & dw,
+                                        const std::vector<std::string> & names)
+{
+    using namespace Imf;
+
+    const size_t bytes = type == HALF ? sizeof(half) : sizeof(float);
+    const size_t xStride = bytes * names.size();
+    const size_t yStride = xStride * (dw.max.x - dw.min.x + 1);
+    char * base = data - dw.min.x * xStride - dw.min.y * yStride;
+
+    // A file channel can only have one slice, channels that repeat an
+    // earlier one are filled by _CopyRepeatedChannels
+    FrameBuffer frameBuffer;
+    for(size_t k = 0; k < names.size(); ++k) {
+        if (std::find(names.begin(), names.begin() + k, names[k]) !=
+            names.begin() + k) {
+            continue;
+        }
+        const double fill = names[k] == "A" ? 1.0 : 0.0;
+        frameBuffer.insert(names[k].c_str(), Slice(type, base + k * bytes,
+                                                   xStride, yStride,
+                                                   1, 1, fill));
+    }
+    return frameBuffer;
+}
+//----------------------------------------------------------------------------//
+// Copies channels that read the same file channel as an earlier channel,
+// e.g. G and B of a luminance file, from that channel
+inline void _CopyRepeatedChannels(char * data,
+                                  Imf::PixelType type,
+                                  size_t pixels,
+                                  const std::vector<std::string> & names)
+{
+    const size_t bytes = type == Imf::HALF ? sizeof(half) : sizeof(float);
+    const size_t stride = bytes * names.size();
+    for(size_t k = 1; k < names.size(); ++k) {
+        const size_t j = std::find(names.begin(), names.end(), names[k]) -
+                names.begin();
+        if (j == k) {
+            continue;
+        }
+        for(size_t i = 0; i < pixels; ++i) {
+            std::memcpy(data + i * stride + k * bytes,
+                        data + i * stride + j * bytes, bytes);
+        }
+    }
+}
+//----------------------------------------------------------------------------//
+ExrOptions::ExrOptions()
+        : compression(EXR_PIZ), lineOrder(EXR_INCREASING_Y), chunkRows(0) {}
+//----------------------------------------------------------------------------//
+inline Imf::Compression _ExrCompression(ExrCompression compression)
+{
+    using namespace Imf;
+    switch(compression) {
+        case EXR_NONE:
+            return NO_COMPRESSION;
+        case EXR_RLE:
+            return RLE_COMPRESSION;
+        case EXR_ZIPS:
+            return ZIPS_COMPRESSION;
+        case EXR_ZIP:
+            return ZIP_COMPRESSION;
+        case EXR_PIZ:
+            return PIZ_COMPRESSION;
+        case EXR_PXR24:
+            return PXR24_COMPRESSION;
+        case EXR_B44:
+            return B44_COMPRESSION;
+        case EXR_B44A:
+            return B44A_COMPRESSION;
+#ifdef _GPUIP_EXR_DWA
+        case EXR_DWAA:
+            return DWAA_COMPRESSION;
+        case EXR_DWAB:
+            return DWAB_COMPRESSION;
+#endif
+        default:
+            throw std::runtime_error("gpuip::io: DWAA and DWAB compression "
+                                     "need OpenEXR 2.2 or later");
+    }
+}
+//----------------------------------------------------------------------------//
+#ifdef GPUIP_IO_CPU_DISPATCH
+inline bool _HasF16C()
+{
+    return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+}
+//----------------------------------------------------------------------------//
+// Converts whole groups of 8 values, returns the number of values done
+__attribute__((target("avx,f16c")))
+inline size_t _HalfToFloatF16C(const half * from, float * to, size_t n)
+{
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(to + i, _mm256_cvtph_ps(_mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(from + i))));
+    }
+    return i;
+}
+//----------------------------------------------------------------------------//
+__attribute__((target("avx,f16c")))
+inline size_t _FloatToHalfF16C(const float * from, half * to, size_t n)
+{
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(to + i),
+                         _mm256_cvtps_ph(_mm256_loadu_ps(from + i),
+                                         _MM_FROUND_TO_NEAREST_INT));
+    }
+    return i;
+}
+#endif
+//----------------------------------------------------------------------------//
+// Converts n values of a buffer type to float, unsigned bytes are
+// normalized. F16C converts 8 halfs per instruction.
+inline void _ToFloat(const void * from, Buffer::Type type, float * to,
+                     size_t n)
+{
+    size_t i = 0;
+    switch(type) {
+        case Buffer::UNSIGNED_BYTE:
+            for(; i < n; ++i) {
+                to[i] = static_cast<const unsigned char *>(from)[i] / 255.0f;
+            }
+            break;
+        case Buffer::HALF:
+#ifdef GPUIP_IO_CPU_DISPATCH
+            if (_HasF16C()) {
+                i = _HalfToFloatF16C(static_cast<const half *>(from), to, n);
+            }
+#endif
+            for(; i < n; ++i) {
+                to[i] = static_cast<const half *>(from)[i];
+            }
+            break;
+        default:
+            std::memcpy(to, from, n * sizeof(float));
+            break;
+    }
+}
+//----------------------------------------------------------------------------//
+// Converts n floats to a buffer type, unsigned bytes are clamped. F16C
+// rounds to nearest even like the half class.
+inline void _FromFloat(const float * from, void * to, Buffer::Type type,
+                       size_t n)
+{
+    size_t i = 0;
+    switch(type) {
+        case Buffer::UNSIGNED_BYTE:
+            for(; i < n; ++i) {
+                const float v = std::min(std::max(from[i], 0.0f), 1.0f);
+                static_cast<unsigned char *>(to)[i] =
+                        (unsigned char)(v * 255.0f + 0.5f);
+            }
+            break;
+        case Buffer::HALF:
+#ifdef GPUIP_IO_CPU_DISPATCH
+            if (_HasF16C()) {
+                i = _FloatToHalfF16C(from, static_cast<half *>(to), n);
+            }
+#endif
+            for(; i < n; ++i) {
+                static_cast<half *>(to)[i] = from[i];
+            }
+            break;
+        default:
+            std::memcpy(to, from, n * sizeof(float));
+            break;
+    }
+}
+//----------------------------------------------------------------------------//
+inline size_t _TypeSize(Buffer::Type type)
+{
+    return type == Buffer::UNSIGNED_BYTE ? 1 :
+            (type == Buffer::HALF ? sizeof(half) : sizeof(float));
+}
+//----------------------------------------------------------------------------//
+// Converts n values between buffer types, unsigned bytes are normalized.
+// Values go through float in blocks that stay in the L1 cache.
+inline void _ConvertPixels(const void * from,
+                           Buffer::Type fromType,
+                           void * to,
+                           Buffer::Type toType,
+                           size_t n)
+{
+    const size_t fromSize = _TypeSize(fromType);
+    const size_t toSize = _TypeSize(toType);
+    float block[1024];
+    for(size_t i = 0; i < n; i += 1024) {
+        const size_t m = std::min(n - i, (size_t)1024);
+        _ToFloat(static_cast<const char *>(from) + i * fromSize, fromType,
+                 block, m);
+        _FromFloat(block, static_cast<char *>(to) + i * toSize, toType, m);
+    }
+}
+//----------------------------------------------------------------------------//
+// Converts rows of rowValues values between buffer types
+struct _ConvertRows
+{
+    const void * from;
+    Buffer::Type fromType;
+    void * to;
+    Buffer::Type toType;
+    size_t rowValues;
+
+    void operator()(unsigned int y0, unsigned int y1) const
+    {
+        const size_t first = rowValues * y0;
+        _ConvertPixels(static_cast<const char *>(from) +
+                       first * _TypeSize(fromType), fromType,
+                       static_cast<char *>(to) + first * _TypeSize(toType),
+                       toType, rowValues * (y1 - y0));
+    }
+};
+//----------------------------------------------------------------------------//
+// Converts an image between buffer types, in bands of rows on the threads
+inline void _ConvertImage(const void * from,
+                          Buffer::Type fromType,
+                          void * to,
+                          Buffer::Type toType,
+                          size_t rowValues,
+                          unsigned int height,
+                          int numThreads)
+{
+    _ConvertRows convert;
+    convert.from = from;
+    convert.fromType = fromType;
+    convert.to = to;
+    convert.toType = toType;
+    convert.rowValues = rowValues;
+    _RunBands(convert, height, numThreads);
+}
+//----------------------------------------------------------------------------//
+inline bool _IsExr(const std::string & filename)
+{
+    const size_t dot = filename.rfind('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+    std::string ext = filename.substr(dot + 1);
+    for(size_t i = 0; i < ext.size(); ++i) {
+        ext[i] = std::tolower(ext[i]);
+    }
+    return ext == "exr";
+}
+//----------------------------------------------------------------------------//
+// Unsigned bytes are decoded to half and converted
+void _ReadExr(Imf::InputFile & file,
+              void * data,
+              Buffer::Type type,
+              unsigned int channels,
+              int numThreads,
+              const std::vector<std::string> & exrChannels)
+{
+    using namespace Imf;
+
+    const Imath::Box2i dw = file.header().dataWindow();
+    const std::vector<std::string> names =
+            _ExrChannelNames(exrChannels, channels, &file.header().channels());
+    const unsigned int width = dw.max.x - dw.min.x + 1;
+    const unsigned int height = dw.max.y - dw.min.y + 1;
+    const size_t pixels = (size_t)width * height;
+
+    std::vector<half> converted;
+    char * to = static_cast<char *>(data);
+    if (type == Buffer::UNSIGNED_BYTE) {
+        converted.resize(pixels * channels);
+        to = reinterpret_cast<char *>(&converted[0]);
+    }
+    const PixelType pixelType = type == Buffer::FLOAT ? FLOAT : HALF;
+
+    // Only the channels in the frame buffer are decoded
+    file.setFrameBuffer(_ExrFrameBuffer(to, pixelType, dw, names));
+    file.readPixels(dw.min.y, dw.max.y);
+    _CopyRepeatedChannels(to, pixelType, pixels, names);
+
+    if (type == Buffer::UNSIGNED_BYTE) {
+        _ConvertImage(&converted[0], Buffer::HALF, data, type,
+                      (size_t)width * channels, height, numThreads);
+    }
+}
+//----------------------------------------------------------------------------//
+// Half and float are interleaved as bytes and converted
+void _ReadCImg(const cimg_library::CImg<unsigned char> & image,
+               void * data,
+               Buffer::Type type,
+               unsigned int channels,
+               int numThreads)
+{
+    const size_t n = (size_t)image.width() * image.height() * channels;
+    std::vector<unsigned char> converted;
+    unsigned char * to = static_cast<unsigned char *>(data);
+    if (type != Buffer::UNSIGNED_BYTE) {
+        converted.resize(n);
+        to = &converted[0];
+    }
+
+    _PlanarImage<unsigned char> planar;
+    planar.planar = const_cast<unsigned char *>(image.data());
+    planar.interleaved = to;
+    planar.width = image.width();
+    planar.height = image.height();
+    planar.planes = image.spectrum();
+    planar.channels = channels;
+    planar.toInterleaved = true;
+    _RunBands(planar, planar.height, numThreads);
+
+    if (type != Buffer::UNSIGNED_BYTE) {
+        _ConvertImage(&converted[0], Buffer::UNSIGNED_BYTE, data, type,
+                      (size_t)image.width() * channels, image.height(),
+                      numThreads);
+    }
+}
+//----------------------------------------------------------------------------//
+// Unsigned bytes are converted to half
+void _WriteExr(const void * data,
+               Buffer::Type type,
+               unsigned int channels,
+               unsigned int width,
+               unsigned int height,
+               const std::string & filename,
+               int numThreads,
+               const std::vector<std::string> & exrChannels,
+               const ExrOptions & options)
+{
+    using namespace Imf;
+
+    std::vector<half> converted;
+    char * from = static_cast<char *>(const_cast<void *>(data));
+    if (type == Buffer::UNSIGNED_BYTE) {
+        converted.resize((size_t)width * height * channels);
+        _ConvertImage(data, type, &converted[0], Buffer::HALF,
+                      (size_t)width * channels, height, numThreads);
+        from = reinterpret_cast<char *>(&converted[0]);
+    }
+    const PixelType pixelType = type == Buffer::FLOAT ? FLOAT : HALF;
+    const std::vector<std::string> names =
+            _ExrChannelNames(exrChannels, channels, NULL);
+
+    _GrowGlobalThreads(numThreads);
+
+    Header header(width, height);
+    header.compression() = _ExrCompression(options.compression);
+    header.lineOrder() = options.lineOrder == EXR_DECREASING_Y ?
+            DECREASING_Y : INCREASING_Y;
+    for(size_t k = 0; k < names.size(); ++k) {
+        header.channels().insert(names[k].c_str(), Channel(pixelType));
+    }
+
+    // Each writePixels call hands its scanlines to the thread pool, which
+    // compresses up to two blocks per thread at a time
+    OutputFile file(filename.c_str(), header, numThreads);
+    file.setFrameBuffer(_ExrFrameBuffer(from, pixelType,
+                                        header.dataWindow(), names));
+    const unsigned int chunk = options.chunkRows ? options.chunkRows : height;
+    for(unsigned int y = 0; y < height; y += chunk) {
+        file.writePixels(std::min(chunk, height - y));
+    }
+}
+//----------------------------------------------------------------------------//
+// Half and float are converted to bytes
+void _WriteCImg(const void * data,
+                Buffer::Type type,
+                unsigned int channels,
+                unsigned int width,
+                unsigned int height,
+                const std::string & filename,
+                int numThreads)
+{
+    std::vector<unsigned char> converted;
+    const unsigned char * from = static_cast<const unsigned char *>(data);
+    if (type != Buffer::UNSIGNED_BYTE) {
+        converted.resize((size_t)width * height * channels);
+        _ConvertImage(data, type, &converted[0], Buffer::UNSIGNED_BYTE,
+                      (size_t)width * channels, height, numThreads);
+        from = &converted[0];
+    }
+
+    cimg_library::CImg<unsigned char> image(width, height, 1, channels);
+    _PlanarImage<unsigned char> planar;
+    planar.planar = image.data();
+    planar.interleaved = const_cast<unsigned char *>(from);
+    planar.width = width;
+    planar.height = height;
+    planar.planes = channels;
+    planar.channels = channels;
+    planar.toInterleaved = false;
+    _RunBands(planar, height, numThreads);
+    image.save(filename.c_str());
+}
+//----------------------------------------------------------------------------//
+struct ImageReader::_Impl
+{
+    _Impl() : exr(NULL), width(0), height(0), numThreads(0) {}
+
+    ~_Impl()
+    {
+        delete exr;
+    }
+
+    Imf::InputFile * exr; // owned, NULL unless an exr file is open
+    cimg_library::CImg<unsigned char> image;
+    unsigned int width;
+    unsigned int height;
+    int numThreads;
+};
+//----------------------------------------------------------------------------//
+ImageReader::ImageReader()
+        : _impl(new _Impl)
+{
+}
+//----------------------------------------------------------------------------//
+ImageReader::~ImageReader()
+{
+    delete _impl;
+}
+//----------------------------------------------------------------------------//
+bool ImageReader::Open(const std::string & filename,
+                       std::string * error,
+                       int numThreads)
+{
+    delete _impl;
+    _impl = new _Impl;
+    _impl->numThreads = numThreads;
+    try {
+        if (_IsExr(filename)) {
+            _GrowGlobalThreads(numThreads);
+            _impl->exr = new Imf::InputFile(filename.c_str(), numThreads);
+            const Imath::Box2i dw = _impl->exr->header().dataWindow();
+            _impl->width = dw.max.x - dw.min.x + 1;
+            _impl->height = dw.max.y - dw.min.y + 1;
+        } else {
+            _impl->image.load(filename.c_str());
+            _impl->width = _impl->image.width();
+            _impl->height = _impl->image.height();
+        }
+    } catch (const std::exception & e) {
+        (*error) += e.what();
+        (*error) += "\n";
+        delete _impl;
+        _impl = new _Impl;
+        return false;
+    }
+    return true;
+}
+//----------------------------------------------------------------------------//
+unsigned int ImageReader::Width() const
+{
+    return _impl->width;
+}
+//----------------------------------------------------------------------------//
+unsigned int ImageReader::Height() const
+{
+    return _impl->height;
+}
+//----------------------------------------------------------------------------//
+bool ImageReader::Read(void * data,
+                       Buffer::Type type,
+                       unsigned int channels,
+                       std::string * error,
+                       const std::vector<std::string> & exrChannels)
+{
+    if (_impl->width == 0) {
+        (*error) += "No image is open\n";
+        return false;
+    }
+    try {
+        if (_impl->exr) {
+            _ReadExr(*_impl->exr, data, type, channels,
+                     _impl->numThreads, exrChannels);
+        } else {
+            _ReadCImg(_impl->image, data, type, channels, _impl->numThreads);
+        }
+    } catch (const std::exception & e) {
+        (*error) += e.what();
+        (*error) += "\n";
+        return false;
+    }
+    return true;
+}
+//----------------------------------------------------------------------------//
+bool WriteImage(const void * data,
+                Buffer::Type type,
+                unsigned int channels,
+                unsigned int width,
+                unsigned int height,
+                const std::string & filename,
+                std::string * error,
+                int numThreads,
+                const std::vector<std::string> & exrChannels,
+                const ExrOptions & options)
+{
+    try {
+        if (_IsExr(filename)) {
+            _WriteExr(data, type, channels, width, height, filename,
+                      numThreads, exrChannels, options);
+        } else {
+            _WriteCImg(data, type, channels, width, height, filename,
+                       numThreads);
+        }
+    } catch (const std::exception & e) {
+        (*error) += e.what();
+        (*error) += "\n";
+        return false;
+    }
+    return true;
+}
+//----------------------------------------------------------------------------//
+// Number of bands that are in flight between decoding and copying
+#define GPUIP_EXR_STREAM_BANDS 3
+//----------------------------------------------------------------------------//
+// Number of scanlines that OpenEXR compresses together
+inline unsigned int _LinesPerBlock(Imf::Compression compression)
+{
+    using namespace Imf;
+    switch(compression) {
+        case NO_COMPRESSION:
+        case RLE_COMPRESSION:
+        case ZIPS_COMPRESSION:
+            return 1;
+        case ZIP_COMPRESSION:
+            return 16;
+#ifdef _GPUIP_EXR_DWA
+        case DWAB_COMPRESSION:
+            return 256;
+#endif
+        default:
+            return 32;
+    }
+}
+//----------------------------------------------------------------------------//
+// State shared between the thread that decodes bands of an exr file and the
+// thread that copies them to the GPU. The free semaphore counts band slots
+// that can be decoded into, the ready semaphore counts decoded bands.
+struct _ExrStream
+{
+    _ExrStream()
+            : file(NULL), free(GPUIP_EXR_STREAM_BANDS), ready(0), abort(false) {}
+
+    ~_ExrStream()
+    {
+        delete file;
+    }
+
+    Imf::InputFile * file; // owned
+    Imf::PixelType type;
+    Imath::Box2i dw;
+    std::vector<std::string> names;
+    unsigned int bandRows;
+    std::vector<std::vector<char> > bands;
+    IlmThread::Semaphore free;
+    IlmThread::Semaphore ready;
+    bool abort;
+    std::string error;
+};
+//----------------------------------------------------------------------------//
+class _DecodeTask : public IlmThread::Task
+{
+  public:
+    _DecodeTask(IlmThread::TaskGroup * group, _ExrStream & stream)
+            : IlmThread::Task(group), _stream(stream) {}
+
+    virtual void execute()
+    {
+        _ExrStream & s = _stream;
+        for(int y = s.dw.min.y, i = 0; y <= s.dw.max.y; y += s.bandRows, ++i) {
+            s.free.wait();
+            if (s.abort) {
+                return;
+            }
+            // The frame buffer window starts at the band so that its rows
+            // land at the start of the band slot
+            Imath::Box2i window = s.dw;
+            window.min.y = y;
+            window.max.y = std::min(y + (int)s.bandRows - 1, s.dw.max.y);
+            std::vector<char> & band = s.bands[i % s.bands.size()];
+            try {
+                s.file->setFrameBuffer(
+                    _ExrFrameBuffer(&band[0], s.type, window, s.names));
+                s.file->readPixels(window.min.y, window.max.y);
+                _CopyRepeatedChannels(&band[0], s.type,
+                                      (size_t)(s.dw.max.x - s.dw.min.x + 1) *
+                                      (window.max.y - window.min.y + 1),
+                                      s.names);
+            } catch (const std::exception & e) {
+                s.error = e.what();
+                s.abort = true;
+                s.ready.post();
+                return;
+            }
+            s.ready.post();
+        }
+    }
+  private:
+    _ExrStream & _stream;
+};
+//----------------------------------------------------------------------------//
+double StreamToGPU(ImageProcessor & ip,
+                   Buffer::Ptr buffer,
+                   const std::string & filename,
+                   std::string * error,
+                   int numThreads,
+                   const std::vector<std::string> & channels)
+{
+    using namespace Imf;
+
+    if (buffer->type == Buffer::UNSIGNED_BYTE) {
+        (*error) += "Only half and float buffers can be streamed from exr, ";
+        (*error) += "buffer " + buffer->name + " is unsigned byte\n";
+        return GPUIP_ERROR;
+    }
+
+    _GrowGlobalThreads(numThreads);
+
+    _ExrStream stream;
+    try {
+        stream.file = new InputFile(filename.c_str(), numThreads);
+        stream.names = _ExrChannelNames(channels, buffer->channels,
+                                        &stream.file->header().channels());
+    } catch (const std::exception & e) {
+        (*error) += e.what();
+        (*error) += "\n";
+        return GPUIP_ERROR;
+    }
+    stream.type = buffer->type == Buffer::HALF ? HALF : FLOAT;
+    stream.dw = stream.file->header().dataWindow();
+
+    const unsigned int width = stream.dw.max.x - stream.dw.min.x + 1;
+    const unsigned int height = stream.dw.max.y - stream.dw.min.y + 1;
+    if (width != ip.Width() || height != ip.Height()) {
+        std::stringstream ss;
+        ss << "Image " << filename << " is " << width << "x" << height
+           << " but the image processor is " << ip.Width() << "x"
+           << ip.Height() << "\n";
+        (*error) += ss.str();
+        return GPUIP_ERROR;
+    }
+
+    // A band holds whole compressed blocks, enough of them to keep every
+    // thread of the OpenEXR pool decoding
+    stream.bandRows = _LinesPerBlock(stream.file->header().compression()) *
+            std::max(numThreads, 2);
+    const size_t bytes = stream.type == HALF ? sizeof(half) : sizeof(float);
+    stream.bands.resize(std::min(GPUIP_EXR_STREAM_BANDS,
+                                 (int)((height - 1) / stream.bandRows + 1)));
+    for(size_t i = 0; i < stream.bands.size(); ++i) {
+        stream.bands[i].resize(bytes * buffer->channels * width *
+                               stream.bandRows);
+    }
+
+    // Bands are decoded on a thread of their own while this thread, which
+    // owns the GPU context, copies the previous ones
+    double time = 0;
+    IlmThread::ThreadPool decoder(1);
+    {
+        IlmThread::TaskGroup group;
+        decoder.addTask(new _DecodeTask(&group, stream));
+        for(unsigned int y = 0, i = 0; y < height; y += stream.bandRows, ++i) {
+            stream.ready.wait();
+            if (!stream.error.empty()) {
+                (*error) += stream.error + "\n";
+                time = GPUIP_ERROR;
+                break;
+            }
+            const unsigned int y1 = std::min(y + stream.bandRows, height);
+            char * band = &stream.bands[i % stream.bands.size()][0];
+            const double t = ip.CopyRows(buffer, Buffer::COPY_TO_GPU, band,
+                                         y, y1, error);
+            if (t == GPUIP_ERROR) {
+                stream.abort = true;
+                stream.free.post();
+                time = GPUIP_ERROR;
+                break;
+            }
+            time += t;
+            stream.free.post();
+        }
+    } // waits for the decoding task
+    return time;
+}
+//----------------------------------------------------------------------------//
+} // end namespace io
+} // end namespace gpuip
+//----------------------------------------------------------------------------//
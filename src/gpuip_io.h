@@ -0,0 +1,147 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Per Karlsson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GPUIP_IO_H_
+#define GPUIP_IO_H_
+//----------------------------------------------------------------------------//
+#include "gpuip.h"
+#include <string>
+#include <vector>
+//----------------------------------------------------------------------------//
+namespace gpuip {
+//----------------------------------------------------------------------------//
+namespace io {
+//----------------------------------------------------------------------------//
+/* Compression of written exr files. DWAA and DWAB need OpenEXR 2.2. */
+enum ExrCompression {
+    EXR_NONE,
+    EXR_RLE,
+    EXR_ZIPS,
+    EXR_ZIP,
+    EXR_PIZ,
+    EXR_PXR24,
+    EXR_B44,
+    EXR_B44A,
+    EXR_DWAA,
+    EXR_DWAB };
+//----------------------------------------------------------------------------//
+enum ExrLineOrder {
+    EXR_INCREASING_Y,
+    EXR_DECREASING_Y };
+//----------------------------------------------------------------------------//
+/* How exr files are written. chunkRows is the number of scanlines handed to
+   the OpenEXR thread pool per write, 0 hands over the whole image at once. */
+struct ExrOptions
+{
+    ExrOptions();
+
+    ExrCompression compression; // PIZ by default
+    ExrLineOrder lineOrder;
+    unsigned int chunkRows;
+};
+//----------------------------------------------------------------------------//
+/* Reads an image into interleaved pixels of any buffer type, row by row from
+   the top. Files ending with .exr are read with OpenEXR, other formats
+   (png, jpeg, tiff, ...) with CImg as 8 bits per channel. Unsigned bytes
+   are normalized to [0,1] when converted to half or float.
+
+   Reading is done in two steps so that the caller can allocate the pixels,
+   or map the memory of a buffer, once the size of the image is known:
+
+     gpuip::io::ImageReader reader;
+     if (reader.Open(filename, &err)) {
+         std::vector<float> data(reader.Width() * reader.Height() * 4);
+         reader.Read(&data[0], gpuip::Buffer::FLOAT, 4, &err);
+     }
+
+   Open decodes the header of exr files and the whole image otherwise. */
+class ImageReader
+{
+  public:
+    ImageReader();
+
+    ~ImageReader();
+
+    /* numThreads is the number of threads used to decode and convert the
+       image, 0 does everything on the calling thread. */
+    bool Open(const std::string & filename,
+              std::string * error,
+              int numThreads = 0);
+
+    unsigned int Width() const;
+
+    unsigned int Height() const;
+
+    /* data must hold Width() * Height() * channels values of type. For exr
+       files, exrChannels names the file channels that map to the channels,
+       by default Y for one channel and R, G, B, A otherwise. Only those
+       channels are decoded. Channels missing in the image are 0, except
+       alpha of exr files which is 1. */
+    bool Read(void * data,
+              Buffer::Type type,
+              unsigned int channels,
+              std::string * error,
+              const std::vector<std::string> & exrChannels =
+              std::vector<std::string>());
+  private:
+    struct _Impl;
+    _Impl * _impl;
+
+    ImageReader(const ImageReader &);
+    void operator=(const ImageReader &);
+};
+//----------------------------------------------------------------------------//
+/* Writes interleaved pixels of any buffer type to an image file. Files
+   ending with .exr are written as half or float with OpenEXR and options,
+   other formats as 8 bits per channel with CImg. */
+bool WriteImage(const void * data,
+                Buffer::Type type,
+                unsigned int channels,
+                unsigned int width,
+                unsigned int height,
+                const std::string & filename,
+                std::string * error,
+                int numThreads = 0,
+                const std::vector<std::string> & exrChannels =
+                std::vector<std::string>(),
+                const ExrOptions & options = ExrOptions());
+//----------------------------------------------------------------------------//
+/* Streams an exr file into a buffer on the GPU band by band with
+   ImageProcessor::CopyRows. Each band is decoded on a separate thread while
+   the previous one is copied, so only a few bands are held in host memory.
+   The image must have the dimensions of the ImageProcessor. Must be called
+   from the thread that uses the ImageProcessor. Returns the copy time in
+   milliseconds, GPUIP_ERROR on failure. */
+double StreamToGPU(ImageProcessor & ip,
+                   Buffer::Ptr buffer,
+                   const std::string & filename,
+                   std::string * error,
+                   int numThreads = 0,
+                   const std::vector<std::string> & channels =
+                   std::vector<std::string>());
+//----------------------------------------------------------------------------//
+} // end namespace io
+} // end namespace gpuip
+//----------------------------------------------------------------------------//
+#endif
@@ -0,0 +1,558 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Per Karlsson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// gpuip-run: runs an *.ip file without Python, like gpuip --nogui.
+#include "gpuip.h"
+#include "gpuip_io.h"
+#include "runner.h"
+#include "settings.h"
+#include <OpenEXR/IlmThreadPool.h>
+#include <OpenEXR/IlmThreadSemaphore.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+//----------------------------------------------------------------------------//
+namespace {
+//----------------------------------------------------------------------------//
+const char * _usage =
+        "usage: gpuip-run [-h] [-f FILE] [-p kernel param value]\n"
+        "                 [-i buffer path] [-o buffer path] [-t threads]\n"
+        "                 [--frames FIRST-LAST] [-v] [--timestamp]\n"
+        "\n"
+        "Runs an image processing file *.ip without Python. With --frames,\n"
+        "#### or %04d in image paths is replaced by the frame number and the\n"
+        "frames are decoded, processed and encoded at the same time.\n"
+        "\n"
+        "optional arguments:\n"
+        "  -h, --help            show this help message and exit\n"
+        "  -f FILE, --file FILE  Image Processing file *.ip\n"
+        "  -p kernel param value, --param kernel param value\n"
+        "                        Change value of a parameter.\n"
+        "  -i buffer path, --inbuffer buffer path\n"
+        "                        Set input image to a buffer\n"
+        "  -o buffer path, --outbuffer buffer path\n"
+        "                        Set output image to a buffer\n"
+        "  -t THREADS, --threads THREADS\n"
+        "                        Threads used for image I/O (default: cores)\n"
+        "  --frames FIRST-LAST   Frame range of image sequences\n"
+        "  -v, --verbose         Outputs information\n"
+        "  --timestamp           Add timestamp in log output\n";
+//----------------------------------------------------------------------------//
+struct _Args
+{
+    _Args() : threads(0), verbose(false), timestamp(false) {}
+
+    std::string file;
+    std::vector<std::vector<std::string> > params;
+    std::vector<std::vector<std::string> > inBuffers;
+    std::vector<std::vector<std::string> > outBuffers;
+    std::string frames;
+    int threads;
+    bool verbose;
+    bool timestamp;
+};
+//----------------------------------------------------------------------------//
+void _Terminate(const std::string & msg)
+{
+    std::fprintf(stderr, "%s\n", msg.c_str());
+    std::exit(1);
+}
+//----------------------------------------------------------------------------//
+_Args _ParseArgs(int argc, char ** argv)
+{
+    _Args args;
+    for(int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        int n = 0; // number of values that follow
+        std::vector<std::vector<std::string> > * list = NULL;
+        if (a == "-h" || a == "--help") {
+            std::printf("%s", _usage);
+            std::exit(0);
+        } else if (a == "-v" || a == "--verbose") {
+            args.verbose = true;
+        } else if (a == "--timestamp") {
+            args.timestamp = true;
+        } else if (a == "--nogui") {
+            // Always command line, accepted for compatibility with gpuip
+        } else if (a == "-f" || a == "--file") {
+            n = 1;
+        } else if (a == "-t" || a == "--threads") {
+            n = 1;
+        } else if (a == "--frames") {
+            n = 1;
+        } else if (a == "-p" || a == "--param") {
+            n = 3;
+            list = &args.params;
+        } else if (a == "-i" || a == "--inbuffer") {
+            n = 2;
+            list = &args.inBuffers;
+        } else if (a == "-o" || a == "--outbuffer") {
+            n = 2;
+            list = &args.outBuffers;
+        } else if (a[0] != '-' && args.file.empty()) {
+            args.file = a;
+        } else {
+            _Terminate(std::string(_usage) + "gpuip-run: error: unrecognized "
+                       "argument " + a);
+        }
+        if (i + n >= argc) {
+            _Terminate(std::string(_usage) + "gpuip-run: error: argument " +
+                       a + " expects more values");
+        }
+        std::vector<std::string> values(argv + i + 1, argv + i + 1 + n);
+        i += n;
+        if (list) {
+            list->push_back(values);
+        } else if (a == "-f" || a == "--file") {
+            args.file = values[0];
+        } else if (a == "-t" || a == "--threads") {
+            args.threads = std::atoi(values[0].c_str());
+        } else if (a == "--frames") {
+            args.frames = values[0];
+        }
+    }
+    return args;
+}
+//----------------------------------------------------------------------------//
+class _Log
+{
+  public:
+    _Log(const _Args & args) : _args(args) {}
+
+    void operator()(const std::string & text,
+                    double start = -1,
+                    bool time = true) const
+    {
+        if (!_args.verbose) {
+            return;
+        }
+        std::string timeStr;
+        if (time && _args.timestamp) {
+            char buf[32];
+            const std::time_t now = std::time(NULL);
+            std::strftime(buf, sizeof(buf), "[%Y-%m-%d %H:%M:%S] ",
+                          std::gmtime(&now));
+            timeStr = buf;
+        }
+        std::printf("%s%s", timeStr.c_str(), text.c_str());
+        if (start >= 0) {
+            std::printf(" %.2f ms", gpuip::Now() - start);
+        }
+        std::printf("\n");
+    }
+  private:
+    const _Args & _args;
+};
+//----------------------------------------------------------------------------//
+std::string _DeviceTime(const gpuip::ImageProcessor & ip, double time)
+{
+    std::stringstream ss;
+    ss.setf(std::ios::fixed);
+    ss.precision(2);
+    ss << "(device " << time << " ms";
+    // Per kernel time and achieved bandwidth, where kernels are timed
+    const std::vector<double> & times = ip.KernelTimes();
+    const std::vector<gpuip::KernelReport> reports = ip.KernelReports();
+    const double peak = ip.PeakBandwidth();
+    for(size_t i = 0; i < times.size(); ++i) {
+        ss << (i ? ", " : " [") << reports[i].name << " " << times[i]
+           << " ms " << reports[i].Bandwidth() << " GB/s";
+        if (peak > 0) {
+            ss << " " << (int)(100 * reports[i].Bandwidth() / peak + 0.5)
+               << "% of peak";
+        }
+    }
+    ss << (times.empty() ? ")" : "])");
+    return ss.str();
+}
+//----------------------------------------------------------------------------//
+void _CheckError(double time, const std::string & err)
+{
+    if (time == GPUIP_ERROR) {
+        _Terminate(err);
+    }
+}
+//----------------------------------------------------------------------------//
+void _ApplyArgs(const _Args & args, gpuip::Settings * settings)
+{
+    for(size_t i = 0; i < args.params.size(); ++i) {
+        const std::vector<std::string> & p = args.params[i];
+        gpuip::Settings::Kernel * kernel = settings->GetKernel(p[0]);
+        if (!kernel) {
+            _Terminate("gpuip error: No kernel " + p[0] + " found.");
+        }
+        gpuip::Settings::Param * param = kernel->GetParam(p[1]);
+        if (!param) {
+            _Terminate("gpuip error: No param " + p[1] + " found in kernel " +
+                       p[0] + ".");
+        }
+        param->value = std::atof(p[2].c_str());
+    }
+    for(size_t i = 0; i < args.inBuffers.size(); ++i) {
+        const std::vector<std::string> & b = args.inBuffers[i];
+        gpuip::Settings::Buffer * buffer = settings->GetBuffer(b[0]);
+        if (!buffer) {
+            _Terminate("gpuip error: No buffer " + b[0] + " found.");
+        }
+        if (args.frames.empty() && !std::ifstream(b[1].c_str())) {
+            _Terminate("gpuip error: No such file: '" + b[1] + "'");
+        }
+        buffer->input = b[1];
+    }
+    for(size_t i = 0; i < args.outBuffers.size(); ++i) {
+        const std::vector<std::string> & b = args.outBuffers[i];
+        gpuip::Settings::Buffer * buffer = settings->GetBuffer(b[0]);
+        if (!buffer) {
+            _Terminate("gpuip error: No buffer " + b[0] + " found.");
+        }
+        buffer->output = b[1];
+    }
+}
+//----------------------------------------------------------------------------//
+// Frames in flight: one being decoded, one on the GPU and one being encoded
+#define GPUIP_RUN_SLOTS 3
+//----------------------------------------------------------------------------//
+// State shared by the threads that decode, process and encode frames. Each
+// slot holds the host memory of all buffers of one frame. The free
+// semaphore counts slots that can be decoded into, decoded counts frames
+// ready for the GPU and processed counts frames ready to be encoded. A
+// stage that fails sets abort and posts all semaphores so that the other
+// stages wake up and stop.
+struct _Pipeline
+{
+    _Pipeline()
+            : free(GPUIP_RUN_SLOTS), decoded(0), processed(0), abort(false) {}
+
+    const gpuip::Settings * settings;
+    const _Log * log;
+    std::vector<int> frames;
+    bool sequence;
+    std::vector<gpuip::Buffer::Ptr> buffers; // in the order of the settings
+    std::vector<std::vector<void *> > slots;
+    std::vector<gpuip::io::ImageReader *> first; // opened inputs of frame 0
+    unsigned int width;
+    unsigned int height;
+    int threads;
+    IlmThread::Semaphore free;
+    IlmThread::Semaphore decoded;
+    IlmThread::Semaphore processed;
+    bool abort;
+    std::string readError;
+    std::string writeError;
+
+    std::string Path(const std::string & path, size_t k) const
+    {
+        return sequence ? gpuip::FramePath(path, frames[k]) : path;
+    }
+
+    void Abort()
+    {
+        abort = true;
+        free.post();
+        decoded.post();
+        processed.post();
+    }
+};
+//----------------------------------------------------------------------------//
+class _ReadTask : public IlmThread::Task
+{
+  public:
+    _ReadTask(IlmThread::TaskGroup * group, _Pipeline & pipeline)
+            : IlmThread::Task(group), _p(pipeline) {}
+
+    virtual void execute()
+    {
+        for(size_t k = 0; k < _p.frames.size(); ++k) {
+            _p.free.wait();
+            if (_p.abort) {
+                return;
+            }
+            if (!_Read(k)) {
+                _p.Abort();
+                return;
+            }
+            _p.decoded.post();
+        }
+    }
+  private:
+    _Pipeline & _p;
+
+    bool _Read(size_t k)
+    {
+        std::vector<void *> & slot = _p.slots[k % _p.slots.size()];
+        for(size_t i = 0; i < _p.buffers.size(); ++i) {
+            const std::string & input = _p.settings->buffers[i].input;
+            if (input.empty()) {
+                continue;
+            }
+            const std::string path = _p.Path(input, k);
+            (*_p.log)("Importing data from " + path + " to " +
+                      _p.buffers[i]->name);
+            // Frame 0 reuses the inputs opened to size the images, they
+            // stay owned by the pipeline
+            gpuip::io::ImageReader opened;
+            gpuip::io::ImageReader * reader = k == 0 ? _p.first[i] : &opened;
+            if (k != 0 && !reader->Open(path, &_p.readError, _p.threads)) {
+                return false;
+            }
+            if (reader->Width() != _p.width || reader->Height() != _p.height){
+                std::stringstream ss;
+                ss << "gpuip error: " << path << " is " << reader->Width()
+                   << "x" << reader->Height() << " but the images are "
+                   << _p.width << "x" << _p.height << "\n";
+                _p.readError += ss.str();
+                return false;
+            }
+            const gpuip::Buffer::Ptr & b = _p.buffers[i];
+            if (!reader->Read(slot[i], b->type, b->channels, &_p.readError)) {
+                return false;
+            }
+            if (k == 0) {
+                delete _p.first[i];
+                _p.first[i] = NULL;
+            }
+        }
+        return true;
+    }
+};
+//----------------------------------------------------------------------------//
+class _WriteTask : public IlmThread::Task
+{
+  public:
+    _WriteTask(IlmThread::TaskGroup * group, _Pipeline & pipeline)
+            : IlmThread::Task(group), _p(pipeline) {}
+
+    virtual void execute()
+    {
+        for(size_t k = 0; k < _p.frames.size(); ++k) {
+            _p.processed.wait();
+            if (_p.abort) {
+                return;
+            }
+            if (!_Write(k)) {
+                _p.Abort();
+                return;
+            }
+            _p.free.post();
+        }
+    }
+  private:
+    _Pipeline & _p;
+
+    bool _Write(size_t k)
+    {
+        std::vector<void *> & slot = _p.slots[k % _p.slots.size()];
+        for(size_t i = 0; i < _p.buffers.size(); ++i) {
+            const gpuip::Settings::Buffer & b = _p.settings->buffers[i];
+            if (b.output.empty()) {
+                continue;
+            }
+            const std::string path = _p.Path(b.output, k);
+            (*_p.log)("Exporting data from " + b.name + " to " + path);
+            gpuip::MakeDirs(path);
+            const gpuip::Buffer::Ptr & buffer = _p.buffers[i];
+            if (!gpuip::io::WriteImage(slot[i], buffer->type, buffer->channels,
+                                       _p.width, _p.height, path,
+                                       &_p.writeError, _p.threads,
+                                       std::vector<std::string>(),
+                                       b.exrOptions)) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+//----------------------------------------------------------------------------//
+} // end anonymous namespace
+//----------------------------------------------------------------------------//
+int main(int argc, char ** argv)
+{
+    const _Args args = _ParseArgs(argc, argv);
+    if (args.file.empty()) {
+        _Terminate("Must specify an existing *.ip file\n"
+                   "example: \n"
+                   "  gpuip-run -f smooth.ip");
+    }
+    const _Log log(args);
+    std::string err;
+
+    gpuip::Settings settings;
+    if (!settings.Read(args.file, &err)) {
+        _Terminate(err);
+    }
+    _ApplyArgs(args, &settings);
+
+    _Pipeline p;
+    p.settings = &settings;
+    p.log = &log;
+    if (!gpuip::ParseFrames(args.frames, &p.frames, &err)) {
+        _Terminate(err);
+    }
+    p.sequence = !args.frames.empty();
+    p.threads = args.threads > 0 ? args.threads : gpuip::NumCores();
+
+    const double overall = gpuip::Now();
+
+    // 0. Create gpuip items from settings
+    std::map<std::string, gpuip::Buffer::Ptr> buffers;
+    std::vector<gpuip::Kernel::Ptr> kernels;
+    gpuip::ImageProcessor::Ptr ip = settings.Create(&buffers, &kernels, &err);
+    if (!ip.get()) {
+        _Terminate(err);
+    }
+    for(size_t i = 0; i < settings.buffers.size(); ++i) {
+        p.buffers.push_back(buffers[settings.buffers[i].name]);
+    }
+    log("Created elements from settings.", overall);
+
+    // 1. Build
+    double c = gpuip::Now();
+    double time = ip->Build(&err);
+    _CheckError(time, err);
+    std::string names;
+    for(size_t i = 0; i < kernels.size(); ++i) {
+        names += (i ? ", " : "") + kernels[i]->name;
+    }
+    log("Building kernels [" + names + "] " + _DeviceTime(*ip, time) + ".",
+        c);
+
+    // 2. The inputs of the first frame set the size of all frames. Exr
+    // files only decode their header here.
+    p.first.resize(settings.buffers.size());
+    p.width = p.height = 0;
+    for(size_t i = 0; i < settings.buffers.size(); ++i) {
+        if (settings.buffers[i].input.empty()) {
+            continue;
+        }
+        p.first[i] = new gpuip::io::ImageReader;
+        if (!p.first[i]->Open(p.Path(settings.buffers[i].input, 0), &err,
+                              p.threads)) {
+            _Terminate(err);
+        }
+        p.width = std::max(p.width, p.first[i]->Width());
+        p.height = std::max(p.height, p.first[i]->Height());
+    }
+
+    // 3. Allocate once for all frames. Images are decoded straight into
+    // host memory of the image processor.
+    ip->SetDimensions(p.width, p.height);
+    c = gpuip::Now();
+    time = ip->Allocate(&err);
+    _CheckError(time, err);
+    log("Allocating done " + _DeviceTime(*ip, time) + ".", c);
+
+    p.slots.resize(std::min((size_t)GPUIP_RUN_SLOTS, p.frames.size()));
+    for(size_t s = 0; s < p.slots.size(); ++s) {
+        p.slots[s].resize(settings.buffers.size(), (void *)NULL);
+        for(size_t i = 0; i < settings.buffers.size(); ++i) {
+            const gpuip::Settings::Buffer & b = settings.buffers[i];
+            if (b.input.empty() && b.output.empty()) {
+                continue;
+            }
+            p.slots[s][i] = ip->AllocateHostMemory(p.buffers[i], &err);
+            if (p.slots[s][i] == NULL) {
+                _Terminate(err);
+            }
+        }
+    }
+
+    // 4. Frames are decoded and encoded on threads of their own while this
+    // thread, which owns the GPU context, uploads, processes and downloads
+    double uploadTime = 0, runTime = 0, downloadTime = 0;
+    {
+        IlmThread::ThreadPool pool(2);
+        IlmThread::TaskGroup group;
+        pool.addTask(new _ReadTask(&group, p));
+        pool.addTask(new _WriteTask(&group, p));
+        for(size_t k = 0; k < p.frames.size(); ++k) {
+            p.decoded.wait();
+            if (p.abort) {
+                break;
+            }
+            c = gpuip::Now();
+            std::vector<void *> & slot = p.slots[k % p.slots.size()];
+            time = 0;
+            for(size_t i = 0; i < p.buffers.size() && time != GPUIP_ERROR;
+                ++i) {
+                if (!settings.buffers[i].input.empty()) {
+                    time = ip->Copy(p.buffers[i], gpuip::Buffer::COPY_TO_GPU,
+                                    slot[i], &err);
+                    uploadTime += time;
+                }
+            }
+            if (time != GPUIP_ERROR) {
+                time = ip->Run(&err);
+                runTime += time;
+            }
+            std::string device = _DeviceTime(*ip, time);
+            for(size_t i = 0; i < p.buffers.size() && time != GPUIP_ERROR;
+                ++i) {
+                if (!settings.buffers[i].output.empty()) {
+                    time = ip->Copy(p.buffers[i],
+                                    gpuip::Buffer::COPY_FROM_GPU,
+                                    slot[i], &err);
+                    downloadTime += time;
+                }
+            }
+            if (time == GPUIP_ERROR) {
+                p.Abort();
+                break;
+            }
+            if (p.sequence) {
+                std::stringstream ss;
+                ss << "Frame " << p.frames[k] << " processed " << device
+                   << ".";
+                log(ss.str(), c);
+            } else {
+                log("Processing done " + device + ".", c);
+            }
+            p.processed.post();
+        }
+    } // waits for the reading and writing tasks
+    for(size_t i = 0; i < p.first.size(); ++i) {
+        delete p.first[i];
+    }
+    if (p.abort) {
+        _Terminate(err + p.readError + p.writeError);
+    }
+
+    for(size_t s = 0; s < p.slots.size(); ++s) {
+        for(size_t i = 0; i < p.slots[s].size(); ++i) {
+            if (p.slots[s][i] && !ip->FreeHostMemory(p.slots[s][i], &err)) {
+                _Terminate(err);
+            }
+        }
+    }
+
+    char stats[128];
+    std::sprintf(stats, "Device time: upload %.2f ms, run %.2f ms, "
+                 "download %.2f ms.", uploadTime, runTime, downloadTime);
+    log(stats, -1, false);
+    log("\nAll steps done. Total runtime:", overall, false);
+    return 0;
+}
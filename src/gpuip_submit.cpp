@@ -0,0 +1,164 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Per Karlsson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// gpuip-submit: sends a job to gpuipd and waits for it to finish.
+#include "gpuipd.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+//----------------------------------------------------------------------------//
+namespace {
+//----------------------------------------------------------------------------//
+const char * _usage =
+        "usage: gpuip-submit [-h] [-s SOCKET] [-P PIPELINE]\n"
+        "                    [-p kernel param value] [-i buffer path]\n"
+        "                    [-o buffer path] [-v] [--ping] [--shutdown]\n"
+        "\n"
+        "Runs a job on a pipeline loaded by gpuipd. Images and parameters\n"
+        "not given keep the values of the *.ip file.\n"
+        "\n"
+        "optional arguments:\n"
+        "  -h, --help            show this help message and exit\n"
+        "  -s SOCKET, --socket SOCKET\n"
+        "                        Unix domain socket of gpuipd\n"
+        "                        (default: /tmp/gpuipd-UID.sock)\n"
+        "  -P PIPELINE, --pipeline PIPELINE\n"
+        "                        Name of the *.ip file without extension\n"
+        "  -p kernel param value, --param kernel param value\n"
+        "                        Change value of a parameter.\n"
+        "  -i buffer path, --inbuffer buffer path\n"
+        "                        Set input image to a buffer\n"
+        "  -o buffer path, --outbuffer buffer path\n"
+        "                        Set output image to a buffer\n"
+        "  -v, --verbose         Outputs the time of the job\n"
+        "  --ping                Check that gpuipd is running\n"
+        "  --shutdown            Stop gpuipd\n";
+//----------------------------------------------------------------------------//
+void _Terminate(const std::string & msg)
+{
+    std::fprintf(stderr, "%s\n", msg.c_str());
+    std::exit(1);
+}
+//----------------------------------------------------------------------------//
+// gpuipd may run in another directory
+std::string _Absolute(const std::string & path)
+{
+    if (path.empty() || path[0] == '/') {
+        return path;
+    }
+    char cwd[4096];
+    if (!getcwd(cwd, sizeof(cwd))) {
+        _Terminate("gpuip-submit error: could not get working directory");
+    }
+    return std::string(cwd) + "/" + path;
+}
+//----------------------------------------------------------------------------//
+} // end anonymous namespace
+//----------------------------------------------------------------------------//
+int main(int argc, char ** argv)
+{
+    std::string socketPath = gpuip::ipc::DefaultSocketPath();
+    std::stringstream request;
+    std::string command = "run";
+    bool verbose = false;
+    for(int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        int n = 0; // number of values that follow
+        if (a == "-h" || a == "--help") {
+            std::printf("%s", _usage);
+            return 0;
+        } else if (a == "-v" || a == "--verbose") {
+            verbose = true;
+        } else if (a == "--ping") {
+            command = "ping";
+        } else if (a == "--shutdown") {
+            command = "shutdown";
+        } else if (a == "-s" || a == "--socket" ||
+                   a == "-P" || a == "--pipeline") {
+            n = 1;
+        } else if (a == "-p" || a == "--param") {
+            n = 3;
+        } else if (a == "-i" || a == "--inbuffer" ||
+                   a == "-o" || a == "--outbuffer") {
+            n = 2;
+        } else {
+            _Terminate(std::string(_usage) + "gpuip-submit: error: "
+                       "unrecognized argument " + a);
+        }
+        if (i + n >= argc) {
+            _Terminate(std::string(_usage) + "gpuip-submit: error: argument " +
+                       a + " expects more values");
+        }
+        const char * const * v = argv + i + 1;
+        i += n;
+        if (a == "-s" || a == "--socket") {
+            socketPath = v[0];
+        } else if (a == "-P" || a == "--pipeline") {
+            request << "pipeline " << v[0] << "\n";
+        } else if (a == "-p" || a == "--param") {
+            request << "param " << v[0] << " " << v[1] << " " << v[2] << "\n";
+        } else if (a == "-i" || a == "--inbuffer") {
+            request << "input " << v[0] << " " << _Absolute(v[1]) << "\n";
+        } else if (a == "-o" || a == "--outbuffer") {
+            request << "output " << v[0] << " " << _Absolute(v[1]) << "\n";
+        }
+    }
+    const std::string text = command == "run" ?
+            request.str() + "run\n" : command + "\n";
+
+    std::string err;
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    if (!gpuip::ipc::SocketAddress(socketPath, &addr, &err)) {
+        _Terminate(err);
+    }
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0) {
+        _Terminate("gpuip-submit error: no gpuipd listening on " +
+                   socketPath);
+    }
+    if (!gpuip::ipc::WriteAll(fd, text)) {
+        _Terminate("gpuip-submit error: could not send the job");
+    }
+    shutdown(fd, SHUT_WR);
+
+    gpuip::ipc::LineReader reader(fd);
+    std::string line;
+    if (!reader.ReadLine(&line)) {
+        _Terminate("gpuip-submit error: no reply from gpuipd");
+    }
+    if (line.compare(0, 3, "ok ") == 0) {
+        if (verbose && command == "run") {
+            std::printf("Job done %s ms.\n", line.c_str() + 3);
+        }
+        close(fd);
+        return 0;
+    }
+    while(reader.ReadLine(&line)) {
+        std::fprintf(stderr, "%s\n", line.c_str());
+    }
+    close(fd);
+    return 1;
+}
@@ -0,0 +1,145 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Per Karlsson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// gpuip-synth: writes a synthetic test image, so that examples and
+// benchmarks do not need downloaded images.
+#include "gpuip.h"
+#include "gpuip_io.h"
+#include "gpuip_synthetic.h"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+//----------------------------------------------------------------------------//
+namespace {
+//----------------------------------------------------------------------------//
+const char * _usage =
+        "usage: gpuip-synth [-h] [-p PATTERN] [-s WxH] [-t TYPE]\n"
+        "                   [-c CHANNELS] [--seed SEED] [-j THREADS] FILE\n"
+        "\n"
+        "Writes a deterministic synthetic image. The same arguments give the\n"
+        "same pixels on every machine.\n"
+        "\n"
+        "optional arguments:\n"
+        "  -h, --help            show this help message and exit\n"
+        "  -p, --pattern PATTERN noise, gradient, checkerboard or natural\n"
+        "                        (default: natural)\n"
+        "  -s, --size WxH        Image size, e.g. 16384x16384\n"
+        "                        (default: 1920x1080)\n"
+        "  -t, --type TYPE       ubyte, half or float (default: half)\n"
+        "  -c, --channels N      Channels, 1 to 4 (default: 4)\n"
+        "  --seed SEED           Selects the noise (default: 1)\n"
+        "  -j, --threads N       Threads used to write exr files\n"
+        "                        (default: 0, the calling thread)\n";
+//----------------------------------------------------------------------------//
+void _Terminate(const std::string & msg)
+{
+    std::fprintf(stderr, "%s\n", msg.c_str());
+    std::exit(1);
+}
+//----------------------------------------------------------------------------//
+} // end anonymous namespace
+//----------------------------------------------------------------------------//
+int main(int argc, char ** argv)
+{
+    gpuip::synthetic::Pattern pattern = gpuip::synthetic::NATURAL;
+    unsigned int width = 1920, height = 1080;
+    gpuip::Buffer::Type type = gpuip::Buffer::HALF;
+    unsigned int channels = 4;
+    unsigned int seed = 1;
+    int threads = 0;
+    std::string file;
+    for(int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "-h" || a == "--help") {
+            std::printf("%s", _usage);
+            return 0;
+        } else if (a[0] != '-') {
+            if (!file.empty()) {
+                _Terminate(std::string(_usage) + "gpuip-synth: error: more "
+                           "than one file");
+            }
+            file = a;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            _Terminate(std::string(_usage) + "gpuip-synth: error: argument " +
+                       a + " expects a value");
+        }
+        const std::string v = argv[++i];
+        if (a == "-p" || a == "--pattern") {
+            if (!gpuip::synthetic::ParsePattern(v, &pattern)) {
+                _Terminate("gpuip-synth: error: invalid pattern " + v);
+            }
+        } else if (a == "-s" || a == "--size") {
+            if (std::sscanf(v.c_str(), "%ux%u", &width, &height) != 2 ||
+                !width || !height) {
+                _Terminate("gpuip-synth: error: invalid size " + v);
+            }
+        } else if (a == "-t" || a == "--type") {
+            if (v == "ubyte") {
+                type = gpuip::Buffer::UNSIGNED_BYTE;
+            } else if (v == "half") {
+                type = gpuip::Buffer::HALF;
+            } else if (v == "float") {
+                type = gpuip::Buffer::FLOAT;
+            } else {
+                _Terminate("gpuip-synth: error: invalid type " + v);
+            }
+        } else if (a == "-c" || a == "--channels") {
+            channels = std::atoi(v.c_str());
+            if (channels < 1 || channels > 4) {
+                _Terminate("gpuip-synth: error: invalid channels " + v);
+            }
+        } else if (a == "--seed") {
+            seed = std::strtoul(v.c_str(), NULL, 10);
+        } else if (a == "-j" || a == "--threads") {
+            threads = std::atoi(v.c_str());
+        } else {
+            _Terminate(std::string(_usage) + "gpuip-synth: error: "
+                       "unrecognized argument " + a);
+        }
+    }
+    if (file.empty()) {
+        _Terminate(std::string(_usage) + "gpuip-synth: error: no file");
+    }
+
+    const size_t typeSize = type == gpuip::Buffer::UNSIGNED_BYTE ? 1 :
+            (type == gpuip::Buffer::HALF ? 2 : 4);
+    std::string err;
+    std::vector<unsigned char> data;
+    try {
+        data.resize((size_t)width * height * channels * typeSize);
+    } catch (const std::bad_alloc &) {
+        _Terminate("gpuip-synth: error: not enough memory");
+    }
+    if (!gpuip::synthetic::Generate(&data[0], type, channels, width, height,
+                                    pattern, seed, &err) ||
+        !gpuip::io::WriteImage(&data[0], type, channels, width, height, file,
+                               &err, threads)) {
+        _Terminate(err);
+    }
+    return 0;
+}
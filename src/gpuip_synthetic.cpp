@@ -0,0 +1,257 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Per Karlsson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "gpuip_synthetic.h"
+#include <cstring>
+#include <vector>
+//----------------------------------------------------------------------------//
+namespace gpuip {
+//----------------------------------------------------------------------------//
+namespace synthetic {
+//----------------------------------------------------------------------------//
+// Side in pixels of the squares of CHECKERBOARD
+#define GPUIP_CHECKER_SIZE 32
+//----------------------------------------------------------------------------//
+// Wavelengths in pixels of the largest and smallest octaves of NATURAL
+#define GPUIP_NATURAL_MAX_PERIOD 256
+#define GPUIP_NATURAL_MIN_PERIOD 2
+//----------------------------------------------------------------------------//
+// Integer hash with good avalanche, the same on every platform
+inline unsigned int _Hash(unsigned int x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+//----------------------------------------------------------------------------//
+inline unsigned int _Hash(unsigned int x,
+                          unsigned int y,
+                          unsigned int z,
+                          unsigned int seed)
+{
+    return _Hash(x ^ _Hash(y ^ _Hash(z ^ _Hash(seed))));
+}
+//----------------------------------------------------------------------------//
+// Uniform value in [0, 1) from the top 24 bits of a hash
+inline float _Unit(unsigned int h)
+{
+    return (h >> 8) * (1.0f / 16777216.0f);
+}
+//----------------------------------------------------------------------------//
+// Converts a value in [0, 1] to half, rounding to nearest
+inline unsigned short _FloatToHalf(float v)
+{
+    if (!(v > 0)) {
+        return 0;
+    }
+    unsigned int bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    const int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    const unsigned int mantissa = (bits & 0x7fffff) | 0x800000;
+    if (exponent <= 0) {
+        // Subnormal half
+        const int shift = 14 - exponent;
+        if (shift > 24) {
+            return 0;
+        }
+        return (mantissa + (1u << (shift - 1))) >> shift;
+    }
+    // The rounding carry may move into the exponent, which is correct
+    return ((exponent << 10) | ((mantissa & 0x7fffff) >> 13)) +
+            ((mantissa >> 12) & 1);
+}
+//----------------------------------------------------------------------------//
+inline float _Smooth(float t)
+{
+    return t * t * (3 - 2 * t);
+}
+//----------------------------------------------------------------------------//
+// Stores a row of values in [0, 1] as type
+void _StoreRow(const std::vector<float> & row,
+               Buffer::Type type,
+               unsigned char * out)
+{
+    for(size_t i = 0; i < row.size(); ++i) {
+        const float v = row[i] < 0 ? 0 : (row[i] > 1 ? 1 : row[i]);
+        if (type == Buffer::UNSIGNED_BYTE) {
+            out[i] = (unsigned char)(v * 255 + 0.5f);
+        } else if (type == Buffer::HALF) {
+            const unsigned short h = _FloatToHalf(v);
+            std::memcpy(out + 2 * i, &h, 2);
+        } else {
+            std::memcpy(out + 4 * i, &v, 4);
+        }
+    }
+}
+//----------------------------------------------------------------------------//
+// Value noise summed over octaves, each with an amplitude proportional to
+// its wavelength. The result falls off as 1/f like natural images. The
+// lattice values of the two rows around y are looked up once per row.
+class _Natural
+{
+  public:
+    _Natural(unsigned int width, unsigned int seed)
+            : _seed(seed), _width(width), _total(0)
+    {
+        for(unsigned int p = GPUIP_NATURAL_MAX_PERIOD;
+            p >= GPUIP_NATURAL_MIN_PERIOD; p /= 2) {
+            _periods.push_back(p);
+            _total += p;
+        }
+        _lattice.resize(_periods.size() * 2);
+    }
+
+    // Fills luminance for every pixel of row y
+    void Row(unsigned int y, std::vector<float> & out)
+    {
+        out.assign(_width, 0.0f);
+        for(size_t o = 0; o < _periods.size(); ++o) {
+            const unsigned int p = _periods[o];
+            const unsigned int cy = y / p;
+            const float ty = _Smooth((y % p + 0.5f) / p);
+            std::vector<float> & a = _lattice[2 * o];
+            std::vector<float> & b = _lattice[2 * o + 1];
+            const unsigned int cells = _width / p + 2;
+            a.resize(cells);
+            b.resize(cells);
+            for(unsigned int cx = 0; cx < cells; ++cx) {
+                a[cx] = _Unit(_Hash(cx, cy, o, _seed));
+                b[cx] = _Unit(_Hash(cx, cy + 1, o, _seed));
+            }
+            const float amplitude = (float)p / _total;
+            for(unsigned int x = 0; x < _width; ++x) {
+                const unsigned int cx = x / p;
+                const float tx = _Smooth((x % p + 0.5f) / p);
+                const float top = a[cx] + (a[cx + 1] - a[cx]) * tx;
+                const float bottom = b[cx] + (b[cx + 1] - b[cx]) * tx;
+                out[x] += amplitude * (top + (bottom - top) * ty);
+            }
+        }
+    }
+  private:
+    unsigned int _seed;
+    unsigned int _width;
+    float _total;
+    std::vector<unsigned int> _periods;
+    std::vector<std::vector<float> > _lattice;
+};
+//----------------------------------------------------------------------------//
+const char * PatternName(Pattern pattern)
+{
+    switch(pattern) {
+        case NOISE:
+            return "noise";
+        case GRADIENT:
+            return "gradient";
+        case CHECKERBOARD:
+            return "checkerboard";
+        default:
+            return "natural";
+    }
+}
+//----------------------------------------------------------------------------//
+bool ParsePattern(const std::string & name, Pattern * pattern)
+{
+    const Pattern patterns[] = { NOISE, GRADIENT, CHECKERBOARD, NATURAL };
+    for(int i = 0; i < 4; ++i) {
+        if (name == PatternName(patterns[i])) {
+            *pattern = patterns[i];
+            return true;
+        }
+    }
+    return false;
+}
+//----------------------------------------------------------------------------//
+bool Generate(void * data,
+              Buffer::Type type,
+              unsigned int channels,
+              unsigned int width,
+              unsigned int height,
+              Pattern pattern,
+              unsigned int seed,
+              std::string * error)
+{
+    const size_t typeSize = type == Buffer::UNSIGNED_BYTE ? 1 :
+            (type == Buffer::HALF ? 2 : 4);
+    const double bytes = (double)width * height * channels * typeSize;
+    if (bytes > (double)(size_t)-1) {
+        (*error) += "Synthetic image is too large for this platform\n";
+        return false;
+    }
+    const size_t rowValues = (size_t)width * channels;
+    const size_t rowBytes = rowValues * typeSize;
+
+    std::vector<float> row(rowValues);
+    std::vector<float> luminance;
+    _Natural natural(width, seed);
+    for(unsigned int y = 0; y < height; ++y) {
+        if (pattern == NATURAL) {
+            natural.Row(y, luminance);
+        }
+        for(unsigned int x = 0; x < width; ++x) {
+            for(unsigned int c = 0; c < channels; ++c) {
+                float v;
+                switch(pattern) {
+                    case NOISE:
+                        v = _Unit(_Hash(x, y, c, seed));
+                        break;
+                    case GRADIENT:
+                        // Horizontal, vertical, diagonal and reversed ramps
+                        if (c % 4 == 0) {
+                            v = width > 1 ? (float)x / (width - 1) : 0;
+                        } else if (c % 4 == 1) {
+                            v = height > 1 ? (float)y / (height - 1) : 0;
+                        } else if (c % 4 == 2) {
+                            v = width + height > 2 ?
+                                    (float)(x + y) / (width + height - 2) : 0;
+                        } else {
+                            v = width > 1 ? 1 - (float)x / (width - 1) : 1;
+                        }
+                        break;
+                    case CHECKERBOARD:
+                        v = ((x / GPUIP_CHECKER_SIZE + y / GPUIP_CHECKER_SIZE)
+                             & 1) ? 1.0f : 0.0f;
+                        break;
+                    default:
+                        // Channels share the structure and differ by a
+                        // little fine grained colour noise
+                        v = 0.5f + 1.6f * (luminance[x] - 0.5f) + 0.1f *
+                                (_Unit(_Hash(x, y, c, ~seed)) - 0.5f);
+                        break;
+                }
+                row[(size_t)x * channels + c] = v;
+            }
+        }
+        _StoreRow(row, type, static_cast<unsigned char *>(data) +
+                  (size_t)y * rowBytes);
+    }
+    return true;
+}
+//----------------------------------------------------------------------------//
+} // end namespace synthetic
+} // end namespace gpuip
+//----------------------------------------------------------------------------//
@@ -0,0 +1,67 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Per Karlsson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GPUIP_SYNTHETIC_H_
+#define GPUIP_SYNTHETIC_H_
+//----------------------------------------------------------------------------//
+#include "gpuip.h"
+#include <string>
+//----------------------------------------------------------------------------//
+namespace gpuip {
+//----------------------------------------------------------------------------//
+namespace synthetic {
+//----------------------------------------------------------------------------//
+/* Test images that are generated instead of read from file. */
+enum Pattern {
+    NOISE,        // uniform white noise, independent per channel
+    GRADIENT,     // horizontal, vertical, diagonal and reversed ramps
+    CHECKERBOARD, // 32 pixel squares of 0 and 1
+    NATURAL };    // fractal noise with the 1/f spectrum of natural images
+//----------------------------------------------------------------------------//
+/* Name used on the command line, e.g. "noise". */
+const char * PatternName(Pattern pattern);
+//----------------------------------------------------------------------------//
+/* Parses a name from PatternName. Returns false if there is no such
+   pattern. */
+bool ParsePattern(const std::string & name, Pattern * pattern);
+//----------------------------------------------------------------------------//
+/* Fills data with width * height * channels interleaved values of type, row
+   by row from the top, in [0, 1] (0 to 255 for unsigned bytes). The pixels
+   only depend on the arguments, so the same image is generated on every
+   machine without any input files, at any size. The seed selects one of
+   many noise and natural images, gradients and checkerboards do not depend
+   on it. Returns false if the image is too large to be addressed. */
+bool Generate(void * data,
+              Buffer::Type type,
+              unsigned int channels,
+              unsigned int width,
+              unsigned int height,
+              Pattern pattern,
+              unsigned int seed,
+              std::string * error);
+//----------------------------------------------------------------------------//
+} // end namespace synthetic
+} // end namespace gpuip
+//----------------------------------------------------------------------------//
+#endif
@@ -0,0 +1,562 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Per Karlsson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// gpuipd: keeps *.ip pipelines built and allocated on the GPU and runs jobs
+// sent by gpuip-submit or SharedFrames over a Unix domain socket.
+#include "gpuip.h"
+#include "gpuipd.h"
+#include "runner.h"
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <list>
+#include <map>
+#include <poll.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+//----------------------------------------------------------------------------//
+namespace {
+//----------------------------------------------------------------------------//
+const char * _usage =
+        "usage: gpuipd [-h] [-s SOCKET] [-t THREADS] [-v] FILE [FILE ...]\n"
+        "\n"
+        "Loads image processing files *.ip once, keeps their kernels built\n"
+        "and their buffers allocated and runs jobs sent by gpuip-submit.\n"
+        "Each pipeline is named by its file name without extension.\n"
+        "\n"
+        "optional arguments:\n"
+        "  -h, --help            show this help message and exit\n"
+        "  -s SOCKET, --socket SOCKET\n"
+        "                        Unix domain socket to listen on\n"
+        "                        (default: /tmp/gpuipd-UID.sock)\n"
+        "  -t THREADS, --threads THREADS\n"
+        "                        Threads used for image I/O (default: cores)\n"
+        "  -v, --verbose         Outputs information\n";
+//----------------------------------------------------------------------------//
+// Seconds a client may take to send its request. Clients attached to shared
+// memory may stay connected for as long as they like.
+#define GPUIPD_RECEIVE_TIMEOUT 10
+//----------------------------------------------------------------------------//
+volatile std::sig_atomic_t _stop = 0;
+//----------------------------------------------------------------------------//
+void _OnSignal(int)
+{
+    _stop = 1;
+}
+//----------------------------------------------------------------------------//
+void _Terminate(const std::string & msg)
+{
+    std::fprintf(stderr, "%s\n", msg.c_str());
+    std::exit(1);
+}
+//----------------------------------------------------------------------------//
+std::string _Name(const std::string & file)
+{
+    const size_t slash = file.find_last_of("/\\");
+    std::string name = slash == std::string::npos ?
+            file : file.substr(slash + 1);
+    const size_t dot = name.rfind('.');
+    return dot == std::string::npos || dot == 0 ? name : name.substr(0, dot);
+}
+//----------------------------------------------------------------------------//
+// Splits "key rest of line" at the first space
+void _Split(const std::string & line, std::string * key, std::string * rest)
+{
+    const size_t space = line.find(' ');
+    *key = line.substr(0, space);
+    *rest = space == std::string::npos ? "" : line.substr(space + 1);
+}
+//----------------------------------------------------------------------------//
+// Errors of frames are replied on a single line
+std::string _OneLine(std::string text)
+{
+    while(!text.empty() && text[text.size() - 1] == '\n') {
+        text.erase(text.size() - 1);
+    }
+    std::replace(text.begin(), text.end(), '\n', ' ');
+    return text;
+}
+//----------------------------------------------------------------------------//
+typedef std::map<std::string, gpuip::Runner *> _Runners;
+//----------------------------------------------------------------------------//
+// A client and its request so far. Requests arrive in pieces since all
+// clients are served by one thread.
+struct _Client
+{
+    _Client(int fd_)
+            : fd(fd_), accepted(gpuip::Now()), runner(NULL), shm(NULL),
+              shmBytes(0), slotBytes(0), close(false) {}
+
+    int fd;
+    double accepted;
+    std::string received; // not yet complete lines
+    std::string pipeline;
+    gpuip::Runner::Job job;
+    std::string lineError; // invalid line before the next frame
+    gpuip::Runner * runner; // set once attached to shared memory
+    void * shm;
+    size_t shmBytes;
+    size_t slotBytes; // images may not cross the slots of the memory
+    bool close;
+};
+//----------------------------------------------------------------------------//
+class _Server
+{
+  public:
+    _Server(_Runners & runners, bool verbose)
+            : _runners(runners), _verbose(verbose) {}
+
+    // Handles a complete line of a client
+    void HandleLine(_Client & c, const std::string & line)
+    {
+        std::string key, rest;
+        _Split(line, &key, &rest);
+        if (c.runner) {
+            _SessionLine(c, line, key, rest);
+            return;
+        }
+        if ((key == "ping" || key == "shutdown") && rest.empty()) {
+            _stop = key == "shutdown";
+            _Reply(c, "ok 0\n");
+        } else if (key == "run") {
+            _Reply(c, _RunJob(c));
+        } else if (key == "attach") {
+            _Attach(c, rest);
+        } else if (key == "pipeline") {
+            c.pipeline = rest;
+        } else if (key == "param") {
+            if (!_ParseParam(rest, &c.job.params)) {
+                _Reply(c, "error\ngpuipd error: invalid line: " + line + "\n");
+            }
+        } else if (key == "input" || key == "output") {
+            std::string buffer, path;
+            _Split(rest, &buffer, &path);
+            if (buffer.empty() || path.empty()) {
+                _Reply(c, "error\ngpuipd error: invalid line: " + line + "\n");
+            } else {
+                (key == "input" ? c.job.inputs : c.job.outputs)[buffer] = path;
+            }
+        } else {
+            _Reply(c, "error\ngpuipd error: invalid line: " + line + "\n");
+        }
+    }
+
+    // Releases the shared memory of a client
+    void Detach(_Client & c)
+    {
+        if (c.shm) {
+            std::string err;
+            c.runner->UnregisterHostMemory(c.shm, &err);
+            munmap(c.shm, c.shmBytes);
+            c.shm = NULL;
+        }
+    }
+
+  private:
+    _Runners & _runners;
+    bool _verbose;
+
+    // The reply ends a request that is not attached to shared memory
+    void _Reply(_Client & c, const std::string & reply)
+    {
+        gpuip::ipc::WriteAll(c.fd, reply);
+        c.close = c.runner == NULL;
+    }
+
+    bool _ParseParam(const std::string & rest,
+                     std::vector<std::vector<std::string> > * params)
+    {
+        std::istringstream ss(rest);
+        std::vector<std::string> p(3);
+        if (!(ss >> p[0] >> p[1] >> p[2])) {
+            return false;
+        }
+        params->push_back(p);
+        return true;
+    }
+
+    _Runners::iterator _Find(const std::string & pipeline)
+    {
+        if (pipeline.empty() && _runners.size() == 1) {
+            return _runners.begin();
+        }
+        return _runners.find(pipeline);
+    }
+
+    std::string _RunJob(_Client & c)
+    {
+        _Runners::iterator it = _Find(c.pipeline);
+        if (it == _runners.end()) {
+            return "error\ngpuipd error: No pipeline '" + c.pipeline +
+                    "' found.\n";
+        }
+        std::string err;
+        const double time = it->second->Run(c.job, &err);
+        if (time == GPUIP_ERROR) {
+            _Log("Job on " + it->first + " failed:\n" + err);
+            return "error\n" + err;
+        }
+        return _Done("Job on " + it->first, time, *it->second);
+    }
+
+    void _Attach(_Client & c, const std::string & rest)
+    {
+        std::istringstream ss(rest);
+        std::string name;
+        size_t slotBytes = 0;
+        if (!(ss >> name >> slotBytes) || slotBytes == 0) {
+            _Reply(c, "error\ngpuipd error: invalid line: attach " + rest +
+                   "\n");
+            return;
+        }
+        _Runners::iterator it = _Find(c.pipeline);
+        if (it == _runners.end()) {
+            _Reply(c, "error\ngpuipd error: No pipeline '" + c.pipeline +
+                   "' found.\n");
+            return;
+        }
+        const int fd = shm_open(name.c_str(), O_RDWR, 0);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            _Reply(c, "error\ngpuipd error: could not open shared memory " +
+                   name + "\n");
+            return;
+        }
+        if ((size_t)st.st_size % slotBytes != 0) {
+            close(fd);
+            _Reply(c, "error\ngpuipd error: shared memory " + name +
+                   " is not a whole number of slots\n");
+            return;
+        }
+        void * shm = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, fd, 0);
+        close(fd);
+        std::string err;
+        if (shm == MAP_FAILED) {
+            _Reply(c, "error\ngpuipd error: could not map shared memory " +
+                   name + "\n");
+            return;
+        }
+        if (!it->second->RegisterHostMemory(shm, st.st_size, &err)) {
+            munmap(shm, st.st_size);
+            _Reply(c, "error\n" + err);
+            return;
+        }
+        c.runner = it->second;
+        c.shm = shm;
+        c.shmBytes = st.st_size;
+        c.slotBytes = slotBytes;
+        c.job = gpuip::Runner::Job();
+        _Log("Client attached " + name + " to " + it->first + "\n");
+        _Reply(c, "ok 0\n");
+    }
+
+    void _SessionLine(_Client & c,
+                      const std::string & line,
+                      const std::string & key,
+                      const std::string & rest)
+    {
+        // Only frames are replied to, an invalid line fails the next frame
+        // so that replies stay in step with the frames of the client
+        if (key != "frame") {
+            if (key != "param" || !_ParseParam(rest, &c.job.params)) {
+                c.lineError += "gpuipd error: invalid line: " + line + "\n";
+            }
+            return;
+        }
+        std::string err;
+        gpuip::Runner::Frame frame;
+        frame.params.swap(c.job.params);
+        err.swap(c.lineError);
+        if (!err.empty() || !_ParseFrame(c, rest, &frame, &err)) {
+            _Reply(c, "error " + _OneLine(err) + "\n");
+            return;
+        }
+        const double time = c.runner->Run(frame, &err);
+        if (time == GPUIP_ERROR) {
+            _Log("Frame failed:\n" + err);
+            _Reply(c, "error " + _OneLine(err) + "\n");
+            return;
+        }
+        _Reply(c, _Done("Frame", time, *c.runner));
+    }
+
+    // Checks that the images of a frame line are inside the shared memory
+    // and match the buffers of the pipeline
+    bool _ParseFrame(const _Client & c,
+                     const std::string & rest,
+                     gpuip::Runner::Frame * frame,
+                     std::string * err)
+    {
+        std::istringstream ss(rest);
+        if (!(ss >> frame->width >> frame->height)) {
+            (*err) += "gpuipd error: invalid frame size\n";
+            return false;
+        }
+        std::string dir, name, type;
+        size_t offset;
+        unsigned int channels;
+        while(ss >> dir) {
+            // A truncated image spec is an error, not the end of the line
+            if (!(ss >> name >> offset >> type >> channels)) {
+                (*err) += "gpuipd error: invalid image of frame line\n";
+                return false;
+            }
+            const gpuip::Buffer::Ptr b = c.runner->GetBuffer(name);
+            if (!b.get()) {
+                (*err) += "gpuip error: No buffer " + name + " found.\n";
+                return false;
+            }
+            if (type != gpuip::ipc::TypeName(b->type) ||
+                channels != b->channels) {
+                std::stringstream ss;
+                ss << "gpuipd error: buffer " << name << " is "
+                   << gpuip::ipc::TypeName(b->type) << " with " << b->channels
+                   << " channels, not " << type << " with " << channels
+                   << "\n";
+                (*err) += ss.str();
+                return false;
+            }
+            const size_t bytes = (size_t)frame->width * frame->height *
+                    channels * gpuip::ipc::TypeSize(b->type);
+            if (offset >= c.shmBytes ||
+                bytes > c.slotBytes - offset % c.slotBytes) {
+                (*err) += "gpuipd error: image of buffer " + name +
+                        " is outside its slot of the shared memory\n";
+                return false;
+            }
+            void * data = (char *)c.shm + offset;
+            if (dir == "in") {
+                frame->inputs[name] = data;
+            } else if (dir == "out") {
+                frame->outputs[name] = data;
+            } else {
+                (*err) += "gpuipd error: expected in or out, not " + dir +
+                        "\n";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string _Done(const std::string & what,
+                      double time,
+                      const gpuip::Runner & runner)
+    {
+        char text[128];
+        std::sprintf(text, " done %.2f ms (device %.2f ms).\n", time,
+                     runner.DeviceTime());
+        _Log(what + text);
+        std::sprintf(text, "ok %.2f\n", time);
+        return text;
+    }
+
+    void _Log(const std::string & text)
+    {
+        if (_verbose) {
+            std::printf("%s", text.c_str());
+            std::fflush(stdout);
+        }
+    }
+};
+//----------------------------------------------------------------------------//
+} // end anonymous namespace
+//----------------------------------------------------------------------------//
+int main(int argc, char ** argv)
+{
+    std::string socketPath = gpuip::ipc::DefaultSocketPath();
+    std::vector<std::string> files;
+    int threads = 0;
+    bool verbose = false;
+    for(int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "-h" || a == "--help") {
+            std::printf("%s", _usage);
+            return 0;
+        } else if (a == "-v" || a == "--verbose") {
+            verbose = true;
+        } else if ((a == "-s" || a == "--socket") && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if ((a == "-t" || a == "--threads") && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (a[0] != '-') {
+            files.push_back(a);
+        } else {
+            _Terminate(std::string(_usage) + "gpuipd: error: unrecognized "
+                       "argument " + a);
+        }
+    }
+    if (files.empty()) {
+        _Terminate(std::string(_usage) + "gpuipd: error: no *.ip file");
+    }
+
+    std::string err;
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    if (!gpuip::ipc::SocketAddress(socketPath, &addr, &err)) {
+        _Terminate(err);
+    }
+
+    // Contexts are created and kernels built once, before any job
+    _Runners runners;
+    for(size_t i = 0; i < files.size(); ++i) {
+        const double start = gpuip::Now();
+        const std::string name = _Name(files[i]);
+        if (runners.count(name)) {
+            _Terminate("gpuipd error: two pipelines named " + name);
+        }
+        gpuip::Runner * runner = new gpuip::Runner;
+        if (!runner->Init(files[i], threads, &err)) {
+            _Terminate(err);
+        }
+        runners[name] = runner;
+        if (verbose) {
+            std::printf("Loaded pipeline %s from %s %.2f ms\n", name.c_str(),
+                        files[i].c_str(), gpuip::Now() - start);
+        }
+    }
+
+    // A socket file left by a server that died is replaced, one that a
+    // server still answers on is not
+    const int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe >= 0 && connect(probe, (sockaddr *)&addr, sizeof(addr)) == 0) {
+        _Terminate("gpuipd error: a server is already listening on " +
+                   socketPath);
+    }
+    close(probe);
+    const int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) {
+        _Terminate("gpuipd error: could not create socket");
+    }
+    unlink(socketPath.c_str());
+    const mode_t mask = umask(0077); // only the user may submit jobs
+    const bool bound = bind(server, (sockaddr *)&addr, sizeof(addr)) == 0;
+    umask(mask);
+    if (!bound || listen(server, 16) != 0) {
+        _Terminate("gpuipd error: could not listen on " + socketPath + ": " +
+                   std::strerror(errno));
+    }
+
+    // Signals interrupt poll so that the socket file is removed on exit.
+    // Clients that go away before reading their reply are ignored.
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = _OnSignal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    if (verbose) {
+        std::printf("Listening on %s\n", socketPath.c_str());
+        std::fflush(stdout);
+    }
+
+    // Jobs run one at a time on this thread, which owns the GPU contexts.
+    // Clients are polled so that one attached to shared memory does not
+    // keep others waiting between its frames.
+    _Server s(runners, verbose);
+    std::list<_Client> clients;
+    while(!_stop) {
+        std::vector<pollfd> fds(1);
+        fds[0].fd = server;
+        fds[0].events = POLLIN;
+        std::list<_Client>::iterator c;
+        for(c = clients.begin(); c != clients.end(); ++c) {
+            pollfd p;
+            p.fd = c->fd;
+            p.events = POLLIN;
+            fds.push_back(p);
+        }
+        if (poll(&fds[0], fds.size(), 1000) < 0 && errno != EINTR) {
+            std::fprintf(stderr, "gpuipd error: poll: %s\n",
+                         std::strerror(errno));
+            break;
+        }
+
+        size_t i = 1;
+        for(c = clients.begin(); c != clients.end(); ++i) {
+            if (fds[i].revents) {
+                char chunk[4096];
+                const ssize_t n = read(c->fd, chunk, sizeof(chunk));
+                if (n <= 0) {
+                    c->close = true;
+                } else {
+                    c->received.append(chunk, n);
+                }
+                size_t end;
+                while(!c->close &&
+                      (end = c->received.find('\n')) != std::string::npos) {
+                    const std::string line = c->received.substr(0, end);
+                    c->received.erase(0, end + 1);
+                    s.HandleLine(*c, line);
+                }
+            }
+            if (!c->runner &&
+                gpuip::Now() - c->accepted > GPUIPD_RECEIVE_TIMEOUT * 1000) {
+                c->close = true;
+            }
+            if (c->close) {
+                s.Detach(*c);
+                close(c->fd);
+                c = clients.erase(c);
+            } else {
+                ++c;
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            const int fd = accept(server, NULL, NULL);
+            if (fd >= 0) {
+                // A client that stops reading its replies can not block
+                // the server for long
+                timeval timeout;
+                timeout.tv_sec = GPUIPD_RECEIVE_TIMEOUT;
+                timeout.tv_usec = 0;
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+                           sizeof(timeout));
+                clients.push_back(_Client(fd));
+            }
+        }
+    }
+
+    for(std::list<_Client>::iterator c = clients.begin(); c != clients.end();
+        ++c) {
+        s.Detach(*c);
+        close(c->fd);
+    }
+    close(server);
+    unlink(socketPath.c_str());
+    for(_Runners::iterator it = runners.begin(); it != runners.end(); ++it) {
+        delete it->second;
+    }
+    return 0;
+}
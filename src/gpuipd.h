@@ -0,0 +1,179 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Per Karlsson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GPUIP_GPUIPD_H_
+#define GPUIP_GPUIPD_H_
+//----------------------------------------------------------------------------//
+/* Protocol between gpuipd and gpuip-submit over a Unix domain socket. A
+   client connects, sends one request as lines of text and reads the reply,
+   then the connection is closed.
+
+   Request, one line per item and ended by a run line:
+     pipeline NAME          *.ip file by its name without extension, may be
+                            left out if gpuipd serves a single pipeline
+     param KERNEL PARAM VALUE
+     input BUFFER PATH      the path is the rest of the line
+     output BUFFER PATH
+     run
+
+   A request of a single ping line checks that the server is up and a single
+   shutdown line stops it.
+
+   Reply:
+     ok MILLISECONDS
+   or
+     error
+     MESSAGE...
+
+   Instead of run, a request may end with
+     attach SHM SLOTBYTES
+   to hand frames over in POSIX shared memory, see SharedFrames. The server
+   maps the shared memory object SHM, a ring of slots of SLOTBYTES bytes,
+   replies ok 0 and keeps the connection open. Every frame is then one line, optionally preceded by param lines
+   that apply to that frame only:
+     frame WIDTH HEIGHT in|out BUFFER OFFSET TYPE CHANNELS ...
+   OFFSET is the byte offset of the image in the shared memory and TYPE is
+   ubyte, half or float. An image must lie inside a single slot. Inputs are uploaded straight from the shared memory
+   and outputs downloaded back into it. The reply to a frame is a single
+   line, ok MILLISECONDS or error MESSAGE, and an invalid param line makes
+   the frame that follows it fail. Frames are processed and replied to in
+   the order they were sent.                                                */
+#include "gpuip.h"
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+//----------------------------------------------------------------------------//
+namespace gpuip {
+//----------------------------------------------------------------------------//
+namespace ipc {
+//----------------------------------------------------------------------------//
+/* Socket used when none is given, one per user. */
+inline std::string DefaultSocketPath()
+{
+    char path[64];
+    std::sprintf(path, "/tmp/gpuipd-%u.sock", (unsigned int)getuid());
+    return path;
+}
+//----------------------------------------------------------------------------//
+/* Fills in the address of a socket path. Fails if the path is too long. */
+inline bool SocketAddress(const std::string & path,
+                          sockaddr_un * addr,
+                          std::string * error)
+{
+    if (path.empty() || path.size() >= sizeof(addr->sun_path)) {
+        (*error) += "gpuipd error: invalid socket path '" + path + "'\n";
+        return false;
+    }
+    addr->sun_family = AF_UNIX;
+    path.copy(addr->sun_path, path.size());
+    addr->sun_path[path.size()] = '\0';
+    return true;
+}
+//----------------------------------------------------------------------------//
+/* Name of a buffer type in the protocol and in *.ip files. */
+inline const char * TypeName(Buffer::Type type)
+{
+    switch(type) {
+        case Buffer::UNSIGNED_BYTE:
+            return "ubyte";
+        case Buffer::HALF:
+            return "half";
+        default:
+            return "float";
+    }
+}
+//----------------------------------------------------------------------------//
+/* Bytes of one value of a buffer type. */
+inline size_t TypeSize(Buffer::Type type)
+{
+    switch(type) {
+        case Buffer::UNSIGNED_BYTE:
+            return 1;
+        case Buffer::HALF:
+            return 2;
+        default:
+            return 4;
+    }
+}
+//----------------------------------------------------------------------------//
+inline bool WriteAll(int fd, const std::string & text)
+{
+    size_t done = 0;
+    while(done < text.size()) {
+        const ssize_t n = write(fd, text.data() + done, text.size() - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+//----------------------------------------------------------------------------//
+/* Reads a socket line by line. */
+class LineReader
+{
+  public:
+    LineReader(int fd) : _fd(fd) {}
+
+    /* Reads the next line without its newline. Returns false at the end of
+       the stream or on errors such as a receive timeout. */
+    bool ReadLine(std::string * line)
+    {
+        size_t end;
+        while((end = _buffer.find('\n')) == std::string::npos) {
+            char chunk[4096];
+            const ssize_t n = read(_fd, chunk, sizeof(chunk));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                if (_buffer.empty() || n < 0) {
+                    return false;
+                }
+                // Last line without a newline
+                *line = _buffer;
+                _buffer.clear();
+                return true;
+            }
+            _buffer.append(chunk, n);
+        }
+        *line = _buffer.substr(0, end);
+        _buffer.erase(0, end + 1);
+        return true;
+    }
+  private:
+    int _fd;
+    std::string _buffer;
+};
+//----------------------------------------------------------------------------//
+} // end namespace ipc
+} // end namespace gpuip
+//----------------------------------------------------------------------------//
+#endif
@@ -0,0 +1,253 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Per Karlsson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "gpuipd_client.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/mman.h>
+//----------------------------------------------------------------------------//
+namespace gpuip {
+//----------------------------------------------------------------------------//
+namespace ipc {
+//----------------------------------------------------------------------------//
+SharedFrames::Image::Image()
+        : offset(0), type(Buffer::FLOAT), channels(4), output(false)
+{
+}
+//----------------------------------------------------------------------------//
+SharedFrames::SharedFrames()
+        : _fd(-1), _reader(NULL), _data(NULL), _slots(0), _slotBytes(0),
+          _next(0), _inFlight(0), _slotReady(false), _lastTime(0)
+{
+}
+//----------------------------------------------------------------------------//
+SharedFrames::~SharedFrames()
+{
+    Close();
+}
+//----------------------------------------------------------------------------//
+bool SharedFrames::Open(const std::string & socketPath,
+                        const std::string & pipeline,
+                        unsigned int slots,
+                        size_t slotBytes,
+                        std::string * error)
+{
+    Close();
+    if (slots == 0 || slotBytes == 0) {
+        (*error) += "gpuipd error: shared memory needs at least one slot\n";
+        return false;
+    }
+
+    // The name is only needed until the server has mapped the memory
+    static unsigned int count = 0;
+    char name[64];
+    std::sprintf(name, "/gpuip-%d-%u", (int)getpid(), count++);
+    const int shm = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (shm < 0) {
+        (*error) += "gpuipd error: could not create shared memory " +
+                std::string(name) + "\n";
+        return false;
+    }
+    const size_t bytes = (size_t)slots * slotBytes;
+    void * data = MAP_FAILED;
+    if (ftruncate(shm, bytes) == 0) {
+        data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, shm, 0);
+    }
+    close(shm);
+    if (data == MAP_FAILED) {
+        shm_unlink(name);
+        (*error) += "gpuipd error: could not map shared memory\n";
+        return false;
+    }
+    _data = data;
+    _slots = slots;
+    _slotBytes = slotBytes;
+
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    if (!SocketAddress(socketPath, &addr, error)) {
+        shm_unlink(name);
+        Close();
+        return false;
+    }
+    _fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (_fd < 0 || connect(_fd, (sockaddr *)&addr, sizeof(addr)) != 0) {
+        (*error) += "gpuipd error: no gpuipd listening on " + socketPath +
+                "\n";
+        shm_unlink(name);
+        Close();
+        return false;
+    }
+    _reader = new LineReader(_fd);
+
+    std::string request;
+    if (!pipeline.empty()) {
+        request += "pipeline " + pipeline + "\n";
+    }
+    std::stringstream attach;
+    attach << "attach " << name << " " << slotBytes << "\n";
+    request += attach.str();
+    std::string line;
+    const bool sent = WriteAll(_fd, request) && _reader->ReadLine(&line);
+    shm_unlink(name);
+    if (!sent || line.compare(0, 3, "ok ") != 0) {
+        if (!sent) {
+            (*error) += "gpuipd error: no reply from gpuipd\n";
+        }
+        while(_reader->ReadLine(&line)) {
+            (*error) += line + "\n";
+        }
+        Close();
+        return false;
+    }
+    return true;
+}
+//----------------------------------------------------------------------------//
+void * SharedFrames::Next(std::string * error)
+{
+    if (!_data) {
+        (*error) += "gpuipd error: shared frames are not open\n";
+        return NULL;
+    }
+    // A failed frame has been reported, its slot is still free to reuse
+    if (_inFlight == _slots && !Wait(error) && _inFlight == _slots) {
+        return NULL;
+    }
+    _slotReady = true;
+    return (char *)_data + (size_t)_next * _slotBytes;
+}
+//----------------------------------------------------------------------------//
+bool SharedFrames::Submit(unsigned int width,
+                          unsigned int height,
+                          const std::vector<Image> & images,
+                          const std::vector<std::vector<std::string> > &params,
+                          std::string * error)
+{
+    if (!_slotReady) {
+        (*error) += "gpuipd error: Next must be called before Submit\n";
+        return false;
+    }
+    std::stringstream ss;
+    for(size_t i = 0; i < params.size(); ++i) {
+        if (params[i].size() != 3) {
+            (*error) += "gpuipd error: a param needs kernel, name and value\n";
+            return false;
+        }
+        ss << "param " << params[i][0] << " " << params[i][1] << " "
+           << params[i][2] << "\n";
+    }
+    ss << "frame " << width << " " << height;
+    for(size_t i = 0; i < images.size(); ++i) {
+        const Image & im = images[i];
+        // An image past its slot would be read from and written into the
+        // next one, which may be in use
+        const size_t bytes = (size_t)width * height * im.channels *
+                TypeSize(im.type);
+        if (im.offset > _slotBytes || bytes > _slotBytes - im.offset) {
+            std::stringstream e;
+            e << "gpuipd error: image of buffer " << im.buffer << " needs "
+              << bytes << " bytes at offset " << im.offset
+              << " but the slots are " << _slotBytes << " bytes\n";
+            (*error) += e.str();
+            return false;
+        }
+        ss << (im.output ? " out " : " in ") << im.buffer << " "
+           << (size_t)_next * _slotBytes + im.offset << " "
+           << TypeName(im.type) << " " << im.channels;
+    }
+    ss << "\n";
+    if (!WriteAll(_fd, ss.str())) {
+        (*error) += "gpuipd error: could not send the frame\n";
+        return false;
+    }
+    _slotReady = false;
+    _next = (_next + 1) % _slots;
+    ++_inFlight;
+    return true;
+}
+//----------------------------------------------------------------------------//
+bool SharedFrames::Wait(std::string * error)
+{
+    if (_inFlight == 0) {
+        (*error) += "gpuipd error: no frame in flight\n";
+        return false;
+    }
+    std::string line;
+    if (!_reader->ReadLine(&line)) {
+        (*error) += "gpuipd error: no reply from gpuipd\n";
+        return false;
+    }
+    --_inFlight;
+    if (line.compare(0, 3, "ok ") == 0) {
+        _lastTime = std::atof(line.c_str() + 3);
+        return true;
+    }
+    (*error) += (line.compare(0, 6, "error ") == 0 ?
+                 line.substr(6) : line) + "\n";
+    return false;
+}
+//----------------------------------------------------------------------------//
+bool SharedFrames::Finish(std::string * error)
+{
+    bool ok = true;
+    while(_inFlight > 0) {
+        const unsigned int inFlight = _inFlight;
+        ok = Wait(error) && ok;
+        if (_inFlight == inFlight) {
+            return false; // lost the connection
+        }
+    }
+    return ok;
+}
+//----------------------------------------------------------------------------//
+double SharedFrames::LastTime() const
+{
+    return _lastTime;
+}
+//----------------------------------------------------------------------------//
+void SharedFrames::Close()
+{
+    delete _reader;
+    _reader = NULL;
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+    if (_data) {
+        munmap(_data, (size_t)_slots * _slotBytes);
+        _data = NULL;
+    }
+    _slots = 0;
+    _slotBytes = 0;
+    _next = 0;
+    _inFlight = 0;
+    _slotReady = false;
+}
+//----------------------------------------------------------------------------//
+} // end namespace ipc
+} // end namespace gpuip
+//----------------------------------------------------------------------------//
@@ -0,0 +1,125 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Per Karlsson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GPUIP_GPUIPD_CLIENT_H_
+#define GPUIP_GPUIPD_CLIENT_H_
+//----------------------------------------------------------------------------//
+#include "gpuip.h"
+#include "gpuipd.h"
+#include <string>
+#include <vector>
+//----------------------------------------------------------------------------//
+namespace gpuip {
+//----------------------------------------------------------------------------//
+namespace ipc {
+//----------------------------------------------------------------------------//
+/* Hands frames to a pipeline of gpuipd in POSIX shared memory instead of
+   image files. The shared memory is a ring of slots of equal size. A frame
+   is written into the next slot and submitted with a one line descriptor,
+   after which the server uploads the inputs straight from the slot and
+   downloads the outputs back into it. The next frames can be written into
+   the other slots meanwhile.
+
+     gpuip::ipc::SharedFrames frames;
+     frames.Open(gpuip::ipc::DefaultSocketPath(), "lerp", 3, bytes, &err);
+     std::vector<gpuip::ipc::SharedFrames::Image> images;
+     ... // buffers of the pipeline at byte offsets in a slot
+     for(...) {
+         char * slot = (char *)frames.Next(&err);
+         ... // write inputs
+         frames.Submit(width, height, images, params, &err);
+     }
+     frames.Finish(&err);
+
+   Outputs of the frame in a slot are ready once Next has returned that slot
+   again or Finish has returned. */
+class SharedFrames
+{
+  public:
+    struct Image
+    {
+        Image();
+
+        std::string buffer;
+        size_t offset; // bytes from the start of the slot
+        Buffer::Type type;
+        unsigned int channels;
+        bool output;
+    };
+
+    SharedFrames();
+
+    ~SharedFrames();
+
+    /* Creates the shared memory and attaches it to a pipeline of gpuipd,
+       which may be left empty if the server has a single pipeline. */
+    bool Open(const std::string & socketPath,
+              const std::string & pipeline,
+              unsigned int slots,
+              size_t slotBytes,
+              std::string * error);
+
+    /* Returns the memory of the next slot in the ring. If all slots hold
+       frames in flight, waits for the oldest one first. NULL on failure. */
+    void * Next(std::string * error);
+
+    /* Submits the frame in the slot returned by the last Next. params hold
+       kernel, param and value and apply to this frame only. */
+    bool Submit(unsigned int width,
+                unsigned int height,
+                const std::vector<Image> & images,
+                const std::vector<std::vector<std::string> > & params,
+                std::string * error);
+
+    /* Waits for the oldest frame in flight. Returns false if there is none
+       or if it failed, in which case later frames are still processed. */
+    bool Wait(std::string * error);
+
+    /* Waits for all frames in flight. */
+    bool Finish(std::string * error);
+
+    /* Time in milliseconds the server took for the last frame waited for */
+    double LastTime() const;
+
+    void Close();
+
+  private:
+    SharedFrames(const SharedFrames &);
+    SharedFrames & operator=(const SharedFrames &);
+
+    int _fd;
+    LineReader * _reader;
+    void * _data;
+    unsigned int _slots;
+    size_t _slotBytes;
+    unsigned int _next; // slot returned by the next call to Next
+    unsigned int _inFlight;
+    bool _slotReady; // Next has been called without a Submit
+    double _lastTime;
+};
+//----------------------------------------------------------------------------//
+} // end namespace ipc
+} // end namespace gpuip
+//----------------------------------------------------------------------------//
+#endif
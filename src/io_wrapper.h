@@ -25,23 +25,53 @@ SOFTWARE.
 #ifndef GPUIP_IO_WRAPPER_H_
 #define GPUIP_IO_WRAPPER_H_
 //----------------------------------------------------------------------------//
+#include "gpuip_io.h"
 #include <string>
+#include <vector>
 //----------------------------------------------------------------------------//
 namespace boost { namespace numpy { class ndarray; } }
 namespace gpuip {
-struct Buffer;
 //----------------------------------------------------------------------------//
 namespace io {
 //----------------------------------------------------------------------------//
-void ReadFromFile(boost::numpy::ndarray * npyarray,
+/* Releases the Python GIL for the lifetime of the object so that other
+   Python threads run during long native calls. No Python object may be
+   touched while it is alive. */
+class ScopedGILRelease
+{
+  public:
+    ScopedGILRelease();
+
+    ~ScopedGILRelease();
+  private:
+    void * _state;
+
+    ScopedGILRelease(const ScopedGILRelease &);
+    void operator=(const ScopedGILRelease &);
+};
+//----------------------------------------------------------------------------//
+/* Thin numpy wrappers around ImageReader and WriteImage. Must be called
+   with the GIL held, which is released while the image is decoded, encoded
+   and converted. The array is allocated with the size of the image and the
+   type and channels of the buffer. */
+bool ReadFromFile(boost::numpy::ndarray * npyarray,
                   const Buffer & buffer,
                   const std::string & filename,
-                  int numThreads = 0);
+                  std::string * error,
+                  int numThreads = 0,
+                  const std::vector<std::string> & channels =
+                  std::vector<std::string>());
 //----------------------------------------------------------------------------//
-void WriteToFile(const boost::numpy::ndarray * npyarray,
+/* The type of the pixels is taken from the array, which must be unsigned
+   byte, half or float. */
+bool WriteToFile(const boost::numpy::ndarray * npyarray,
                  const Buffer & buffer,
                  const std::string & filename,
-                 int numThreads = 0);
+                 std::string * error,
+                 int numThreads = 0,
+                 const std::vector<std::string> & channels =
+                 std::vector<std::string>(),
+                 const ExrOptions & options = ExrOptions());
 //----------------------------------------------------------------------------//
 } // end namespace io
 } // end namespace gpuip
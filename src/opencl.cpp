@@ -25,32 +25,191 @@ SOFTWARE.
 #include "opencl.h"
 #include "opencl_error.h"
 #include <ctime>
+#include <algorithm>
+#include <cstring>
 //----------------------------------------------------------------------------//
 namespace gpuip {
 //----------------------------------------------------------------------------//
-OpenCLImpl::OpenCLImpl()
-        : ImageProcessor(OpenCL)
+inline cl_device_type _GetDeviceType(Device::Type type)
 {
-    // Get Platform ID
-    cl_platform_id platform_id;
-    if(clGetPlatformIDs(1, &platform_id, NULL) != CL_SUCCESS) {
-        throw std::logic_error("gpuip::OpenCLImpl() could not get platform id");
+    switch(type) {
+        case Device::CPU:
+            return CL_DEVICE_TYPE_CPU;
+        case Device::ACCELERATOR:
+            return CL_DEVICE_TYPE_ACCELERATOR;
+        case Device::ALL:
+            return CL_DEVICE_TYPE_ALL;
+        case Device::GPU:
+        default:
+            return CL_DEVICE_TYPE_GPU;
     }
-    
-    // TODO add option for CPU? Could be nice for testing
-    cl_device_type device_type = CL_DEVICE_TYPE_GPU;
+}
+//----------------------------------------------------------------------------//
+inline std::string _GetPlatformName(cl_platform_id platform_id)
+{
+    char name[256] = "";
+    clGetPlatformInfo(platform_id, CL_PLATFORM_NAME, sizeof(name), name, NULL);
+    return std::string(name);
+}
+//----------------------------------------------------------------------------//
+inline std::string _GetDeviceName(cl_device_id device_id)
+{
+    char name[256] = "";
+    clGetDeviceInfo(device_id, CL_DEVICE_NAME, sizeof(name), name, NULL);
+    return std::string(name);
+}
+//----------------------------------------------------------------------------//
+// Collects the devices matching the type and platform of the Device, in
+// platform order. Also fills in a Device description per match if asked to.
+// Returns false if the platforms could not be queried.
+inline bool _FindDevices(const Device & device,
+                  std::vector<cl_device_id> * device_ids,
+                  std::vector<Device> * devices)
+{
+    cl_uint num_platforms = 0;
+    if (clGetPlatformIDs(0, NULL, &num_platforms) != CL_SUCCESS ||
+        num_platforms == 0) {
+        return false;
+    }
+    std::vector<cl_platform_id> platform_ids(num_platforms);
+    clGetPlatformIDs(num_platforms, platform_ids.data(), NULL);
+
+    for(cl_uint p = 0; p < num_platforms; ++p) {
+        if (device.platform != GPUIP_ANY_PLATFORM && device.platform != (int)p){
+            continue;
+        }
 
-    // Get Device ID
-    if(clGetDeviceIDs(platform_id, device_type,
-                      1 /*only 1 device for now */,
-                      &_device_id, NULL) != CL_SUCCESS) {
-        throw std::logic_error("gpuip::OpenCLImpl() could not get device id");
+        // A platform without devices of this type returns an error
+        cl_uint num_devices = 0;
+        if (clGetDeviceIDs(platform_ids[p], _GetDeviceType(device.type),
+                           0, NULL, &num_devices) != CL_SUCCESS) {
+            continue;
+        }
+        std::vector<cl_device_id> ids(num_devices);
+        clGetDeviceIDs(platform_ids[p], _GetDeviceType(device.type),
+                       num_devices, ids.data(), NULL);
+
+        for(cl_uint d = 0; d < num_devices; ++d) {
+            device_ids->push_back(ids[d]);
+            if (devices) {
+                Device info(device.type, (int)d, (int)p);
+                info.name = _GetDeviceName(ids[d]);
+                info.platformName = _GetPlatformName(platform_ids[p]);
+                devices->push_back(info);
+            }
+        }
+    }
+    return true;
+}
+//----------------------------------------------------------------------------//
+// Runs a small kernel with both memory traffic and arithmetic on the device.
+// Returns the kernel time in milliseconds, or a negative value on failure.
+inline double _BenchmarkDevice(cl_device_id device_id)
+{
+    static const char * code =
+            "__kernel void gpuip_benchmark(__global float * data)\n"
+            "{\n"
+            "    const int i = get_global_id(0);\n"
+            "    float v = data[i];\n"
+            "    for (int k = 0; k < 64; ++k) {\n"
+            "        v = v * 0.999f + 0.5f;\n"
+            "    }\n"
+            "    data[i] = v;\n"
+            "}";
+    const size_t N = 1 << 20;
+    double time = -1.0;
+
+    // Each step only runs if all before it succeeded, a device that fails
+    // any of them is skipped
+    cl_int cl_err;
+    cl_context ctx = clCreateContext(NULL, 1, &device_id, NULL, NULL, &cl_err);
+    if (cl_err != CL_SUCCESS) {
+        return time;
+    }
+    cl_command_queue queue = clCreateCommandQueue(
+        ctx, device_id, CL_QUEUE_PROFILING_ENABLE, &cl_err);
+    cl_program program = NULL;
+    cl_mem data = NULL;
+    cl_kernel kernel = NULL;
+    if (cl_err == CL_SUCCESS) {
+        program = clCreateProgramWithSource(ctx, 1, &code, NULL, &cl_err);
+    }
+    if (cl_err == CL_SUCCESS) {
+        data = clCreateBuffer(ctx, CL_MEM_READ_WRITE, N * sizeof(float),
+                              NULL, &cl_err);
+    }
+    if (cl_err == CL_SUCCESS) {
+        cl_err = clBuildProgram(program, 1, &device_id, NULL, NULL, NULL);
+    }
+    if (cl_err == CL_SUCCESS) {
+        kernel = clCreateKernel(program, "gpuip_benchmark", &cl_err);
+    }
+    if (cl_err == CL_SUCCESS) {
+        cl_err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &data);
     }
 
-    // Create context and command queue
-    _ctx = clCreateContext(NULL, 1, &_device_id, NULL, NULL, NULL);
-    _queue = clCreateCommandQueue(_ctx, _device_id,
-                                  CL_QUEUE_PROFILING_ENABLE, NULL);
+    // First launch is a warm-up, second one is timed
+    cl_event event;
+    for (int i = 0; i < 2 && cl_err == CL_SUCCESS; ++i) {
+        cl_err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &N, NULL,
+                                        0, NULL, &event);
+        if (cl_err == CL_SUCCESS) {
+            cl_err = clWaitForEvents(1, &event);
+            if (cl_err == CL_SUCCESS && i) {
+                cl_ulong start,end;
+                if (clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START,
+                                            sizeof(cl_ulong), &start,
+                                            NULL) == CL_SUCCESS &&
+                    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END,
+                                            sizeof(cl_ulong), &end,
+                                            NULL) == CL_SUCCESS) {
+                    time = (double)(end-start) * 1.0e-6;
+                }
+            }
+            clReleaseEvent(event);
+        }
+    }
+
+    if (kernel) {
+        clReleaseKernel(kernel);
+    }
+    if (data) {
+        clReleaseMemObject(data);
+    }
+    if (program) {
+        clReleaseProgram(program);
+    }
+    if (queue) {
+        clReleaseCommandQueue(queue);
+    }
+    clReleaseContext(ctx);
+    return time;
+}
+//----------------------------------------------------------------------------//
+inline cl_device_id _FastestDevice(const std::vector<cl_device_id> & device_ids)
+{
+    cl_device_id fastest = device_ids.front();
+    double fastest_time = -1.0;
+    for(size_t i = 0; i < device_ids.size(); ++i) {
+        const double time = _BenchmarkDevice(device_ids[i]);
+        if (time >= 0 && (fastest_time < 0 || time < fastest_time)) {
+            fastest = device_ids[i];
+            fastest_time = time;
+        }
+    }
+    return fastest;
+}
+//----------------------------------------------------------------------------//
+OpenCLImpl::OpenCLImpl(const Device & device)
+        : ImageProcessor(OpenCL)
+{
+    _CreateContexts(std::vector<Device>(1, device));
+}
+//----------------------------------------------------------------------------//
+OpenCLImpl::OpenCLImpl(const std::vector<Device> & devices)
+        : ImageProcessor(OpenCL)
+{
+    _CreateContexts(devices);
 }
 //----------------------------------------------------------------------------//
 OpenCLImpl::~OpenCLImpl()
@@ -64,9 +223,180 @@ OpenCLImpl::~OpenCLImpl()
     if (!_ReleaseKernels(&err)) {
         std::cerr << err << std::endl;
     }
-    
-    clReleaseCommandQueue(_queue);
-    clReleaseContext(_ctx);
+
+    // Host memory that the user did not free would outlive the contexts
+    while(!_hostMemory.empty()) {
+        err.clear();
+        if (!FreeHostMemory(_hostMemory.begin()->first, &err)) {
+            std::cerr << err << std::endl;
+            _hostMemory.erase(_hostMemory.begin());
+        }
+    }
+
+    for(size_t i = 0; i < _devices.size(); ++i) {
+        clReleaseCommandQueue(_devices[i].queue);
+    }
+    for(size_t i = 0; i < _contexts.size(); ++i) {
+        clReleaseContext(_contexts[i]);
+    }
+}
+//----------------------------------------------------------------------------//
+void OpenCLImpl::_CreateContexts(const std::vector<Device> & devices)
+{
+    // Get Device IDs
+    std::vector<cl_device_id> device_ids;
+    for(size_t i = 0; i < devices.size(); ++i) {
+        std::vector<cl_device_id> candidates;
+        if (!_FindDevices(devices[i], &candidates, NULL)) {
+            throw std::logic_error(
+                "gpuip::OpenCLImpl() could not get platform id");
+        }
+        if (candidates.empty()) {
+            throw std::logic_error("gpuip::OpenCLImpl() could not find a "
+                                   "device of the requested type");
+        }
+
+        if (devices[i].index == GPUIP_FASTEST_DEVICE) {
+            device_ids.push_back(_FastestDevice(candidates));
+        } else if (devices[i].index >= 0 &&
+                   devices[i].index < (int)candidates.size()) {
+            device_ids.push_back(candidates[devices[i].index]);
+        } else {
+            throw std::logic_error("gpuip::OpenCLImpl() could not get device id");
+        }
+    }
+
+    // Devices of the same platform share one context
+    std::vector<cl_platform_id> platforms;
+    for(size_t i = 0; i < device_ids.size(); ++i) {
+        cl_platform_id platform;
+        clGetDeviceInfo(device_ids[i], CL_DEVICE_PLATFORM,
+                        sizeof(cl_platform_id), &platform, NULL);
+        if (std::find(platforms.begin(), platforms.end(), platform) ==
+            platforms.end()) {
+            platforms.push_back(platform);
+        }
+    }
+    for(size_t p = 0; p < platforms.size(); ++p) {
+        std::vector<cl_device_id> platform_devices;
+        for(size_t i = 0; i < device_ids.size(); ++i) {
+            cl_platform_id platform;
+            clGetDeviceInfo(device_ids[i], CL_DEVICE_PLATFORM,
+                            sizeof(cl_platform_id), &platform, NULL);
+            if (platform == platforms[p]) {
+                platform_devices.push_back(device_ids[i]);
+            }
+        }
+
+        // Create context and command queues
+        cl_int cl_err;
+        cl_context ctx = clCreateContext(NULL, platform_devices.size(),
+                                         platform_devices.data(),
+                                         NULL, NULL, &cl_err);
+        if (cl_err != CL_SUCCESS) {
+            throw std::logic_error(
+                "gpuip::OpenCLImpl() could not create context");
+        }
+        _contexts.push_back(ctx);
+
+        for(size_t i = 0; i < platform_devices.size(); ++i) {
+            ClDevice device;
+            device.id = platform_devices[i];
+            device.ctx = ctx;
+            device.queue = clCreateCommandQueue(ctx, device.id,
+                                                CL_QUEUE_PROFILING_ENABLE,
+                                                NULL);
+            device.y0 = device.y1 = 0;
+            cl_uint compute_units = 1, clock_frequency = 1;
+            clGetDeviceInfo(device.id, CL_DEVICE_MAX_COMPUTE_UNITS,
+                            sizeof(cl_uint), &compute_units, NULL);
+            clGetDeviceInfo(device.id, CL_DEVICE_MAX_CLOCK_FREQUENCY,
+                            sizeof(cl_uint), &clock_frequency, NULL);
+            device.speed = (double)compute_units * clock_frequency;
+            device.throughput = 0;
+            _devices.push_back(device);
+        }
+    }
+}
+//----------------------------------------------------------------------------//
+void OpenCLImpl::_BalanceBands()
+{
+    // Use the measured throughput once all devices have been timed,
+    // otherwise fall back to the estimated speed
+    bool measured = true;
+    for(size_t i = 0; i < _devices.size(); ++i) {
+        measured = measured && _devices[i].throughput > 0;
+    }
+
+    double total = 0;
+    for(size_t i = 0; i < _devices.size(); ++i) {
+        total += measured ? _devices[i].throughput : _devices[i].speed;
+    }
+
+    // Bands are proportional to the speed of the device. Every device gets
+    // at least one row (if there are enough rows) so that it gets measured.
+    double sum = 0;
+    unsigned int y = 0;
+    for(size_t i = 0; i < _devices.size(); ++i) {
+        sum += measured ? _devices[i].throughput : _devices[i].speed;
+        const unsigned int rows_left = _devices.size() - 1 - i;
+        unsigned int y1 = total > 0 ? (unsigned int)(_h * sum / total + 0.5) :
+                _h * (i + 1) / _devices.size();
+        y1 = std::max(y1, std::min(y + 1, _h));
+        y1 = std::min(y1, _h > rows_left ? _h - rows_left : _h);
+        _devices[i].y0 = y;
+        _devices[i].y1 = std::max(y1, y);
+        y = _devices[i].y1;
+    }
+    if (!_devices.empty()) {
+        _devices.back().y1 = _h;
+    }
+}
+//----------------------------------------------------------------------------//
+std::vector<Device> OpenCLImpl::ListDevices()
+{
+    std::vector<cl_device_id> device_ids;
+    std::vector<Device> devices;
+    const Device::Type types[] = { Device::GPU,
+                                   Device::CPU,
+                                   Device::ACCELERATOR };
+    for(int i = 0; i < 3; ++i) {
+        _FindDevices(Device(types[i], 0, GPUIP_ANY_PLATFORM),
+                     &device_ids, &devices);
+    }
+    return devices;
+}
+//----------------------------------------------------------------------------//
+inline bool _GetImageFormat(const Buffer::Ptr & buffer,
+                            cl_image_format * format)
+{
+    switch(buffer->channels) {
+        case 1:
+            format->image_channel_order = CL_R;
+            break;
+        case 2:
+            format->image_channel_order = CL_RG;
+            break;
+        case 4:
+            format->image_channel_order = CL_RGBA;
+            break;
+        default:
+            return false;
+    }
+
+    switch(buffer->type) {
+        case Buffer::UNSIGNED_BYTE:
+            format->image_channel_data_type = CL_UNORM_INT8;
+            break;
+        case Buffer::HALF:
+            format->image_channel_data_type = CL_HALF_FLOAT;
+            break;
+        case Buffer::FLOAT:
+        default:
+            format->image_channel_data_type = CL_FLOAT;
+            break;
+    }
+    return true;
 }
 //----------------------------------------------------------------------------//
 double OpenCLImpl::Allocate(std::string * err)
@@ -78,16 +408,57 @@ double OpenCLImpl::Allocate(std::string * err)
     }
 
     cl_int cl_err;
-    std::map<std::string,Buffer::Ptr>::const_iterator it;
-    for (it = _buffers.begin(); it != _buffers.end(); ++it) {
-        _clBuffers[it->second->name] = clCreateBuffer(
-            _ctx, CL_MEM_READ_WRITE,
-            _BufferSize(it->second), NULL, &cl_err);
-        if (_clErrorInitBuffers(cl_err, err)) {
-            return GPUIP_ERROR;
+    for(size_t i = 0; i < _devices.size(); ++i) {
+        std::map<std::string,Buffer::Ptr>::const_iterator it;
+        for (it = _buffers.begin(); it != _buffers.end(); ++it) {
+            if (it->second->storage == Buffer::IMAGE) {
+                cl_image_format format;
+                if (!_GetImageFormat(it->second, &format)) {
+                    (*err) += "OpenCL: image buffer ";
+                    (*err) += it->second->name;
+                    (*err) += " must have 1, 2 or 4 channels\n";
+                    return GPUIP_ERROR;
+                }
+                cl_image_desc desc;
+                memset(&desc, 0, sizeof(cl_image_desc));
+                desc.image_type = CL_MEM_OBJECT_IMAGE2D;
+                desc.image_width = _w;
+                desc.image_height = _h;
+                _devices[i].buffers[it->second->name] = clCreateImage(
+                    _devices[i].ctx, CL_MEM_READ_WRITE,
+                    &format, &desc, NULL, &cl_err);
+            } else {
+                _devices[i].buffers[it->second->name] = clCreateBuffer(
+                    _devices[i].ctx, CL_MEM_READ_WRITE,
+                    _BufferSize(it->second), NULL, &cl_err);
+            }
+            if (_clErrorInitBuffers(cl_err, err)) {
+                return GPUIP_ERROR;
+            }
+        }
+    }
+    _BalanceBands();
+    return _timing ?
+            ( std::clock() - start ) / (long double) CLOCKS_PER_SEC : 0;
+}
+//----------------------------------------------------------------------------//
+inline size_t _TileBytes(const Kernel & kernel)
+{
+    // Bytes of local memory taken by the tiles from _GetTileCode
+    const size_t side = GPUIP_TILE_SIZE + 2 * kernel.radius;
+    size_t bytes = 0;
+    for(size_t i = 0; i < kernel.inBuffers.size(); ++i) {
+        const Buffer::Ptr & buf = kernel.inBuffers[i].buffer;
+        // images are sampled directly and get no tile
+        if (buf->storage == Buffer::IMAGE) {
+            continue;
         }
+        // half tiles are float, 3 component vectors are aligned as 4
+        const size_t channels = buf->channels == 3 ? 4 : buf->channels;
+        bytes += side * side * channels *
+                (buf->type == Buffer::UNSIGNED_BYTE ? 1 : sizeof(float));
     }
-    return ( std::clock() - start ) / (long double) CLOCKS_PER_SEC;
+    return bytes;
 }
 //----------------------------------------------------------------------------//
 double OpenCLImpl::Build(std::string * error)
@@ -97,100 +468,295 @@ double OpenCLImpl::Build(std::string * error)
     if(!_ReleaseKernels(error)) {
         return GPUIP_ERROR;
     }
-    
-    cl_int cl_err;
+
+    // A tile that does not fit local memory would only fail when building
+    // or enqueueing, with a less helpful error
     for(size_t i = 0; i < _kernels.size(); ++i) {
-        const char * code = _kernels[i]->code.c_str();
-        const char * name = _kernels[i]->name.c_str();
-        cl_program program = clCreateProgramWithSource(
-            _ctx, 1, &code, NULL,  &cl_err);
-        if (_clErrorCreateProgram(cl_err, error)) {
-            return GPUIP_ERROR;
+        if (_kernels[i]->radius == 0) {
+            continue;
         }
-        
-        // Build program
-        cl_err = clBuildProgram(program, 1, &_device_id, NULL, NULL, NULL);
-        if (_clErrorBuildProgram(cl_err, error, program, _device_id, name)) {
-            return GPUIP_ERROR;
+        const size_t tile_bytes = _TileBytes(*_kernels[i].get());
+        for(size_t d = 0; d < _devices.size(); ++d) {
+            cl_ulong local_mem = 0;
+            clGetDeviceInfo(_devices[d].id, CL_DEVICE_LOCAL_MEM_SIZE,
+                            sizeof(cl_ulong), &local_mem, NULL);
+            if (tile_bytes > local_mem) {
+                std::stringstream ss;
+                ss << "OpenCL: radius " << _kernels[i]->radius
+                   << " of kernel " << _kernels[i]->name << " needs "
+                   << tile_bytes << " bytes of local memory, the device has "
+                   << local_mem << "\n";
+                (*error) += ss.str();
+                return GPUIP_ERROR;
+            }
         }
+    }
     
-        // Create kernel from program
-        _clKernels.push_back(clCreateKernel(program, name, &cl_err));
-        if (_clErrorCreateKernel(cl_err, error)) {
-            return GPUIP_ERROR;
+    cl_int cl_err;
+    for(size_t c = 0; c < _contexts.size(); ++c) {
+        std::vector<cl_device_id> device_ids;
+        for(size_t d = 0; d < _devices.size(); ++d) {
+            if (_devices[d].ctx == _contexts[c]) {
+                device_ids.push_back(_devices[d].id);
+            }
+        }
+
+        for(size_t i = 0; i < _kernels.size(); ++i) {
+            const char * code = _kernels[i]->code.c_str();
+            const char * name = _kernels[i]->name.c_str();
+            cl_program program = clCreateProgramWithSource(
+                _contexts[c], 1, &code, NULL,  &cl_err);
+            if (_clErrorCreateProgram(cl_err, error)) {
+                return GPUIP_ERROR;
+            }
+
+            // Build program for all devices in the context
+            cl_err = clBuildProgram(program, device_ids.size(),
+                                    device_ids.data(), NULL, NULL, NULL);
+            if (_clErrorBuildProgram(cl_err, error, program, device_ids[0],
+                                     name)) {
+                clReleaseProgram(program);
+                return GPUIP_ERROR;
+            }
+
+            // Create kernel from program, kernels keep the program alive
+            for(size_t d = 0; d < _devices.size(); ++d) {
+                if (_devices[d].ctx != _contexts[c]) {
+                    continue;
+                }
+                _devices[d].kernels.push_back(
+                    clCreateKernel(program, name, &cl_err));
+                if (_clErrorCreateKernel(cl_err, error)) {
+                    clReleaseProgram(program);
+                    return GPUIP_ERROR;
+                }
+            }
+            clReleaseProgram(program);
         }
     }
-    return ( std::clock() - start ) / (long double) CLOCKS_PER_SEC;
+    return _timing ?
+            ( std::clock() - start ) / (long double) CLOCKS_PER_SEC : 0;
 }
 //----------------------------------------------------------------------------//
-double OpenCLImpl::Run(std::string * err)
+inline double _EventsTime(const std::vector<cl_event> & events)
 {
-    cl_event event;
-    for(size_t i = 0; i < _kernels.size(); ++i) {
-        if (!_EnqueueKernel(*_kernels[i].get(), _clKernels[i], event, err)) {
-            return GPUIP_ERROR;
-        }
-    }
-    clFinish(_queue);
-    clWaitForEvents(1, &event);
+    // From the start of the first command to the end of the last one
     cl_ulong start,end;
-    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START,
+    clGetEventProfilingInfo(events.front(), CL_PROFILING_COMMAND_START,
                             sizeof(cl_ulong), &start, NULL);
-    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END,
+    clGetEventProfilingInfo(events.back(), CL_PROFILING_COMMAND_END,
                             sizeof(cl_ulong), &end, NULL);
-    return (double)(end-start) * 1.0e-6 ;
+    return (double)(end-start) * 1.0e-6;
 }
 //----------------------------------------------------------------------------//
-double OpenCLImpl::Copy(Buffer::Ptr buffer,
-                        Buffer::CopyOperation op,
-                        void * data,
-                        std::string * error)
+inline void _ReleaseEvents(std::vector<std::vector<cl_event> > & events)
 {
-    cl_event event;
-    cl_int cl_err = CL_SUCCESS; //set to success to get rid of compiler warnings
-    if (op == Buffer::COPY_FROM_GPU) {
-        cl_err =  clEnqueueReadBuffer(
-            _queue,  _clBuffers[buffer->name],
-            CL_TRUE /* function call returns when copy is done */ ,
-            0, _BufferSize(buffer), data, 0 , NULL, &event);
-    } else if (op == Buffer::COPY_TO_GPU) {
-        cl_err =  clEnqueueWriteBuffer(
-            _queue,  _clBuffers[buffer->name],
-            CL_TRUE /* function call returns when copy is done */ ,
-            0, _BufferSize(buffer), data, 0 , NULL, &event);
-    }
-    if (_clErrorCopy(cl_err, error, buffer->name, op)) {
+    for(size_t i = 0; i < events.size(); ++i) {
+        for(size_t j = 0; j < events[i].size(); ++j) {
+            clReleaseEvent(events[i][j]);
+        }
+        events[i].clear();
+    }
+}
+//----------------------------------------------------------------------------//
+double OpenCLImpl::Run(std::string * err)
+{
+    _BalanceBands();
+
+    // Rows each kernel computes outside of the band of a device so that the
+    // kernels after it can read their neighbourhood (stencil halo)
+    std::vector<unsigned int> halo(_kernels.size(), 0);
+    for(int i = (int)_kernels.size() - 2; i >= 0; --i) {
+        halo[i] = halo[i+1] + _kernels[i+1]->radius;
+    }
+
+    std::vector<std::vector<cl_event> > events(_devices.size());
+    for(size_t d = 0; d < _devices.size(); ++d) {
+        const ClDevice & device = _devices[d];
+        if (device.y0 == device.y1) {
+            continue;
+        }
+        for(size_t i = 0; i < _kernels.size(); ++i) {
+            const unsigned int y0 = device.y0 > halo[i] ? device.y0-halo[i] : 0;
+            const unsigned int y1 = std::min(device.y1 + halo[i], _h);
+            cl_event event;
+            if (!_EnqueueKernel(*_kernels[i].get(), device, device.kernels[i],
+                                y0, y1, event, err)) {
+                _ReleaseEvents(events);
+                return GPUIP_ERROR;
+            }
+            events[d].push_back(event);
+        }
+        // Start processing right away so that all devices work concurrently
+        clFlush(device.queue);
+    }
+
+    double time = 0;
+    _kernelTimes.assign(_timing ? _kernels.size() : 0, 0);
+    for(size_t d = 0; d < _devices.size(); ++d) {
+        if (events[d].empty()) {
+            continue;
+        }
+        clFinish(_devices[d].queue);
+        const double t = _EventsTime(events[d]);
+        time = std::max(time, t);
+        for(size_t i = 0; i < _kernelTimes.size(); ++i) {
+            const std::vector<cl_event> kernelEvent(1, events[d][i]);
+            _kernelTimes[i] = std::max(_kernelTimes[i],
+                                       _EventsTime(kernelEvent));
+        }
+
+        // The band sizes of the next run follow the measured throughput
+        if (t > 0) {
+            const double throughput = (_devices[d].y1 - _devices[d].y0) / t;
+            _devices[d].throughput = _devices[d].throughput > 0 ?
+                    0.5 * (_devices[d].throughput + throughput) : throughput;
+        }
+    }
+    _ReleaseEvents(events);
+    return _timing ? time : 0;
+}
+//----------------------------------------------------------------------------//
+double OpenCLImpl::CopyRows(Buffer::Ptr buffer,
+                            Buffer::CopyOperation op,
+                            void * data,
+                            unsigned int y0,
+                            unsigned int y1,
+                            std::string * error)
+{
+    if (!_ValidRows(buffer, y0, y1, error)) {
         return GPUIP_ERROR;
     }
-    clWaitForEvents(1, &event);
-    cl_ulong start,end;
-    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START,
-                            sizeof(cl_ulong), &start, NULL);
-    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END,
-                            sizeof(cl_ulong), &end, NULL);
-    return (double)(end-start) * 1.0e-6 ;
+    if (y0 == y1) {
+        return 0;
+    }
+    const size_t row = _BytesPerPixel(buffer) * _w;
+    std::vector<std::vector<cl_event> > events(_devices.size());
+    for(size_t d = 0; d < _devices.size(); ++d) {
+        ClDevice & device = _devices[d];
+        cl_event event;
+        cl_int cl_err = CL_SUCCESS; //set to success to get rid of warnings
+        if (op == Buffer::COPY_FROM_GPU) {
+            // Each device returns the requested rows of its band
+            const unsigned int a = std::max(y0, device.y0);
+            const unsigned int b = std::min(y1, device.y1);
+            if (a >= b) {
+                continue;
+            }
+            char * to = static_cast<char *>(data) + (a - y0) * row;
+            if (buffer->storage == Buffer::IMAGE) {
+                const size_t origin[] = { 0, a, 0 };
+                const size_t region[] = { _w, b - a, 1 };
+                cl_err = clEnqueueReadImage(
+                    device.queue, device.buffers[buffer->name], CL_FALSE,
+                    origin, region, row, 0, to, 0, NULL, &event);
+            } else {
+                cl_err =  clEnqueueReadBuffer(
+                    device.queue, device.buffers[buffer->name], CL_FALSE,
+                    a * row, (b - a) * row, to, 0 , NULL, &event);
+            }
+        } else if (op == Buffer::COPY_TO_GPU) {
+            // Every device gets all of the rows
+            if (buffer->storage == Buffer::IMAGE) {
+                const size_t origin[] = { 0, y0, 0 };
+                const size_t region[] = { _w, y1 - y0, 1 };
+                cl_err = clEnqueueWriteImage(
+                    device.queue, device.buffers[buffer->name], CL_FALSE,
+                    origin, region, row, 0, data, 0, NULL, &event);
+            } else {
+                cl_err =  clEnqueueWriteBuffer(
+                    device.queue, device.buffers[buffer->name], CL_FALSE,
+                    y0 * row, (y1 - y0) * row, data, 0 , NULL, &event);
+            }
+        }
+        if (_clErrorCopy(cl_err, error, buffer->name, op)) {
+            _ReleaseEvents(events);
+            return GPUIP_ERROR;
+        }
+        events[d].push_back(event);
+        clFlush(device.queue);
+    }
+
+    // Function call returns when all copies are done
+    double time = 0;
+    for(size_t d = 0; d < _devices.size(); ++d) {
+        if (!events[d].empty()) {
+            clWaitForEvents(1, &events[d].front());
+            time = std::max(time, _EventsTime(events[d]));
+        }
+    }
+    _ReleaseEvents(events);
+    return _timing ? time : 0;
+}
+//----------------------------------------------------------------------------//
+void * OpenCLImpl::AllocateHostMemory(Buffer::Ptr buffer, std::string * err)
+{
+    // Drivers back CL_MEM_ALLOC_HOST_PTR buffers with page-locked memory,
+    // mapping one gives a host pointer that is transferred with DMA
+    const ClDevice & device = _devices.front();
+    const size_t size = _BufferSize(buffer);
+    cl_int cl_err;
+    cl_mem mem = clCreateBuffer(device.ctx,
+                                CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
+                                size, NULL, &cl_err);
+    if (_clErrorInitBuffers(cl_err, err)) {
+        return NULL;
+    }
+    void * data = clEnqueueMapBuffer(device.queue, mem, CL_TRUE,
+                                     CL_MAP_READ | CL_MAP_WRITE, 0, size,
+                                     0, NULL, NULL, &cl_err);
+    if (_clErrorInitBuffers(cl_err, err)) {
+        clReleaseMemObject(mem);
+        return NULL;
+    }
+    _hostMemory[data] = mem;
+    return data;
+}
+//----------------------------------------------------------------------------//
+bool OpenCLImpl::FreeHostMemory(void * data, std::string * err)
+{
+    std::map<void *, cl_mem>::iterator it = _hostMemory.find(data);
+    if (it == _hostMemory.end()) {
+        (*err) += "OpenCL: host memory was not allocated by this processor\n";
+        return false;
+    }
+    const ClDevice & device = _devices.front();
+    cl_int cl_err = clEnqueueUnmapMemObject(device.queue, it->second, data,
+                                            0, NULL, NULL);
+    if (_clErrorReleaseMemObject(cl_err, err)) {
+        return false;
+    }
+    clFinish(device.queue);
+    cl_err = clReleaseMemObject(it->second);
+    _hostMemory.erase(it);
+    return !_clErrorReleaseMemObject(cl_err, err);
 }
 //----------------------------------------------------------------------------//
 bool OpenCLImpl::_EnqueueKernel(const Kernel & kernel,
+                                const ClDevice & device,
                                 const cl_kernel & clKernel,
+                                unsigned int y0,
+                                unsigned int y1,
                                 cl_event & event,
                                 std::string * err)
 {
     cl_int cl_err;
     cl_int argc = 0;
+    std::map<std::string, cl_mem> & buffers =
+            const_cast<ClDevice &>(device).buffers;
     
     // Set kernel arguments in the following order:
     // 1. Input buffers.
     const size_t size = sizeof(cl_mem);
     for(size_t j = 0; j < kernel.inBuffers.size(); ++j) {
         cl_err = clSetKernelArg(clKernel, argc++, size,
-                                &_clBuffers[kernel.inBuffers[j].buffer->name]);
+                                &buffers[kernel.inBuffers[j].buffer->name]);
     }
 
     // 2. Output buffers.
     for(size_t j = 0; j < kernel.outBuffers.size(); ++j) {
         cl_err = clSetKernelArg(clKernel, argc++, size,
-                                &_clBuffers[kernel.outBuffers[j].buffer->name]);
+                                &buffers[kernel.outBuffers[j].buffer->name]);
     }
 
     // 3. Int parameters
@@ -211,12 +777,27 @@ bool OpenCLImpl::_EnqueueKernel(const Kernel & kernel,
 
     // It should be fine to check once all the arguments have been set
     if (_clErrorSetKernelArg(cl_err, err, kernel.name)) {
-        return GPUIP_ERROR;
+        return false;
     }
-    
-    const size_t global_work_size[] = { _w, _h };    
-    cl_err = clEnqueueNDRangeKernel(_queue, clKernel, 2, NULL,
-                                    global_work_size, NULL, 0, NULL, &event);
+
+    // The rows y0 to y1 are processed. Kernels get the global y coordinate
+    // from get_global_id(1) since it includes the offset.
+    const size_t global_work_offset[] = { 0, y0 };
+    size_t global_work_size[] = { _w, y1 - y0 };
+
+    // Tiled stencil kernels need whole TILE x TILE work groups. The extra
+    // work items load the tile and return at the bounds check.
+    const size_t local_work_size[] = { GPUIP_TILE_SIZE, GPUIP_TILE_SIZE };
+    if (kernel.radius > 0) {
+        for(int i = 0; i < 2; ++i) {
+            global_work_size[i] = ((global_work_size[i] + GPUIP_TILE_SIZE - 1)
+                                   / GPUIP_TILE_SIZE) * GPUIP_TILE_SIZE;
+        }
+    }
+    cl_err = clEnqueueNDRangeKernel(device.queue, clKernel, 2,
+                                    global_work_offset, global_work_size,
+                                    kernel.radius > 0 ? local_work_size : NULL,
+                                    0, NULL, &event);
 
     if (_clErrorEnqueueKernel(cl_err, err, kernel)) {
         return false;
@@ -250,6 +831,61 @@ inline std::string _GetTypeStr(const Buffer::Ptr & buffer)
     return type.str();
 }
 //----------------------------------------------------------------------------//
+inline std::string _GetTileCode(const Kernel & kernel,
+                                const std::map<std::string,Buffer::Ptr> & buffers)
+{
+    std::stringstream ss;
+    ss << "    // tile plus halo of the inputs in local memory, pixel (x+dx,y+dy)"
+       << " is\n"
+       << "    // X_tile[ly + RADIUS + dy][lx + RADIUS + dx] "
+       << "where -RADIUS <= dx,dy <= RADIUS\n";
+    for(size_t i = 0; i < kernel.inBuffers.size(); ++i) {
+        Buffer::Ptr buf = buffers.find(kernel.inBuffers[i].buffer->name)->second;
+        if (buf->storage == Buffer::IMAGE) {
+            continue;
+        }
+        ss << "    __local ";
+        if (buf->type == Buffer::HALF) {
+            ss << "float";
+            if (buf->channels > 1) {
+                ss << buf->channels;
+            }
+        } else {
+            ss << _GetTypeStr(buf);
+        }
+        ss << " " << kernel.inBuffers[i].name
+           << "_tile[TILE + 2 * RADIUS][TILE + 2 * RADIUS];\n";
+    }
+    ss << "    const int lx = get_local_id(0);\n";
+    ss << "    const int ly = get_local_id(1);\n\n";
+    ss << "    // cooperative load, clamped to the image edges\n";
+    ss << "    for (int j = ly; j < TILE + 2 * RADIUS; j += TILE) {\n";
+    ss << "        for (int i = lx; i < TILE + 2 * RADIUS; i += TILE) {\n";
+    ss << "            const int gx = clamp(x - lx - RADIUS + i, 0, width - 1);\n";
+    ss << "            const int gy = clamp(y - ly - RADIUS + j, 0, height - 1);\n";
+    for(size_t i = 0; i < kernel.inBuffers.size(); ++i) {
+        Buffer::Ptr buf = buffers.find(kernel.inBuffers[i].buffer->name)->second;
+        if (buf->storage == Buffer::IMAGE) {
+            continue;
+        }
+        const std::string & name = kernel.inBuffers[i].name;
+        ss << "            " << name << "_tile[j][i] = ";
+        if (buf->type == Buffer::HALF) {
+            ss << "vload_half";
+            if (buf->channels > 1) {
+                ss << buf->channels;
+            }
+            ss << "(gx + width * gy, " << name << "_half);\n";
+        } else {
+            ss << name << "[gx + width * gy];\n";
+        }
+    }
+    ss << "        }\n";
+    ss << "    }\n";
+    ss << "    barrier(CLK_LOCAL_MEM_FENCE);\n\n";
+    return ss.str();
+}
+//----------------------------------------------------------------------------//
 std::string OpenCLImpl::BoilerplateCode(Kernel::Ptr kernel) const
 {
     std::stringstream ss;
@@ -259,6 +895,24 @@ std::string OpenCLImpl::BoilerplateCode(Kernel::Ptr kernel) const
     const std::string indent = ss.str();
     ss.str(""); //clears the sstream
     
+    // Image reads are clamped to the edges and use pixel coordinates
+    bool images = false;
+    for(size_t i = 0; i < kernel->inBuffers.size(); ++i) {
+        images = images || _buffers.find(kernel->inBuffers[i].buffer->name)
+                ->second->storage == Buffer::IMAGE;
+    }
+    if (images) {
+        ss << "__constant sampler_t sampler = CLK_NORMALIZED_COORDS_FALSE |\n"
+           << "                               CLK_ADDRESS_CLAMP_TO_EDGE |\n"
+           << "                               CLK_FILTER_NEAREST;\n\n";
+    }
+
+    // Stencil kernels are run in TILE x TILE work groups
+    if (kernel->radius > 0) {
+        ss << "#define RADIUS " << kernel->radius << "\n";
+        ss << "#define TILE " << GPUIP_TILE_SIZE << "\n\n";
+    }
+
     ss << "__kernel void\n" << kernel->name << "(";
 
     bool first = true;
@@ -267,6 +921,11 @@ std::string OpenCLImpl::BoilerplateCode(Kernel::Ptr kernel) const
         ss << (first ? "" : indent);
         first = false;
         const std::string & name = kernel->inBuffers[i].buffer->name;
+        if (_buffers.find(name)->second->storage == Buffer::IMAGE) {
+            ss << "__read_only image2d_t " << kernel->inBuffers[i].name
+               << "_image";
+            continue;
+        }
         ss << "__global const " << _GetTypeStr(_buffers.find(name)->second)
            << " * " << kernel->inBuffers[i].name
            << (_buffers.find(name)->second->type == Buffer::HALF ? "_half" : "");
@@ -275,6 +934,11 @@ std::string OpenCLImpl::BoilerplateCode(Kernel::Ptr kernel) const
         ss << (first ? "" : indent);
         first = false;
         const std::string & name = kernel->outBuffers[i].buffer->name;
+        if (_buffers.find(name)->second->storage == Buffer::IMAGE) {
+            ss << "__write_only image2d_t " << kernel->outBuffers[i].name
+               << "_image";
+            continue;
+        }
         ss << "__global " <<  _GetTypeStr(_buffers.find(name)->second)
            << " * " << kernel->outBuffers[i].name
            << (_buffers.find(name)->second->type == Buffer::HALF ? "_half" : "");
@@ -296,16 +960,42 @@ std::string OpenCLImpl::BoilerplateCode(Kernel::Ptr kernel) const
     ss << "    const int y = get_global_id(1);\n\n";
     ss << "    // array index\n";
     ss << "    const int idx = x + width * y;\n\n";
+
+    // All work items have to reach the barrier, so the tile is loaded
+    // before the bounds check
+    if (kernel->radius > 0) {
+        ss << _GetTileCode(*kernel.get(), _buffers);
+    }
+
     ss << "    // inside image bounds check\n";
     ss << "    if (x >= width || y >= height) {\n";
     ss << "        return;\n";
     ss << "    }\n\n";
 
+    // Read images (if needed)
+    bool firstImage = true;
+    for(size_t i = 0; i < kernel->inBuffers.size(); ++i) {
+        const std::string & bname = kernel->inBuffers[i].buffer->name;
+        if (_buffers.find(bname)->second->storage == Buffer::IMAGE) {
+            if (firstImage) {
+                ss << "    // image reads (neighbours are read the same way)\n";
+                firstImage = false;
+            }
+            ss << "    const float4 " << kernel->inBuffers[i].name
+               << " = read_imagef(" << kernel->inBuffers[i].name
+               << "_image, sampler, (int2)(x, y));\n";
+        }
+    }
+    if (!firstImage) {
+        ss << "\n";
+    }
+
     // Do half to float conversions (if needed)
     for(size_t i = 0; i < kernel->inBuffers.size(); ++i) {
         const std::string & bname = kernel->inBuffers[i].buffer->name;
         Buffer::Ptr buf = _buffers.find(bname)->second;
-        if (buf->type == Buffer::HALF) {
+        if (buf->type == Buffer::HALF && buf->storage != Buffer::IMAGE &&
+            kernel->radius == 0) {
             if (!i) {
                 ss << "    // half to float conversion\n";
             }
@@ -346,6 +1036,11 @@ std::string OpenCLImpl::BoilerplateCode(Kernel::Ptr kernel) const
         Buffer::Ptr b = _buffers.find(
             kernel->outBuffers[i].buffer->name)->second;
         ss << "    ";
+        if (b->storage == Buffer::IMAGE) {
+            ss << "float4 " << kernel->outBuffers[i].name
+               << " = (float4)(0, 0, 0, 0);\n";
+            continue;
+        }
         if (b->type == Buffer::HALF) {
             ss << "float" << b->channels << " ";
         }
@@ -371,11 +1066,26 @@ std::string OpenCLImpl::BoilerplateCode(Kernel::Ptr kernel) const
         }
     }
 
+    // Write images (if needed)
+    firstImage = true;
+    for(size_t i = 0; i < kernel->outBuffers.size(); ++i) {
+        const std::string & bname = kernel->outBuffers[i].buffer->name;
+        if (_buffers.find(bname)->second->storage == Buffer::IMAGE) {
+            if (firstImage) {
+                ss << "\n    // image writes\n";
+                firstImage = false;
+            }
+            ss << "    write_imagef(" << kernel->outBuffers[i].name
+               << "_image, (int2)(x, y), " << kernel->outBuffers[i].name
+               << ");\n";
+        }
+    }
+
     // Do half to float conversions (if needed)
     for(size_t i = 0; i < kernel->outBuffers.size(); ++i) {
         const std::string & bname = kernel->outBuffers[i].buffer->name;
         Buffer::Ptr buf = _buffers.find(bname)->second;
-        if (buf->type == Buffer::HALF) {
+        if (buf->type == Buffer::HALF && buf->storage != Buffer::IMAGE) {
             if (!i) {
                 ss << "\n    // float to half conversion\n";
             }
@@ -414,26 +1124,31 @@ std::string OpenCLImpl::BoilerplateCode(Kernel::Ptr kernel) const
 //----------------------------------------------------------------------------//
 bool OpenCLImpl::_ReleaseBuffers(std::string * err)
 {
-    std::map<std::string,  cl_mem>::iterator itb;
-    for(itb = _clBuffers.begin(); itb != _clBuffers.end(); ++itb) {
-        cl_int cl_err = clReleaseMemObject(itb->second);
-        if (_clErrorReleaseMemObject(cl_err, err)) {
-            return false;
+    for(size_t i = 0; i < _devices.size(); ++i) {
+        std::map<std::string,  cl_mem>::iterator itb;
+        for(itb = _devices[i].buffers.begin();
+            itb != _devices[i].buffers.end(); ++itb) {
+            cl_int cl_err = clReleaseMemObject(itb->second);
+            if (_clErrorReleaseMemObject(cl_err, err)) {
+                return false;
+            }
         }
+        _devices[i].buffers.clear();
     }
-    _clBuffers.clear();
     return true;
 }
 //----------------------------------------------------------------------------//
 bool OpenCLImpl::_ReleaseKernels(std::string * err)
 {
-    for(size_t i = 0; i < _clKernels.size(); ++i) {
-        cl_int cl_err = clReleaseKernel(_clKernels[i]);
-        if (_clErrorReleaseKernel(cl_err, err)) {
-            return false;
+    for(size_t i = 0; i < _devices.size(); ++i) {
+        for(size_t j = 0; j < _devices[i].kernels.size(); ++j) {
+            cl_int cl_err = clReleaseKernel(_devices[i].kernels[j]);
+            if (_clErrorReleaseKernel(cl_err, err)) {
+                return false;
+            }
         }
+        _devices[i].kernels.clear();
     }
-    _clKernels.clear();
     return true;
 }
 //----------------------------------------------------------------------------//
@@ -37,34 +37,71 @@ namespace gpuip {
 class OpenCLImpl : public ImageProcessor
 {
   public:
-    OpenCLImpl();
+    OpenCLImpl(const Device & device = Device());
+
+    OpenCLImpl(const std::vector<Device> & devices);
 
     virtual ~OpenCLImpl();
 
+    static std::vector<Device> ListDevices();
+
     virtual double Allocate(std::string * err);
     
     virtual double Build(std::string * err);
 
     virtual double Run(std::string * err);
 
-    virtual double Copy(Buffer::Ptr buffer,
-                        Buffer::CopyOperation op,
-                        void * data,
-                        std::string * err);
+    virtual double CopyRows(Buffer::Ptr buffer,
+                            Buffer::CopyOperation op,
+                            void * data,
+                            unsigned int y0,
+                            unsigned int y1,
+                            std::string * err);
+
+    virtual void * AllocateHostMemory(Buffer::Ptr buffer, std::string * err);
+
+    virtual bool FreeHostMemory(void * data, std::string * err);
 
     virtual std::string BoilerplateCode(Kernel::Ptr kernel) const;
     
   protected:
-    cl_device_id _device_id;
-    cl_context _ctx;
-    cl_command_queue _queue;
+    // Kernels and buffers live once per device. When running on several
+    // devices, each one outputs a horizontal band of rows of the image.
+    struct ClDevice
+    {
+        cl_device_id id;
+        cl_context ctx;
+        cl_command_queue queue;
+        std::vector<cl_kernel> kernels;
+        std::map<std::string, cl_mem> buffers;
 
-    std::vector<cl_kernel> _clKernels;
-    std::map<std::string, cl_mem> _clBuffers;
+        // Rows [y0, y1) of the image this device is responsible for
+        unsigned int y0;
+        unsigned int y1;
+
+        // Estimated speed from compute units and clock frequency, and the
+        // measured throughput (rows per ms) from the last run.
+        double speed;
+        double throughput;
+    };
+    std::vector<ClDevice> _devices;
+
+    // One context per platform, shared by all of its devices
+    std::vector<cl_context> _contexts;
+
+    // Pinned host memory, mapped from buffers in the first device's context
+    std::map<void *, cl_mem> _hostMemory;
 
   private:
+    void _CreateContexts(const std::vector<Device> & devices);
+
+    void _BalanceBands();
+
     bool _EnqueueKernel(const Kernel & kernel,
+                        const ClDevice & device,
                         const cl_kernel & clKernel,
+                        unsigned int y0,
+                        unsigned int y1,
                         cl_event & event,
                         std::string * err);
 
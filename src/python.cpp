@@ -34,6 +34,83 @@ namespace gpuip {
 //----------------------------------------------------------------------------//
 namespace python {
 //----------------------------------------------------------------------------//
+// Holds the memory of any object exposing the buffer protocol while a copy
+// reads from or writes to it.
+class BufferView
+{
+  public:
+    BufferView(bp::object obj, bool writable)
+    {
+        const int flags = writable ?
+                PyBUF_C_CONTIGUOUS | PyBUF_WRITABLE : PyBUF_C_CONTIGUOUS;
+        if (PyObject_GetBuffer(obj.ptr(), &_view, flags) != 0) {
+            bp::throw_error_already_set();
+        }
+    }
+
+    ~BufferView()
+    {
+        PyBuffer_Release(&_view);
+    }
+
+    void * data() const
+    {
+        return _view.buf;
+    }
+
+    size_t size() const
+    {
+        return _view.len;
+    }
+  private:
+    Py_buffer _view;
+
+    BufferView(const BufferView &);
+    void operator=(const BufferView &);
+};
+//----------------------------------------------------------------------------//
+// Owner of host memory from ImageProcessor::AllocateHostMemory. The numpy
+// arrays viewing the memory keep it, and the processor, alive.
+class HostMemory
+{
+  public:
+    HostMemory(gpuip::ImageProcessor::Ptr ip, void * data)
+            : _ip(ip), _data(data) {}
+
+    ~HostMemory()
+    {
+        std::string err;
+        if (!_ip->FreeHostMemory(_data, &err)) {
+            std::cerr << err << std::endl;
+        }
+    }
+  private:
+    gpuip::ImageProcessor::Ptr _ip;
+    void * _data;
+};
+//----------------------------------------------------------------------------//
+inline np::dtype _GetDtype(gpuip::Buffer::Type type)
+{
+    switch(type) {
+        case gpuip::Buffer::UNSIGNED_BYTE:
+            return np::dtype::get_builtin<unsigned char>();
+        case gpuip::Buffer::HALF:
+            return np::detail::get_float_dtype<16>();
+        case gpuip::Buffer::FLOAT:
+        default:
+            return np::detail::get_float_dtype<32>();
+    }
+}
+//----------------------------------------------------------------------------//
+std::vector<std::string> _ToStrings(bp::list l)
+{
+    std::vector<std::string> v;
+    for(int i = 0; i < bp::len(l); ++i) {
+        v.push_back(bp::extract<std::string>(l[i]));
+    }
+    return v;
+}
+//----------------------------------------------------------------------------//
 class BufferWrapper
 {
   public:
@@ -57,6 +134,16 @@ class BufferWrapper
     {
         return buffer->channels;
     }
+
+    gpuip::Buffer::Storage storage() const
+    {
+        return buffer->storage;
+    }
+
+    void SetStorage(gpuip::Buffer::Storage storage)
+    {
+        buffer->storage = storage;
+    }
     
     std::string Read(const std::string & filename)
     {
@@ -64,9 +151,17 @@ class BufferWrapper
     }
     
     std::string ReadMT(const std::string & filename, int numThreads)
+    {
+        return ReadChannels(filename, numThreads, bp::list());
+    }
+
+    std::string ReadChannels(const std::string & filename,
+                             int numThreads,
+                             bp::list channels)
     {
         std::string err;
-        gpuip::io::ReadFromFile(&data, *buffer.get(), filename, numThreads);
+        gpuip::io::ReadFromFile(&data, *buffer.get(), filename, &err,
+                                numThreads, _ToStrings(channels));
         return err;
     }
     
@@ -76,9 +171,26 @@ class BufferWrapper
     }
 
     std::string WriteMT(const std::string & filename, int numThreads)
+    {
+        return WriteChannels(filename, numThreads, bp::list());
+    }
+
+    std::string WriteChannels(const std::string & filename,
+                              int numThreads,
+                              bp::list channels)
+    {
+        return WriteOptions(filename, numThreads, channels,
+                            gpuip::io::ExrOptions());
+    }
+
+    std::string WriteOptions(const std::string & filename,
+                             int numThreads,
+                             bp::list channels,
+                             const gpuip::io::ExrOptions & options)
     {
         std::string err;
-        gpuip::io::WriteToFile(&data, *buffer.get(), filename, numThreads);
+        gpuip::io::WriteToFile(&data, *buffer.get(), filename, &err,
+                               numThreads, _ToStrings(channels), options);
         return err;
     }
     
@@ -138,6 +250,60 @@ class KernelWrapper : public gpuip::Kernel
     }
 };
 //----------------------------------------------------------------------------//
+// Execution time in milliseconds of the latest call to an ImageProcessor
+struct Timing
+{
+    Timing() : time(0) {}
+
+    bp::list Kernels() const
+    {
+        bp::list l;
+        for(size_t i = 0; i < kernels.size(); ++i) {
+            l.append(bp::make_tuple(kernels[i].first, kernels[i].second));
+        }
+        return l;
+    }
+
+    std::string operation;
+    double time;
+    std::vector<std::pair<std::string, double> > kernels;
+};
+//----------------------------------------------------------------------------//
+// Cumulative counters of an ImageProcessor, times in milliseconds
+struct Stats
+{
+    Stats()
+            : allocations(0), builds(0), runs(0), uploads(0), downloads(0),
+              errors(0), allocateTime(0), buildTime(0), runTime(0),
+              uploadTime(0), downloadTime(0), bytesUploaded(0),
+              bytesDownloaded(0) {}
+
+    bp::dict KernelTimes() const
+    {
+        bp::dict d;
+        std::map<std::string, double>::const_iterator it;
+        for(it = kernelTimes.begin(); it != kernelTimes.end(); ++it) {
+            d[it->first] = it->second;
+        }
+        return d;
+    }
+
+    unsigned int allocations;
+    unsigned int builds;
+    unsigned int runs;
+    unsigned int uploads;
+    unsigned int downloads;
+    unsigned int errors;
+    double allocateTime;
+    double buildTime;
+    double runTime;
+    double uploadTime;
+    double downloadTime;
+    double bytesUploaded;
+    double bytesDownloaded;
+    std::map<std::string, double> kernelTimes;
+};
+//----------------------------------------------------------------------------//
 class ImageProcessorWrapper
 {
   public:
@@ -149,9 +315,32 @@ class ImageProcessorWrapper
         }
     }
 
+    ImageProcessorWrapper(gpuip::GpuEnvironment env,
+                          const gpuip::Device & device)
+            : _ip(gpuip::ImageProcessor::Create(env, device))
+    {
+        if (_ip.get() ==  NULL) {
+            throw std::runtime_error("Could not create gpuip imageProcessor.");
+        }
+    }
+
+    ImageProcessorWrapper(gpuip::GpuEnvironment env, bp::list devices)
+            : _ip(gpuip::ImageProcessor::Create(env, _ToDevices(devices)))
+    {
+        if (_ip.get() ==  NULL) {
+            throw std::runtime_error("Could not create gpuip imageProcessor.");
+        }
+    }
+
+    ImageProcessorWrapper(gpuip::GLSLShader shader)
+            : _ip(gpuip::ImageProcessor::CreateGLSL(shader))
+    {
+    }
+
     boost::shared_ptr<KernelWrapper> CreateKernel(const std::string & name)
     {
         gpuip::Kernel::Ptr ptr = _ip->CreateKernel(name);
+        _kernelNames.push_back(name);
         // safe since KernelWrapper doesnt hold any extra data
         return boost::static_pointer_cast<KernelWrapper>(ptr);
     }
@@ -183,39 +372,168 @@ class ImageProcessorWrapper
     std::string Allocate()
     {
         std::string err;
-        _ip->Allocate(&err);
+        double time;
+        {
+            gpuip::io::ScopedGILRelease release;
+            time = _ip->Allocate(&err);
+        }
+        _Record("Allocate", time, _stats.allocations, _stats.allocateTime);
         return err;
     }
 
     std::string Build()
     {
         std::string err;
-        _ip->Build(&err);
+        double time;
+        {
+            gpuip::io::ScopedGILRelease release;
+            time = _ip->Build(&err);
+        }
+        _Record("Build", time, _stats.builds, _stats.buildTime);
         return err;
     }
 
     std::string Run()
     {
         std::string err;
-        _ip->Run(&err);
+        double time;
+        {
+            gpuip::io::ScopedGILRelease release;
+            time = _ip->Run(&err);
+        }
+        _Record("Run", time, _stats.runs, _stats.runTime);
+        if (time != GPUIP_ERROR) {
+            const std::vector<double> & times = _ip->KernelTimes();
+            for(size_t i = 0; i < times.size(); ++i) {
+                _timing.kernels.push_back(
+                    std::make_pair(_kernelNames[i], times[i]));
+                _stats.kernelTimes[_kernelNames[i]] += times[i];
+            }
+        }
         return err;
     }
 
-    std::string ReadBufferFromGPU(boost::shared_ptr<BufferWrapper> buffer)
+    void SetTiming(bool enabled)
+    {
+        _ip->SetTiming(enabled);
+    }
+
+    std::string Finish()
     {
         std::string err;
-        _ip->Copy(buffer->buffer, gpuip::Buffer::COPY_FROM_GPU,
-                    buffer->data.get_data(), &err);
+        gpuip::io::ScopedGILRelease release;
+        _ip->Finish(&err);
         return err;
     }
 
+    Timing LastTiming() const
+    {
+        return _timing;
+    }
+
+    Stats GetStats() const
+    {
+        return _stats;
+    }
+
+    bp::list KernelReports() const
+    {
+        const std::vector<gpuip::KernelReport> reports = _ip->KernelReports();
+        bp::list l;
+        for(size_t i = 0; i < reports.size(); ++i) {
+            l.append(reports[i]);
+        }
+        return l;
+    }
+
+    double PeakBandwidth() const
+    {
+        return _ip->PeakBandwidth();
+    }
+
+    void ResetStats()
+    {
+        _stats = Stats();
+    }
+
+    std::string ReadBufferFromGPU(boost::shared_ptr<BufferWrapper> buffer)
+    {
+        return ReadBufferFromGPUTo(buffer, buffer->data);
+    }
+
+    std::string ReadBufferFromGPUTo(boost::shared_ptr<BufferWrapper> buffer,
+                                    bp::object data)
+    {
+        return _Copy(buffer, gpuip::Buffer::COPY_FROM_GPU, data);
+    }
+
     std::string WriteBufferToGPU(boost::shared_ptr<BufferWrapper> buffer)
+    {
+        return WriteBufferToGPUFrom(buffer, buffer->data);
+    }
+
+    std::string WriteBufferToGPUFrom(boost::shared_ptr<BufferWrapper> buffer,
+                                     bp::object data)
+    {
+        return _Copy(buffer, gpuip::Buffer::COPY_TO_GPU, data);
+    }
+
+    std::string StreamBufferToGPU(boost::shared_ptr<BufferWrapper> buffer,
+                                  const std::string & filename)
+    {
+        return StreamBufferToGPUMT(buffer, filename, 0);
+    }
+
+    std::string StreamBufferToGPUMT(boost::shared_ptr<BufferWrapper> buffer,
+                                    const std::string & filename,
+                                    int numThreads)
+    {
+        return StreamBufferToGPUChannels(buffer, filename, numThreads,
+                                         bp::list());
+    }
+
+    std::string StreamBufferToGPUChannels(
+        boost::shared_ptr<BufferWrapper> buffer,
+        const std::string & filename,
+        int numThreads,
+        bp::list channels)
     {
         std::string err;
-        _ip->Copy(buffer->buffer, gpuip::Buffer::COPY_TO_GPU,
-                    buffer->data.get_data(), &err);
+        const std::vector<std::string> names = _ToStrings(channels);
+        double time;
+        {
+            gpuip::io::ScopedGILRelease release;
+            time = gpuip::io::StreamToGPU(*_ip, buffer->buffer, filename, &err,
+                                          numThreads, names);
+        }
+        _Record("StreamBufferToGPU", time, _stats.uploads, _stats.uploadTime);
+        if (time != GPUIP_ERROR) {
+            _stats.bytesUploaded += _BytesPerChannel(buffer->buffer) *
+                    buffer->buffer->channels * _ip->Width() * _ip->Height();
+        }
         return err;
     }
+
+    np::ndarray AllocateHostMemory(boost::shared_ptr<BufferWrapper> buffer)
+    {
+        std::string err;
+        void * data = _ip->AllocateHostMemory(buffer->buffer, &err);
+        if (data == NULL) {
+            throw std::runtime_error(err);
+        }
+        bp::object owner(boost::shared_ptr<HostMemory>(
+            new HostMemory(_ip, data)));
+
+        // Same (width, height, channels) layout as Buffer.Read gives
+        const size_t bpc = _BytesPerChannel(buffer->buffer);
+        const unsigned int channels = buffer->buffer->channels;
+        return np::from_data(
+            data, _GetDtype(buffer->buffer->type),
+            bp::make_tuple(_ip->Width(), _ip->Height(), channels),
+            bp::make_tuple(_ip->Height() * channels * bpc,
+                           channels * bpc, bpc),
+            owner);
+    }
     
     std::string BoilerplateCode(boost::shared_ptr<KernelWrapper> k) const
     {
@@ -223,8 +541,92 @@ class ImageProcessorWrapper
     }
   private:
     gpuip::ImageProcessor::Ptr _ip;
+    std::vector<std::string> _kernelNames; // in the order of KernelTimes
+    Timing _timing;
+    Stats _stats;
+
+    void _Record(const std::string & operation, double time,
+                 unsigned int & calls, double & totalTime)
+    {
+        _timing = Timing();
+        _timing.operation = operation;
+        if (time == GPUIP_ERROR) {
+            ++_stats.errors;
+            return;
+        }
+        _timing.time = time;
+        ++calls;
+        totalTime += time;
+    }
+
+    // Copies straight to or from the memory of data, without a temporary
+    std::string _Copy(boost::shared_ptr<BufferWrapper> buffer,
+                      gpuip::Buffer::CopyOperation op,
+                      bp::object data)
+    {
+        std::string err;
+        BufferView view(data, op == gpuip::Buffer::COPY_FROM_GPU);
+        const size_t size = _BytesPerChannel(buffer->buffer) *
+                buffer->buffer->channels * _ip->Width() * _ip->Height();
+        if (view.size() != size) {
+            std::stringstream ss;
+            ss << "Buffer " << buffer->buffer->name << " needs " << size
+               << " bytes of data but got " << view.size() << "\n";
+            ++_stats.errors;
+            return ss.str();
+        }
+        // The view keeps the memory alive while the GIL is released
+        double time;
+        {
+            gpuip::io::ScopedGILRelease release;
+            time = _ip->Copy(buffer->buffer, op, view.data(), &err);
+        }
+        if (op == gpuip::Buffer::COPY_FROM_GPU) {
+            _Record("ReadBufferFromGPU", time,
+                    _stats.downloads, _stats.downloadTime);
+            _stats.bytesDownloaded += time != GPUIP_ERROR ? size : 0;
+        } else {
+            _Record("WriteBufferToGPU", time,
+                    _stats.uploads, _stats.uploadTime);
+            _stats.bytesUploaded += time != GPUIP_ERROR ? size : 0;
+        }
+        return err;
+    }
+
+    static size_t _BytesPerChannel(gpuip::Buffer::Ptr buffer)
+    {
+        switch(buffer->type) {
+            case gpuip::Buffer::UNSIGNED_BYTE:
+                return 1;
+            case gpuip::Buffer::HALF:
+                return 2;
+            case gpuip::Buffer::FLOAT:
+            default:
+                return 4;
+        }
+    }
+
+    static std::vector<gpuip::Device> _ToDevices(bp::list devices)
+    {
+        std::vector<gpuip::Device> v;
+        for(int i = 0; i < bp::len(devices); ++i) {
+            v.push_back(bp::extract<gpuip::Device>(devices[i]));
+        }
+        return v;
+    }
 };
 //----------------------------------------------------------------------------//
+bp::list ListDevices(gpuip::GpuEnvironment env)
+{
+    const std::vector<gpuip::Device> devices =
+            gpuip::ImageProcessor::ListDevices(env);
+    bp::list l;
+    for(size_t i = 0; i < devices.size(); ++i) {
+        l.append(devices[i]);
+    }
+    return l;
+}
+//----------------------------------------------------------------------------//
 } //end namespace python
 //----------------------------------------------------------------------------//
 } //end namespace gpuip
@@ -234,6 +636,9 @@ BOOST_PYTHON_MODULE(pygpuip)
     namespace gp = gpuip::python;
 
     np::initialize();
+#if PY_VERSION_HEX < 0x03070000
+    PyEval_InitThreads(); // needed to release the GIL
+#endif
 
     bp::enum_<gpuip::GpuEnvironment>("Environment")
             .value("OpenCL", gpuip::OpenCL)
@@ -245,17 +650,91 @@ BOOST_PYTHON_MODULE(pygpuip)
             .value("HALF", gpuip::Buffer::HALF)
             .value("FLOAT", gpuip::Buffer::FLOAT);
 
+    bp::enum_<gpuip::GLSLShader>("GLSLShader")
+            .value("FRAGMENT_SHADER", gpuip::FRAGMENT_SHADER)
+            .value("COMPUTE_SHADER", gpuip::COMPUTE_SHADER);
+
+    bp::enum_<gpuip::Buffer::Storage>("BufferStorage")
+            .value("LINEAR", gpuip::Buffer::LINEAR)
+            .value("IMAGE", gpuip::Buffer::IMAGE);
+
+    bp::enum_<gpuip::Device::Type>("DeviceType")
+            .value("GPU", gpuip::Device::GPU)
+            .value("CPU", gpuip::Device::CPU)
+            .value("ACCELERATOR", gpuip::Device::ACCELERATOR)
+            .value("ALL", gpuip::Device::ALL);
+
+    bp::class_<gpuip::Device>
+            ("Device", bp::init<bp::optional<gpuip::Device::Type, int, int> >())
+            .def_readwrite("type", &gpuip::Device::type)
+            .def_readwrite("index", &gpuip::Device::index)
+            .def_readwrite("platform", &gpuip::Device::platform)
+            .def_readonly("name", &gpuip::Device::name)
+            .def_readonly("platformName", &gpuip::Device::platformName);
+    bp::scope().attr("FASTEST_DEVICE") = GPUIP_FASTEST_DEVICE;
+    bp::scope().attr("ANY_PLATFORM") = GPUIP_ANY_PLATFORM;
+
+    bp::enum_<gpuip::io::ExrCompression>("ExrCompression")
+            .value("NONE", gpuip::io::EXR_NONE)
+            .value("RLE", gpuip::io::EXR_RLE)
+            .value("ZIPS", gpuip::io::EXR_ZIPS)
+            .value("ZIP", gpuip::io::EXR_ZIP)
+            .value("PIZ", gpuip::io::EXR_PIZ)
+            .value("PXR24", gpuip::io::EXR_PXR24)
+            .value("B44", gpuip::io::EXR_B44)
+            .value("B44A", gpuip::io::EXR_B44A)
+            .value("DWAA", gpuip::io::EXR_DWAA)
+            .value("DWAB", gpuip::io::EXR_DWAB);
+
+    bp::enum_<gpuip::io::ExrLineOrder>("ExrLineOrder")
+            .value("INCREASING_Y", gpuip::io::EXR_INCREASING_Y)
+            .value("DECREASING_Y", gpuip::io::EXR_DECREASING_Y);
+
+    bp::class_<gpuip::io::ExrOptions>("ExrOptions")
+            .def_readwrite("compression", &gpuip::io::ExrOptions::compression)
+            .def_readwrite("lineOrder", &gpuip::io::ExrOptions::lineOrder)
+            .def_readwrite("chunkRows", &gpuip::io::ExrOptions::chunkRows);
+
     bp::class_<gp::BufferWrapper, boost::shared_ptr<gp::BufferWrapper> >
             ("Buffer", bp::no_init)
             .add_property("name", &gp::BufferWrapper::name)
             .add_property("type", &gp::BufferWrapper::type)
             .add_property("channels", &gp::BufferWrapper::channels) 
+            .add_property("storage", &gp::BufferWrapper::storage,
+                          &gp::BufferWrapper::SetStorage)
             .def_readwrite("data", &gp::BufferWrapper::data)
             .def("Read", &gp::BufferWrapper::Read)
             .def("Read", &gp::BufferWrapper::ReadMT)
+            .def("Read", &gp::BufferWrapper::ReadChannels)
             .def("Write", &gp::BufferWrapper::Write)
-            .def("Write", &gp::BufferWrapper::WriteMT);
+            .def("Write", &gp::BufferWrapper::WriteMT)
+            .def("Write", &gp::BufferWrapper::WriteChannels)
+            .def("Write", &gp::BufferWrapper::WriteOptions);
     
+    bp::class_<gp::Timing>("Timing", bp::no_init)
+            .def_readonly("operation", &gp::Timing::operation)
+            .def_readonly("time", &gp::Timing::time)
+            .add_property("kernels", &gp::Timing::Kernels);
+
+    bp::class_<gp::Stats>("Stats", bp::no_init)
+            .def_readonly("allocations", &gp::Stats::allocations)
+            .def_readonly("builds", &gp::Stats::builds)
+            .def_readonly("runs", &gp::Stats::runs)
+            .def_readonly("uploads", &gp::Stats::uploads)
+            .def_readonly("downloads", &gp::Stats::downloads)
+            .def_readonly("errors", &gp::Stats::errors)
+            .def_readonly("allocateTime", &gp::Stats::allocateTime)
+            .def_readonly("buildTime", &gp::Stats::buildTime)
+            .def_readonly("runTime", &gp::Stats::runTime)
+            .def_readonly("uploadTime", &gp::Stats::uploadTime)
+            .def_readonly("downloadTime", &gp::Stats::downloadTime)
+            .def_readonly("bytesUploaded", &gp::Stats::bytesUploaded)
+            .def_readonly("bytesDownloaded", &gp::Stats::bytesDownloaded)
+            .add_property("kernelTimes", &gp::Stats::KernelTimes);
+
+    bp::class_<gp::HostMemory, boost::shared_ptr<gp::HostMemory>,
+            boost::noncopyable>("HostMemory", bp::no_init);
+
     bp::class_<gpuip::Parameter<int> >
             ("ParamInt",bp::init<std::string, int>())
             .def_readonly("name", &gpuip::Parameter<int>::name)
@@ -270,15 +749,30 @@ BOOST_PYTHON_MODULE(pygpuip)
             ("Kernel", bp::no_init)
             .def_readonly("name", &gp::KernelWrapper::name)
             .def_readwrite("code", &gp::KernelWrapper::code)
+            .def_readwrite("radius", &gp::KernelWrapper::radius)
+            .def_readwrite("flopsPerPixel", &gp::KernelWrapper::flopsPerPixel)
             .def("SetInBuffer", &gp::KernelWrapper::SetInBuffer)
             .def("SetOutBuffer", &gp::KernelWrapper::SetOutBuffer)
             .def("SetParam", &gp::KernelWrapper::SetParamInt)
             .def("SetParam", &gp::KernelWrapper::SetParamFloat);
     
+    bp::class_<gpuip::KernelReport>("KernelReport", bp::no_init)
+            .def_readonly("name", &gpuip::KernelReport::name)
+            .def_readonly("bytesRead", &gpuip::KernelReport::bytesRead)
+            .def_readonly("bytesWritten", &gpuip::KernelReport::bytesWritten)
+            .def_readonly("flops", &gpuip::KernelReport::flops)
+            .def_readonly("time", &gpuip::KernelReport::time)
+            .add_property("bandwidth", &gpuip::KernelReport::Bandwidth)
+            .add_property("flopRate", &gpuip::KernelReport::FlopRate)
+            .add_property("intensity", &gpuip::KernelReport::Intensity);
+
     bp::class_<gp::ImageProcessorWrapper,
             boost::shared_ptr<gp::ImageProcessorWrapper> >
             ("ImageProcessor",
              bp::init<gpuip::GpuEnvironment>())
+            .def(bp::init<gpuip::GpuEnvironment, gpuip::Device>())
+            .def(bp::init<gpuip::GpuEnvironment, bp::list>())
+            .def(bp::init<gpuip::GLSLShader>())
             .def("SetDimensions", &gp::ImageProcessorWrapper::SetDimensions)
             .add_property("width", &gp::ImageProcessorWrapper::Width)
             .add_property("height", &gp::ImageProcessorWrapper::Height)
@@ -289,12 +783,35 @@ BOOST_PYTHON_MODULE(pygpuip)
             .def("Run", &gp::ImageProcessorWrapper::Run)
             .def("ReadBufferFromGPU",
                  &gp::ImageProcessorWrapper::ReadBufferFromGPU)
+            .def("ReadBufferFromGPU",
+                 &gp::ImageProcessorWrapper::ReadBufferFromGPUTo)
             .def("WriteBufferToGPU",
                  &gp::ImageProcessorWrapper::WriteBufferToGPU)
+            .def("WriteBufferToGPU",
+                 &gp::ImageProcessorWrapper::WriteBufferToGPUFrom)
+            .def("StreamBufferToGPU",
+                 &gp::ImageProcessorWrapper::StreamBufferToGPU)
+            .def("StreamBufferToGPU",
+                 &gp::ImageProcessorWrapper::StreamBufferToGPUMT)
+            .def("StreamBufferToGPU",
+                 &gp::ImageProcessorWrapper::StreamBufferToGPUChannels)
+            .def("AllocateHostMemory",
+                 &gp::ImageProcessorWrapper::AllocateHostMemory)
             .def("BoilerplateCode",
-                 &gp::ImageProcessorWrapper::BoilerplateCode);
+                 &gp::ImageProcessorWrapper::BoilerplateCode)
+            .def("SetTiming", &gp::ImageProcessorWrapper::SetTiming)
+            .def("Finish", &gp::ImageProcessorWrapper::Finish)
+            .add_property("timing", &gp::ImageProcessorWrapper::LastTiming)
+            .add_property("stats", &gp::ImageProcessorWrapper::GetStats)
+            .def("ResetStats", &gp::ImageProcessorWrapper::ResetStats)
+            .def("KernelReports", &gp::ImageProcessorWrapper::KernelReports)
+            .def("PeakBandwidth", &gp::ImageProcessorWrapper::PeakBandwidth);
 
     bp::def("CanCreateGpuEnvironment",&gpuip::ImageProcessor::CanCreate);
+
+    bp::def("ListDevices", &gp::ListDevices);
+
+    bp::def("DefaultDevice", &gpuip::ImageProcessor::DefaultDevice);
     
     std::stringstream ss;
 #ifdef GPUIP_VERSION
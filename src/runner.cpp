@@ -0,0 +1,461 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Per Karlsson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "runner.h"
+#include "gpuip_io.h"
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#ifdef _WIN32
+#include <direct.h>
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+//----------------------------------------------------------------------------//
+namespace gpuip {
+//----------------------------------------------------------------------------//
+double Now()
+{
+#ifdef _WIN32
+    return GetTickCount();
+#else
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+#endif
+}
+//----------------------------------------------------------------------------//
+int NumCores()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? cores : 1;
+#endif
+}
+//----------------------------------------------------------------------------//
+void MakeDirs(const std::string & path)
+{
+    for(size_t i = path.find_first_of("/\\", 1); i != std::string::npos;
+        i = path.find_first_of("/\\", i + 1)) {
+        const std::string dir = path.substr(0, i);
+#ifdef _WIN32
+        _mkdir(dir.c_str());
+#else
+        mkdir(dir.c_str(), 0777);
+#endif
+    }
+}
+//----------------------------------------------------------------------------//
+std::string FramePath(const std::string & path, int frame)
+{
+    size_t begin = path.find('#');
+    size_t end = begin;
+    unsigned int width = 0;
+    if (begin != std::string::npos) {
+        end = path.find_first_not_of('#', begin);
+        end = end == std::string::npos ? path.size() : end;
+        width = end - begin;
+    } else {
+        begin = path.find('%');
+        if (begin == std::string::npos) {
+            return path;
+        }
+        end = path.find_first_not_of("0123456789", begin + 1);
+        if (end == std::string::npos || path[end] != 'd') {
+            return path;
+        }
+        width = std::atoi(path.substr(begin + 1, end - begin - 1).c_str());
+        ++end;
+    }
+    std::stringstream ss;
+    ss.fill('0');
+    ss.setf(std::ios::internal, std::ios::adjustfield); // -003, not 00-3
+    ss.width(width);
+    ss << frame;
+    return path.substr(0, begin) + ss.str() + path.substr(end);
+}
+//----------------------------------------------------------------------------//
+bool ParseFrames(const std::string & frames,
+                 std::vector<int> * out,
+                 std::string * error)
+{
+    out->clear();
+    if (frames.empty()) {
+        out->push_back(0);
+        return true;
+    }
+    // The dash of the range is searched after the first character so that
+    // the first frame may be negative
+    const size_t dash = frames.find('-', 1);
+    const int first = std::atoi(frames.c_str());
+    const int last = dash == std::string::npos ?
+            first : std::atoi(frames.c_str() + dash + 1);
+    if (last < first) {
+        (*error) += "gpuip error: empty frame range " + frames + "\n";
+        return false;
+    }
+    for(int f = first; f <= last; ++f) {
+        out->push_back(f);
+    }
+    return true;
+}
+//----------------------------------------------------------------------------//
+template<typename T>
+inline bool _SetParam(std::vector<Parameter<T> > & params,
+                      const std::string & name,
+                      double value)
+{
+    for(size_t i = 0; i < params.size(); ++i) {
+        if (params[i].name == name) {
+            params[i].value = (T)value;
+            return true;
+        }
+    }
+    return false;
+}
+//----------------------------------------------------------------------------//
+inline const std::string & _Path(const std::map<std::string, std::string> & m,
+                                 const std::string & name,
+                                 const std::string & defaultPath)
+{
+    std::map<std::string, std::string>::const_iterator it = m.find(name);
+    return it == m.end() ? defaultPath : it->second;
+}
+//----------------------------------------------------------------------------//
+template<typename T>
+inline bool _CheckBuffers(Settings & settings,
+                          const std::map<std::string, T> & m,
+                          std::string * error)
+{
+    typename std::map<std::string, T>::const_iterator it;
+    for(it = m.begin(); it != m.end(); ++it) {
+        if (!settings.GetBuffer(it->first)) {
+            (*error) += "gpuip error: No buffer " + it->first + " found.\n";
+            return false;
+        }
+    }
+    return true;
+}
+//----------------------------------------------------------------------------//
+// Owns the readers of the inputs of one job
+struct _Readers
+{
+    ~_Readers()
+    {
+        for(size_t i = 0; i < readers.size(); ++i) {
+            delete readers[i];
+        }
+    }
+    std::vector<io::ImageReader *> readers;
+};
+//----------------------------------------------------------------------------//
+Runner::Frame::Frame() : width(0), height(0)
+{
+}
+//----------------------------------------------------------------------------//
+Runner::Runner() : _width(0), _height(0), _threads(1), _deviceTime(0)
+{
+}
+//----------------------------------------------------------------------------//
+Runner::~Runner()
+{
+    _FreeHostMemory();
+}
+//----------------------------------------------------------------------------//
+bool Runner::Init(const std::string & filename,
+                  int threads,
+                  std::string * error)
+{
+    if (!_settings.Read(filename, error)) {
+        return false;
+    }
+    _threads = threads > 0 ? threads : NumCores();
+
+    std::map<std::string, Buffer::Ptr> buffers;
+    _ip = _settings.Create(&buffers, &_kernels, error);
+    if (!_ip.get()) {
+        return false;
+    }
+    for(size_t i = 0; i < _settings.buffers.size(); ++i) {
+        _buffers.push_back(buffers[_settings.buffers[i].name]);
+    }
+    return _ip->Build(error) != GPUIP_ERROR;
+}
+//----------------------------------------------------------------------------//
+double Runner::Run(const Job & job, std::string * error)
+{
+    const double start = Now();
+    if (!_Start(job.params, error) ||
+        !_CheckBuffers(_settings, job.inputs, error) ||
+        !_CheckBuffers(_settings, job.outputs, error)) {
+        return GPUIP_ERROR;
+    }
+
+    // The inputs set the size of the buffers. Exr files only decode their
+    // header here.
+    _Readers in;
+    in.readers.resize(_buffers.size(), (io::ImageReader *)NULL);
+    unsigned int width = 0, height = 0;
+    for(size_t i = 0; i < _buffers.size(); ++i) {
+        const std::string & path = _Path(job.inputs, _buffers[i]->name,
+                                         _settings.buffers[i].input);
+        if (path.empty()) {
+            continue;
+        }
+        in.readers[i] = new io::ImageReader;
+        if (!in.readers[i]->Open(path, error, _threads)) {
+            return GPUIP_ERROR;
+        }
+        const io::ImageReader & reader = *in.readers[i];
+        if (width == 0) {
+            width = reader.Width();
+            height = reader.Height();
+        } else if (reader.Width() != width || reader.Height() != height) {
+            std::stringstream ss;
+            ss << "gpuip error: " << path << " is " << reader.Width() << "x"
+               << reader.Height() << " but the images are " << width << "x"
+               << height << "\n";
+            (*error) += ss.str();
+            return GPUIP_ERROR;
+        }
+    }
+    if (width == 0 || height == 0) {
+        (*error) += "gpuip error: The job has no input images\n";
+        return GPUIP_ERROR;
+    }
+    if ((width != _width || height != _height) &&
+        !_Resize(width, height, error)) {
+        return GPUIP_ERROR;
+    }
+    if (_host.empty()) {
+        _host.resize(_buffers.size(), (void *)NULL);
+        for(size_t i = 0; i < _buffers.size(); ++i) {
+            _host[i] = _ip->AllocateHostMemory(_buffers[i], error);
+            if (_host[i] == NULL) {
+                _FreeHostMemory();
+                return GPUIP_ERROR;
+            }
+        }
+    }
+
+    double time = 0;
+    for(size_t i = 0; i < _buffers.size(); ++i) {
+        if (!in.readers[i]) {
+            continue;
+        }
+        if (!in.readers[i]->Read(_host[i], _buffers[i]->type,
+                                 _buffers[i]->channels, error)) {
+            return GPUIP_ERROR;
+        }
+        time = _ip->Copy(_buffers[i], Buffer::COPY_TO_GPU, _host[i], error);
+        if (time == GPUIP_ERROR) {
+            return GPUIP_ERROR;
+        }
+        _deviceTime += time;
+    }
+
+    time = _ip->Run(error);
+    if (time == GPUIP_ERROR) {
+        return GPUIP_ERROR;
+    }
+    _deviceTime += time;
+
+    for(size_t i = 0; i < _buffers.size(); ++i) {
+        const Settings::Buffer & b = _settings.buffers[i];
+        const std::string & path = _Path(job.outputs, b.name, b.output);
+        if (path.empty()) {
+            continue;
+        }
+        time = _ip->Copy(_buffers[i], Buffer::COPY_FROM_GPU, _host[i], error);
+        if (time == GPUIP_ERROR) {
+            return GPUIP_ERROR;
+        }
+        _deviceTime += time;
+        MakeDirs(path);
+        if (!io::WriteImage(_host[i], _buffers[i]->type, _buffers[i]->channels,
+                            _width, _height, path, error, _threads,
+                            std::vector<std::string>(), b.exrOptions)) {
+            return GPUIP_ERROR;
+        }
+    }
+    return Now() - start;
+}
+//----------------------------------------------------------------------------//
+double Runner::Run(const Frame & frame, std::string * error)
+{
+    const double start = Now();
+    if (!_Start(frame.params, error) ||
+        !_CheckBuffers(_settings, frame.inputs, error) ||
+        !_CheckBuffers(_settings, frame.outputs, error)) {
+        return GPUIP_ERROR;
+    }
+    if (frame.width == 0 || frame.height == 0 || frame.inputs.empty()) {
+        (*error) += "gpuip error: The frame has no input images\n";
+        return GPUIP_ERROR;
+    }
+    if ((frame.width != _width || frame.height != _height) &&
+        !_Resize(frame.width, frame.height, error)) {
+        return GPUIP_ERROR;
+    }
+
+    std::map<std::string, void *>::const_iterator it;
+    double time;
+    for(size_t i = 0; i < _buffers.size(); ++i) {
+        it = frame.inputs.find(_buffers[i]->name);
+        if (it == frame.inputs.end()) {
+            continue;
+        }
+        time = _ip->Copy(_buffers[i], Buffer::COPY_TO_GPU, it->second, error);
+        if (time == GPUIP_ERROR) {
+            return GPUIP_ERROR;
+        }
+        _deviceTime += time;
+    }
+
+    time = _ip->Run(error);
+    if (time == GPUIP_ERROR) {
+        return GPUIP_ERROR;
+    }
+    _deviceTime += time;
+
+    for(size_t i = 0; i < _buffers.size(); ++i) {
+        it = frame.outputs.find(_buffers[i]->name);
+        if (it == frame.outputs.end()) {
+            continue;
+        }
+        time = _ip->Copy(_buffers[i], Buffer::COPY_FROM_GPU, it->second,
+                         error);
+        if (time == GPUIP_ERROR) {
+            return GPUIP_ERROR;
+        }
+        _deviceTime += time;
+    }
+    return Now() - start;
+}
+//----------------------------------------------------------------------------//
+bool Runner::RegisterHostMemory(void * data,
+                                size_t bytes,
+                                std::string * error)
+{
+    return _ip.get() && _ip->RegisterHostMemory(data, bytes, error);
+}
+//----------------------------------------------------------------------------//
+bool Runner::UnregisterHostMemory(void * data, std::string * error)
+{
+    return _ip.get() && _ip->UnregisterHostMemory(data, error);
+}
+//----------------------------------------------------------------------------//
+const Settings & Runner::GetSettings() const
+{
+    return _settings;
+}
+//----------------------------------------------------------------------------//
+Buffer::Ptr Runner::GetBuffer(const std::string & name) const
+{
+    for(size_t i = 0; i < _buffers.size(); ++i) {
+        if (_buffers[i]->name == name) {
+            return _buffers[i];
+        }
+    }
+    return Buffer::Ptr();
+}
+//----------------------------------------------------------------------------//
+double Runner::DeviceTime() const
+{
+    return _deviceTime;
+}
+//----------------------------------------------------------------------------//
+bool Runner::_Start(const std::vector<std::vector<std::string> > & params,
+                    std::string * error)
+{
+    _deviceTime = 0;
+    if (!_ip.get()) {
+        (*error) += "gpuip error: Runner is not initialized\n";
+        return false;
+    }
+    // Values of earlier jobs are reset to the ones of the *.ip file
+    _settings.SetParams(_kernels);
+    for(size_t i = 0; i < params.size(); ++i) {
+        const std::vector<std::string> & p = params[i];
+        if (p.size() != 3) {
+            (*error) += "gpuip error: A param needs kernel, name and value\n";
+            return false;
+        }
+        Kernel * kernel = NULL;
+        for(size_t j = 0; j < _kernels.size(); ++j) {
+            if (_kernels[j]->name == p[0]) {
+                kernel = _kernels[j].get();
+            }
+        }
+        if (!kernel) {
+            (*error) += "gpuip error: No kernel " + p[0] + " found.\n";
+            return false;
+        }
+        const double value = std::atof(p[2].c_str());
+        if (!_SetParam(kernel->paramsFloat, p[1], value) &&
+            !_SetParam(kernel->paramsInt, p[1], value)) {
+            (*error) += "gpuip error: No param " + p[1] + " found in kernel " +
+                    p[0] + ".\n";
+            return false;
+        }
+    }
+    return true;
+}
+//----------------------------------------------------------------------------//
+bool Runner::_Resize(unsigned int width,
+                     unsigned int height,
+                     std::string * error)
+{
+    _FreeHostMemory();
+    _width = _height = 0;
+    _ip->SetDimensions(width, height);
+    if (_ip->Allocate(error) == GPUIP_ERROR) {
+        return false;
+    }
+    _width = width;
+    _height = height;
+    return true;
+}
+//----------------------------------------------------------------------------//
+void Runner::_FreeHostMemory()
+{
+    std::string err;
+    for(size_t i = 0; i < _host.size(); ++i) {
+        if (_host[i]) {
+            _ip->FreeHostMemory(_host[i], &err);
+        }
+    }
+    _host.clear();
+}
+//----------------------------------------------------------------------------//
+} // end namespace gpuip
+//----------------------------------------------------------------------------//
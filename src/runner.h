@@ -0,0 +1,145 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Per Karlsson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GPUIP_RUNNER_H_
+#define GPUIP_RUNNER_H_
+//----------------------------------------------------------------------------//
+#include "gpuip.h"
+#include "settings.h"
+#include <map>
+#include <string>
+#include <vector>
+//----------------------------------------------------------------------------//
+namespace gpuip {
+//----------------------------------------------------------------------------//
+/* Wall clock time in milliseconds. */
+double Now();
+//----------------------------------------------------------------------------//
+/* Number of processor cores, at least 1. */
+int NumCores();
+//----------------------------------------------------------------------------//
+/* Creates the directories of a file path that do not exist. */
+void MakeDirs(const std::string & path);
+//----------------------------------------------------------------------------//
+/* Replaces #### or %04d in a path with the zero padded frame number.
+   Paths without a pattern are returned as they are. */
+std::string FramePath(const std::string & path, int frame);
+//----------------------------------------------------------------------------//
+/* Parses a frame range FIRST-LAST or a single frame, frames may be
+   negative. An empty string is the single frame 0. */
+bool ParseFrames(const std::string & frames,
+                 std::vector<int> * out,
+                 std::string * error);
+//----------------------------------------------------------------------------//
+/* Keeps the image processor of an *.ip file built and allocated so that
+   images can be run through it one job after another without creating the
+   context, building the kernels or allocating again. The buffers are only
+   reallocated when the size of the input images changes. All calls must
+   come from the thread that called Init, which owns the GPU context. */
+class Runner
+{
+  public:
+    /* One set of images to process. Paths replace the input and output of
+       buffers in the *.ip file, params hold kernel, param and value. All
+       input images must have the same size. */
+    struct Job
+    {
+        std::vector<std::vector<std::string> > params;
+        std::map<std::string, std::string> inputs;
+        std::map<std::string, std::string> outputs;
+    };
+
+    /* Images in memory of the caller, such as shared memory of a client,
+       holding width * height * channels values of the type of their
+       buffer. Outputs are written back in place. */
+    struct Frame
+    {
+        Frame();
+
+        std::vector<std::vector<std::string> > params;
+        unsigned int width;
+        unsigned int height;
+        std::map<std::string, void *> inputs;
+        std::map<std::string, void *> outputs;
+    };
+
+    Runner();
+
+    ~Runner();
+
+    /* Reads an *.ip file, creates the image processor and builds the
+       kernels. threads is the number of threads used for image I/O, 0 means
+       one per core. */
+    bool Init(const std::string & filename,
+              int threads,
+              std::string * error);
+
+    /* Reads the inputs of a job, processes them and writes the outputs.
+       Parameters not set by the job keep their values from the *.ip file.
+       Returns the time in milliseconds or GPUIP_ERROR. */
+    double Run(const Job & job, std::string * error);
+
+    /* Processes images already in memory without any extra copy on the
+       host. Returns the time in milliseconds or GPUIP_ERROR. */
+    double Run(const Frame & frame, std::string * error);
+
+    /* Pins memory that frames will point into, see
+       ImageProcessor::RegisterHostMemory. */
+    bool RegisterHostMemory(void * data, size_t bytes, std::string * error);
+
+    bool UnregisterHostMemory(void * data, std::string * error);
+
+    const Settings & GetSettings() const;
+
+    /* Buffer of the image processor, null if there is none with the name */
+    Buffer::Ptr GetBuffer(const std::string & name) const;
+
+    /* Time in milliseconds spent by the last Run on the device */
+    double DeviceTime() const;
+
+  private:
+    Runner(const Runner &);
+    Runner & operator=(const Runner &);
+
+    bool _Start(const std::vector<std::vector<std::string> > & params,
+                std::string * error);
+
+    bool _Resize(unsigned int width, unsigned int height, std::string * error);
+
+    void _FreeHostMemory();
+
+    Settings _settings;
+    ImageProcessor::Ptr _ip;
+    std::vector<Buffer::Ptr> _buffers; // in the order of the settings
+    std::vector<Kernel::Ptr> _kernels;
+    std::vector<void *> _host;
+    unsigned int _width;
+    unsigned int _height;
+    int _threads;
+    double _deviceTime;
+};
+//----------------------------------------------------------------------------//
+} // end namespace gpuip
+//----------------------------------------------------------------------------//
+#endif
@@ -0,0 +1,540 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Per Karlsson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "settings.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+//----------------------------------------------------------------------------//
+namespace gpuip {
+//----------------------------------------------------------------------------//
+// Element of an XML document. Only what *.ip files use is supported:
+// elements, attributes, text, comments and CDATA sections.
+struct _XmlNode
+{
+    std::string name;
+    std::map<std::string, std::string> attributes;
+    std::string text;
+    std::vector<_XmlNode> children;
+
+    const _XmlNode * Child(const std::string & childName) const
+    {
+        for(size_t i = 0; i < children.size(); ++i) {
+            if (children[i].name == childName) {
+                return &children[i];
+            }
+        }
+        return NULL;
+    }
+
+    // Trimmed text of a child element, empty if there is none
+    std::string Data(const std::string & childName) const
+    {
+        const _XmlNode * child = Child(childName);
+        if (child == NULL) {
+            return "";
+        }
+        const char * space = " \t\r\n";
+        const size_t first = child->text.find_first_not_of(space);
+        if (first == std::string::npos) {
+            return "";
+        }
+        const size_t last = child->text.find_last_not_of(space);
+        return child->text.substr(first, last - first + 1);
+    }
+
+    std::string Attribute(const std::string & attribute) const
+    {
+        std::map<std::string, std::string>::const_iterator it =
+                attributes.find(attribute);
+        return it == attributes.end() ? std::string() : it->second;
+    }
+};
+//----------------------------------------------------------------------------//
+class _XmlParser
+{
+  public:
+    _XmlParser(const std::string & xml) : _xml(xml), _pos(0) {}
+
+    // Throws std::runtime_error if the document is malformed
+    void Parse(_XmlNode * root)
+    {
+        _SkipMisc();
+        _Element(root);
+        _SkipMisc();
+        if (_pos != _xml.size()) {
+            _Error("content after the root element");
+        }
+    }
+  private:
+    const std::string & _xml;
+    size_t _pos;
+
+    bool _At(const char * token) const
+    {
+        return _xml.compare(_pos, std::strlen(token), token) == 0;
+    }
+
+    void _Expect(const char * token)
+    {
+        if (!_At(token)) {
+            _Error(std::string("expected '") + token + "'");
+        }
+        _pos += std::strlen(token);
+    }
+
+    void _SkipTo(const char * token)
+    {
+        const size_t end = _xml.find(token, _pos);
+        if (end == std::string::npos) {
+            _Error(std::string("missing '") + token + "'");
+        }
+        _pos = end + std::strlen(token);
+    }
+
+    void _SkipSpace()
+    {
+        while(_pos < _xml.size() && std::isspace((unsigned char)_xml[_pos])) {
+            ++_pos;
+        }
+    }
+
+    // Whitespace, declarations, processing instructions and comments
+    void _SkipMisc()
+    {
+        for(;;) {
+            _SkipSpace();
+            if (_At("<?")) {
+                _SkipTo("?>");
+            } else if (_At("<!--")) {
+                _SkipTo("-->");
+            } else if (_At("<!DOCTYPE")) {
+                _SkipTo(">");
+            } else {
+                return;
+            }
+        }
+    }
+
+    std::string _Name()
+    {
+        const size_t begin = _pos;
+        while(_pos < _xml.size() &&
+              (std::isalnum((unsigned char)_xml[_pos]) ||
+               std::strchr("_-.:", _xml[_pos]))) {
+            ++_pos;
+        }
+        if (_pos == begin) {
+            _Error("expected a name");
+        }
+        return _xml.substr(begin, _pos - begin);
+    }
+
+    std::string _Decode(const std::string & text)
+    {
+        static const char * entities[][2] = {
+            { "&lt;", "<" }, { "&gt;", ">" }, { "&amp;", "&" },
+            { "&quot;", "\"" }, { "&apos;", "'" } };
+        std::string out;
+        for(size_t i = 0; i < text.size(); ++i) {
+            bool decoded = false;
+            for(size_t e = 0; e < 5 && text[i] == '&'; ++e) {
+                const size_t n = std::strlen(entities[e][0]);
+                if (text.compare(i, n, entities[e][0]) == 0) {
+                    out += entities[e][1];
+                    i += n - 1;
+                    decoded = true;
+                    break;
+                }
+            }
+            if (!decoded) {
+                out += text[i];
+            }
+        }
+        return out;
+    }
+
+    void _Element(_XmlNode * node)
+    {
+        _Expect("<");
+        node->name = _Name();
+        for(;;) {
+            _SkipSpace();
+            if (_At("/>")) {
+                _pos += 2;
+                return;
+            }
+            if (_At(">")) {
+                ++_pos;
+                break;
+            }
+            const std::string attribute = _Name();
+            _SkipSpace();
+            _Expect("=");
+            _SkipSpace();
+            const char quote[2] = { _pos < _xml.size() ? _xml[_pos] : '\0',
+                                    '\0' };
+            if (quote[0] != '"' && quote[0] != '\'') {
+                _Error("expected a quoted attribute value");
+            }
+            ++_pos;
+            const size_t begin = _pos;
+            _SkipTo(quote);
+            node->attributes[attribute] =
+                    _Decode(_xml.substr(begin, _pos - begin - 1));
+        }
+
+        // Content
+        for(;;) {
+            const size_t begin = _pos;
+            const size_t end = _xml.find('<', _pos);
+            if (end == std::string::npos) {
+                _Error("missing </" + node->name + ">");
+            }
+            node->text += _Decode(_xml.substr(begin, end - begin));
+            _pos = end;
+            if (_At("<!--")) {
+                _SkipTo("-->");
+            } else if (_At("<![CDATA[")) {
+                _pos += 9;
+                const size_t cdata = _pos;
+                _SkipTo("]]>");
+                node->text += _xml.substr(cdata, _pos - cdata - 3);
+            } else if (_At("</")) {
+                _pos += 2;
+                if (_Name() != node->name) {
+                    _Error("mismatched </" + node->name + ">");
+                }
+                _SkipSpace();
+                _Expect(">");
+                return;
+            } else {
+                node->children.push_back(_XmlNode());
+                _Element(&node->children.back());
+            }
+        }
+    }
+
+    void _Error(const std::string & what) const
+    {
+        // Line numbers count from 1
+        const size_t line = 1 + std::count(_xml.begin(),
+                                           _xml.begin() + std::min(_pos,
+                                                                   _xml.size()),
+                                           '\n');
+        std::stringstream ss;
+        ss << "line " << line << ": " << what;
+        throw std::runtime_error(ss.str());
+    }
+};
+//----------------------------------------------------------------------------//
+inline std::string _JoinPath(const std::string & dir, const std::string & path)
+{
+    const bool absolute = !path.empty() &&
+            (path[0] == '/' || path[0] == '\\' ||
+             (path.size() > 1 && path[1] == ':'));
+    if (absolute || dir.empty()) {
+        return path;
+    }
+    return dir + "/" + path;
+}
+//----------------------------------------------------------------------------//
+inline io::ExrCompression _ExrCompression(const std::string & name)
+{
+    static const char * names[] = { "none", "rle", "zips", "zip", "piz",
+                                     "pxr24", "b44", "b44a", "dwaa", "dwab" };
+    for(int i = 0; i <= io::EXR_DWAB; ++i) {
+        if (name == names[i]) {
+            return static_cast<io::ExrCompression>(i);
+        }
+    }
+    throw std::runtime_error("unknown exr compression '" + name + "'");
+}
+//----------------------------------------------------------------------------//
+inline Settings::Param _Param(const _XmlNode & node)
+{
+    Settings::Param param;
+    param.name = node.Data("name");
+    param.type = node.Data("type");
+    param.value = std::atof(node.Data("value").c_str());
+    param.defaultValue = std::atof(node.Data("default").c_str());
+    param.min = std::atof(node.Data("min").c_str());
+    param.max = std::atof(node.Data("max").c_str());
+    return param;
+}
+//----------------------------------------------------------------------------//
+inline Settings::Kernel::KernelBuffer _KernelBuffer(const _XmlNode & node)
+{
+    Settings::Kernel::KernelBuffer buffer;
+    buffer.name = node.Data("name");
+    buffer.buffer = node.Data("targetbuffer");
+    return buffer;
+}
+//----------------------------------------------------------------------------//
+Settings::Buffer::Buffer()
+        : channels(0)
+{
+}
+//----------------------------------------------------------------------------//
+Settings::Param::Param()
+        : value(0), defaultValue(0), min(0), max(0)
+{
+}
+//----------------------------------------------------------------------------//
+Settings::Kernel::Kernel()
+        : radius(0)
+{
+}
+//----------------------------------------------------------------------------//
+Settings::Param * Settings::Kernel::GetParam(const std::string & paramName)
+{
+    for(size_t i = 0; i < params.size(); ++i) {
+        if (params[i].name == paramName) {
+            return &params[i];
+        }
+    }
+    return NULL;
+}
+//----------------------------------------------------------------------------//
+bool Settings::Read(const std::string & filename, std::string * error)
+{
+    std::ifstream file(filename.c_str());
+    if (!file) {
+        (*error) += "Could not open " + filename + "\n";
+        return false;
+    }
+    std::stringstream xml;
+    xml << file.rdbuf();
+    const size_t slash = filename.find_last_of("/\\");
+    const std::string dir = slash == std::string::npos ?
+            std::string() : filename.substr(0, slash);
+
+    try {
+        const std::string content = xml.str();
+        _XmlNode root;
+        _XmlParser(content).Parse(&root);
+        if (root.name != "gpuip") {
+            throw std::runtime_error("root element is not <gpuip>");
+        }
+        environment = root.Data("environment");
+        buffers.clear();
+        kernels.clear();
+
+        for(size_t i = 0; i < root.children.size(); ++i) {
+            const _XmlNode & node = root.children[i];
+            if (node.name == "buffer") {
+                Buffer buffer;
+                buffer.name = node.Data("name");
+                buffer.type = node.Data("type");
+                buffer.channels = std::atoi(node.Data("channels").c_str());
+                if (node.Child("input")) {
+                    buffer.input = _JoinPath(dir, node.Data("input"));
+                }
+                if (const _XmlNode * output = node.Child("output")) {
+                    buffer.output = _JoinPath(dir, node.Data("output"));
+                    const std::string compression =
+                            output->Attribute("compression");
+                    const std::string lineOrder =
+                            output->Attribute("lineorder");
+                    const std::string chunkRows =
+                            output->Attribute("chunkrows");
+                    if (!compression.empty()) {
+                        buffer.exrOptions.compression =
+                                _ExrCompression(compression);
+                    }
+                    if (lineOrder == "decreasing_y") {
+                        buffer.exrOptions.lineOrder = io::EXR_DECREASING_Y;
+                    } else if (!lineOrder.empty() &&
+                               lineOrder != "increasing_y") {
+                        throw std::runtime_error("unknown exr line order '" +
+                                                 lineOrder + "'");
+                    }
+                    if (!chunkRows.empty()) {
+                        buffer.exrOptions.chunkRows =
+                                std::atoi(chunkRows.c_str());
+                    }
+                }
+                buffers.push_back(buffer);
+            } else if (node.name == "kernel") {
+                Kernel kernel;
+                kernel.name = node.Data("name");
+                kernel.codeFile = _JoinPath(dir, node.Data("code_file"));
+                kernel.radius = std::atoi(node.Data("radius").c_str());
+                for(size_t j = 0; j < node.children.size(); ++j) {
+                    const _XmlNode & child = node.children[j];
+                    if (child.name == "inbuffer") {
+                        kernel.inBuffers.push_back(_KernelBuffer(child));
+                    } else if (child.name == "outbuffer") {
+                        kernel.outBuffers.push_back(_KernelBuffer(child));
+                    } else if (child.name == "param") {
+                        kernel.params.push_back(_Param(child));
+                    }
+                }
+                std::ifstream code(kernel.codeFile.c_str());
+                if (!code) {
+                    throw std::runtime_error("could not open kernel code " +
+                                             kernel.codeFile);
+                }
+                std::stringstream ss;
+                ss << code.rdbuf();
+                kernel.code = ss.str();
+                kernels.push_back(kernel);
+            }
+        }
+    } catch (const std::exception & e) {
+        (*error) += filename + ": " + e.what() + "\n";
+        return false;
+    }
+    return true;
+}
+//----------------------------------------------------------------------------//
+Settings::Buffer * Settings::GetBuffer(const std::string & bufferName)
+{
+    for(size_t i = 0; i < buffers.size(); ++i) {
+        if (buffers[i].name == bufferName) {
+            return &buffers[i];
+        }
+    }
+    return NULL;
+}
+//----------------------------------------------------------------------------//
+Settings::Kernel * Settings::GetKernel(const std::string & kernelName)
+{
+    for(size_t i = 0; i < kernels.size(); ++i) {
+        if (kernels[i].name == kernelName) {
+            return &kernels[i];
+        }
+    }
+    return NULL;
+}
+//----------------------------------------------------------------------------//
+ImageProcessor::Ptr Settings::Create(
+    std::map<std::string, gpuip::Buffer::Ptr> * outBuffers,
+    std::vector<gpuip::Kernel::Ptr> * outKernels,
+    std::string * error) const
+{
+    GpuEnvironment env;
+    if (environment == "OpenCL") {
+        env = OpenCL;
+    } else if (environment == "CUDA") {
+        env = CUDA;
+    } else if (environment == "GLSL") {
+        env = GLSL;
+    } else {
+        (*error) += "Unknown environment '" + environment + "'\n";
+        return ImageProcessor::Ptr();
+    }
+    if (!ImageProcessor::CanCreate(env)) {
+        (*error) += "gpuip was not built with " + environment + "\n";
+        return ImageProcessor::Ptr();
+    }
+
+    ImageProcessor::Ptr ip;
+    try {
+        ip = ImageProcessor::Create(env);
+    } catch (const std::exception & e) {
+        (*error) += e.what();
+        (*error) += "\n";
+        return ImageProcessor::Ptr();
+    }
+
+    // Create and add buffers
+    for(size_t i = 0; i < buffers.size(); ++i) {
+        const Buffer & b = buffers[i];
+
+        // OpenCL aligns vector types with 3 elements to 4
+        const unsigned int channels =
+                env == OpenCL && b.channels == 3 ? 4 : b.channels;
+
+        gpuip::Buffer::Type type = gpuip::Buffer::HALF;
+        if (b.type == "float") {
+            type = gpuip::Buffer::FLOAT;
+        } else if (b.type == "ubyte") {
+            type = gpuip::Buffer::UNSIGNED_BYTE;
+        }
+        (*outBuffers)[b.name] = ip->CreateBuffer(b.name, type, channels);
+    }
+
+    // Create kernels, link buffers and set parameters. Kernel buffers
+    // without a target use the first buffer.
+    for(size_t i = 0; i < kernels.size(); ++i) {
+        const Kernel & k = kernels[i];
+        gpuip::Kernel::Ptr kernel = ip->CreateKernel(k.name);
+        for(int out = 0; out < 2; ++out) {
+            const std::vector<Kernel::KernelBuffer> & links =
+                    out ? k.outBuffers : k.inBuffers;
+            for(size_t j = 0; j < links.size(); ++j) {
+                const std::string & name = links[j].buffer.empty() &&
+                        !buffers.empty() ? buffers[0].name : links[j].buffer;
+                std::map<std::string, gpuip::Buffer::Ptr>::const_iterator it =
+                        outBuffers->find(name);
+                if (it == outBuffers->end()) {
+                    (*error) += "Kernel " + k.name + " uses unknown buffer '" +
+                            name + "'\n";
+                    return ImageProcessor::Ptr();
+                }
+                const gpuip::Kernel::BufferLink link(it->second,
+                                                     links[j].name);
+                if (out) {
+                    kernel->outBuffers.push_back(link);
+                } else {
+                    kernel->inBuffers.push_back(link);
+                }
+            }
+        }
+        kernel->code = k.code;
+        kernel->radius = k.radius;
+        outKernels->push_back(kernel);
+    }
+    SetParams(*outKernels);
+    return ip;
+}
+//----------------------------------------------------------------------------//
+void Settings::SetParams(const std::vector<gpuip::Kernel::Ptr> & kernelPtrs)
+        const
+{
+    for(size_t i = 0; i < kernels.size() && i < kernelPtrs.size(); ++i) {
+        const Kernel & k = kernels[i];
+        gpuip::Kernel & kernel = *kernelPtrs[i];
+        kernel.paramsInt.clear();
+        kernel.paramsFloat.clear();
+        for(size_t j = 0; j < k.params.size(); ++j) {
+            const Param & p = k.params[j];
+            if (p.type == "float") {
+                kernel.paramsFloat.push_back(
+                    Parameter<float>(p.name, (float)p.value));
+            } else {
+                kernel.paramsInt.push_back(
+                    Parameter<int>(p.name, (int)p.value));
+            }
+        }
+    }
+}
+//----------------------------------------------------------------------------//
+} // end namespace gpuip
+//----------------------------------------------------------------------------//
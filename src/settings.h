@@ -0,0 +1,113 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Per Karlsson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GPUIP_SETTINGS_H_
+#define GPUIP_SETTINGS_H_
+//----------------------------------------------------------------------------//
+#include "gpuip.h"
+#include "gpuip_io.h"
+#include <map>
+#include <string>
+#include <vector>
+//----------------------------------------------------------------------------//
+namespace gpuip {
+//----------------------------------------------------------------------------//
+/* Contents of an *.ip file, the XML-based format of the gpuip program. This
+   is the native counterpart of python/settings.py. */
+class Settings
+{
+  public:
+    struct Buffer
+    {
+        Buffer();
+
+        std::string name;
+        std::string type; // half, float or ubyte
+        unsigned int channels;
+        std::string input;
+        std::string output;
+        io::ExrOptions exrOptions;
+    };
+
+    struct Param
+    {
+        Param();
+
+        std::string name;
+        std::string type; // int or float
+        double value;
+        double defaultValue;
+        double min;
+        double max;
+    };
+
+    struct Kernel
+    {
+        struct KernelBuffer
+        {
+            std::string name;
+            std::string buffer; // empty for the first buffer
+        };
+
+        Kernel();
+
+        Param * GetParam(const std::string & name);
+
+        std::string name;
+        std::string code;
+        std::string codeFile;
+        unsigned int radius;
+        std::vector<Param> params;
+        std::vector<KernelBuffer> inBuffers;
+        std::vector<KernelBuffer> outBuffers;
+    };
+
+    /* Reads an *.ip file and the code of its kernels. Relative paths are
+       resolved against the directory of the file. */
+    bool Read(const std::string & filename, std::string * error);
+
+    Buffer * GetBuffer(const std::string & name);
+
+    Kernel * GetKernel(const std::string & name);
+
+    /* Creates an ImageProcessor with the buffers and kernels of the
+       settings. Kernels are linked to their buffers and given their code,
+       radius and parameter values. Returns a null pointer on failure. */
+    ImageProcessor::Ptr Create(
+        std::map<std::string, gpuip::Buffer::Ptr> * buffers,
+        std::vector<gpuip::Kernel::Ptr> * kernels,
+        std::string * error) const;
+
+    /* Sets the parameters of kernels created by Create to their values in
+       the settings. */
+    void SetParams(const std::vector<gpuip::Kernel::Ptr> & kernels) const;
+
+    std::string environment;
+    std::vector<Buffer> buffers;
+    std::vector<Kernel> kernels;
+};
+//----------------------------------------------------------------------------//
+} // end namespace gpuip
+//----------------------------------------------------------------------------//
+#endif
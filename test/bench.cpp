@@ -0,0 +1,1208 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Per Karlsson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// gpuip_bench: times transfers and kernels of every environment that can be
+// created, over a sweep of image sizes, buffer types and channel counts.
+#include <gpuip.h>
+#include <gpuip_synthetic.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+//----------------------------------------------------------------------------//
+namespace {
+//----------------------------------------------------------------------------//
+const char * _usage =
+        "usage: gpuip_bench [-h] [-w WARMUP] [-r REPETITIONS] [-s SIZES]\n"
+        "                   [-t TYPES] [-c CHANNELS] [-e ENVIRONMENTS]\n"
+        "                   [-k KERNELS_DIR] [-p PATTERN] [--seed SEED]\n"
+        "                   [-j FILE] [-b BASELINE] [--alpha ALPHA]\n"
+        "                   [--threshold PERCENT] [--peak GBPS] [-q]\n"
+        "\n"
+        "Times upload, kernel and download of every environment that can be\n"
+        "created. A kernel generated by BoilerplateCode, which reads its input\n"
+        "and writes its output once, is run for every size, type and channel\n"
+        "count. The example kernels in KERNELS_DIR (lerp, box blur, gaussian\n"
+        "blur and separable gaussian blur) are run for every size as half\n"
+        "with 4 channels. Inputs are synthetic images from PATTERN, so runs\n"
+        "are reproducible without image files. Times are wall clock\n"
+        "milliseconds, each phase ends when the device has finished it.\n"
+        "\n"
+        "optional arguments:\n"
+        "  -h, --help            show this help message and exit\n"
+        "  -w, --warmup N        Untimed runs before timing (default: 3)\n"
+        "  -r, --repetitions N   Timed runs (default: 30)\n"
+        "  -s, --sizes WxH,...   Image sizes\n"
+        "                        (default: 512x512,1920x1080,3840x2160)\n"
+        "  -t, --types T,...     Buffer types ubyte, half and float\n"
+        "                        (default: ubyte,half,float)\n"
+        "  -c, --channels N,...  Channel counts (default: 1,2,4)\n"
+        "  -e, --environments E,...\n"
+        "                        opencl, cuda and glsl (default: all)\n"
+        "  -k, --kernels DIR     Directory of the example kernels\n"
+        "  -p, --pattern PATTERN Input images, noise, gradient, checkerboard\n"
+        "                        or natural (default: natural)\n"
+        "  --seed SEED           Seed of the input images (default: 1)\n"
+        "  -j, --json FILE       Write the results as JSON to FILE\n"
+        "  -b, --baseline FILE   Compare with the JSON of an earlier run and\n"
+        "                        exit with 1 on significant regressions\n"
+        "  --alpha ALPHA         Significance level of the one-sided\n"
+        "                        Mann-Whitney U test (default: 0.01)\n"
+        "  --threshold PERCENT   Smallest slowdown of the median that is a\n"
+        "                        regression (default: 5)\n"
+        "  --peak GBPS           Peak memory bandwidth of the device in GB/s\n"
+        "                        (default: from the environment, CUDA only)\n"
+        "  -q, --quiet           Do not print the results tables\n"
+        "\n"
+        "With a baseline, the upload, compute, download and total times of\n"
+        "every benchmark in both runs are compared. A phase has regressed if\n"
+        "its times are larger than in the baseline according to the\n"
+        "Mann-Whitney U test over the repetitions and its median is at least\n"
+        "PERCENT slower. The test needs about 10 repetitions in both runs to\n"
+        "find anything at the default ALPHA.\n"
+        "\n"
+        "GB/s is the size of the buffers bound to the kernels, each read or\n"
+        "written once, over the median compute time, and peak is that in\n"
+        "percent of the peak bandwidth. The JSON has the same per kernel,\n"
+        "from kernel times where the environment measures them, with flop\n"
+        "estimates of the example kernels.\n";
+//----------------------------------------------------------------------------//
+struct _Options
+{
+    _Options()
+            : warmup(3), repetitions(30),
+              pattern(gpuip::synthetic::NATURAL), seed(1), alpha(0.01),
+              threshold(5), peak(0), quiet(false) {}
+
+    int warmup;
+    int repetitions;
+    std::vector<std::pair<unsigned int, unsigned int> > sizes;
+    std::vector<gpuip::Buffer::Type> types;
+    std::vector<unsigned int> channels;
+    std::vector<gpuip::GpuEnvironment> envs;
+    std::string kernelsDir;
+    gpuip::synthetic::Pattern pattern;
+    unsigned int seed;
+    std::string json;
+    std::string baseline;
+    double alpha;
+    double threshold; // percent
+    double peak; // GB/s, 0 to ask the environment
+    bool quiet;
+};
+//----------------------------------------------------------------------------//
+// A kernel and its links to buffers given by name. Empty code is replaced by
+// the boilerplate code of the environment.
+struct _KernelDesc
+{
+    std::string name;
+    std::string code;
+    std::vector<std::pair<std::string, std::string> > in; // buffer, argument
+    std::vector<std::pair<std::string, std::string> > out;
+    std::vector<gpuip::Parameter<int> > paramsInt;
+    std::vector<gpuip::Parameter<float> > paramsFloat;
+    double flopsPerPixel; // estimate, 0 if unknown
+};
+//----------------------------------------------------------------------------//
+// Buffers and kernels of one benchmark. All buffers have the same type and
+// channels.
+struct _Setup
+{
+    std::string name;
+    gpuip::Buffer::Type type;
+    unsigned int channels;
+    std::vector<std::string> buffers;
+    std::vector<std::string> uploads;
+    std::vector<std::string> downloads;
+    std::vector<_KernelDesc> kernels;
+};
+//----------------------------------------------------------------------------//
+struct _Stats
+{
+    _Stats() : min(0), median(0), mean(0), p95(0), p99(0), max(0) {}
+
+    double min;
+    double median;
+    double mean;
+    double p95;
+    double p99;
+    double max;
+    std::vector<double> samples; // timed runs in the order they were run
+};
+//----------------------------------------------------------------------------//
+struct _Result
+{
+    gpuip::GpuEnvironment env;
+    std::string name;
+    unsigned int width;
+    unsigned int height;
+    gpuip::Buffer::Type type;
+    unsigned int channels;
+    double bytes; // transferred per run
+    std::string error;
+    _Stats upload;
+    _Stats compute;
+    _Stats download;
+    _Stats total;
+    std::vector<gpuip::KernelReport> kernels; // with median kernel times
+    double peak; // GB/s, 0 if unknown
+};
+//----------------------------------------------------------------------------//
+const char * _envNames[] = { "OpenCL", "CUDA", "GLSL" };
+const char * _envExtensions[] = { ".cl", ".cu", ".glsl" };
+//----------------------------------------------------------------------------//
+double _Now()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart * 1000.0 / frequency.QuadPart;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+#endif
+}
+//----------------------------------------------------------------------------//
+void _Terminate(const std::string & msg)
+{
+    std::fprintf(stderr, "%s\n", msg.c_str());
+    std::exit(1);
+}
+//----------------------------------------------------------------------------//
+const char * _TypeName(gpuip::Buffer::Type type)
+{
+    switch(type) {
+        case gpuip::Buffer::UNSIGNED_BYTE:
+            return "ubyte";
+        case gpuip::Buffer::HALF:
+            return "half";
+        default:
+            return "float";
+    }
+}
+//----------------------------------------------------------------------------//
+size_t _TypeSize(gpuip::Buffer::Type type)
+{
+    switch(type) {
+        case gpuip::Buffer::UNSIGNED_BYTE:
+            return 1;
+        case gpuip::Buffer::HALF:
+            return 2;
+        default:
+            return 4;
+    }
+}
+//----------------------------------------------------------------------------//
+std::vector<std::string> _SplitList(const std::string & list)
+{
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    std::string item;
+    while(std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+//----------------------------------------------------------------------------//
+_Options _ParseArgs(int argc, char ** argv)
+{
+    _Options o;
+    std::string sizes = "512x512,1920x1080,3840x2160";
+    std::string types = "ubyte,half,float";
+    std::string channels = "1,2,4";
+    std::string envs = "opencl,cuda,glsl";
+    for(int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "-h" || a == "--help") {
+            std::printf("%s", _usage);
+            std::exit(0);
+        } else if (a == "-q" || a == "--quiet") {
+            o.quiet = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            _Terminate(std::string(_usage) + "gpuip_bench: error: argument " +
+                       a + " expects a value");
+        }
+        const std::string v = argv[++i];
+        if (a == "-w" || a == "--warmup") {
+            o.warmup = std::atoi(v.c_str());
+        } else if (a == "-r" || a == "--repetitions") {
+            o.repetitions = std::atoi(v.c_str());
+        } else if (a == "-s" || a == "--sizes") {
+            sizes = v;
+        } else if (a == "-t" || a == "--types") {
+            types = v;
+        } else if (a == "-c" || a == "--channels") {
+            channels = v;
+        } else if (a == "-e" || a == "--environments") {
+            envs = v;
+        } else if (a == "-k" || a == "--kernels") {
+            o.kernelsDir = v;
+        } else if (a == "-p" || a == "--pattern") {
+            if (!gpuip::synthetic::ParsePattern(v, &o.pattern)) {
+                _Terminate("gpuip_bench: error: invalid pattern " + v);
+            }
+        } else if (a == "--seed") {
+            o.seed = std::strtoul(v.c_str(), NULL, 10);
+        } else if (a == "-j" || a == "--json") {
+            o.json = v;
+        } else if (a == "-b" || a == "--baseline") {
+            o.baseline = v;
+        } else if (a == "--alpha") {
+            o.alpha = std::atof(v.c_str());
+        } else if (a == "--threshold") {
+            o.threshold = std::atof(v.c_str());
+        } else if (a == "--peak") {
+            o.peak = std::atof(v.c_str());
+        } else {
+            _Terminate(std::string(_usage) + "gpuip_bench: error: "
+                       "unrecognized argument " + a);
+        }
+    }
+    if (o.warmup < 0 || o.repetitions < 1) {
+        _Terminate("gpuip_bench: error: needs at least one repetition");
+    }
+    if (o.alpha <= 0 || o.alpha >= 1 || o.threshold < 0) {
+        _Terminate("gpuip_bench: error: invalid alpha or threshold");
+    }
+
+    const std::vector<std::string> s = _SplitList(sizes);
+    for(size_t i = 0; i < s.size(); ++i) {
+        unsigned int w = 0, h = 0;
+        if (std::sscanf(s[i].c_str(), "%ux%u", &w, &h) != 2 || !w || !h) {
+            _Terminate("gpuip_bench: error: invalid size " + s[i]);
+        }
+        o.sizes.push_back(std::make_pair(w, h));
+    }
+    const std::vector<std::string> t = _SplitList(types);
+    for(size_t i = 0; i < t.size(); ++i) {
+        if (t[i] == "ubyte") {
+            o.types.push_back(gpuip::Buffer::UNSIGNED_BYTE);
+        } else if (t[i] == "half") {
+            o.types.push_back(gpuip::Buffer::HALF);
+        } else if (t[i] == "float") {
+            o.types.push_back(gpuip::Buffer::FLOAT);
+        } else {
+            _Terminate("gpuip_bench: error: invalid type " + t[i]);
+        }
+    }
+    const std::vector<std::string> c = _SplitList(channels);
+    for(size_t i = 0; i < c.size(); ++i) {
+        const int n = std::atoi(c[i].c_str());
+        if (n < 1 || n > 4) {
+            _Terminate("gpuip_bench: error: invalid channel count " + c[i]);
+        }
+        o.channels.push_back(n);
+    }
+    const std::vector<std::string> e = _SplitList(envs);
+    for(size_t i = 0; i < e.size(); ++i) {
+        if (e[i] == "opencl") {
+            o.envs.push_back(gpuip::OpenCL);
+        } else if (e[i] == "cuda") {
+            o.envs.push_back(gpuip::CUDA);
+        } else if (e[i] == "glsl") {
+            o.envs.push_back(gpuip::GLSL);
+        } else {
+            _Terminate("gpuip_bench: error: invalid environment " + e[i]);
+        }
+    }
+    return o;
+}
+//----------------------------------------------------------------------------//
+// Nearest rank percentile of sorted values
+double _Percentile(const std::vector<double> & sorted, double p)
+{
+    size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+    rank = std::max(rank, (size_t)1);
+    return sorted[std::min(rank, sorted.size()) - 1];
+}
+//----------------------------------------------------------------------------//
+_Stats _ComputeStats(std::vector<double> times)
+{
+    _Stats s;
+    if (times.empty()) {
+        return s;
+    }
+    s.samples = times;
+    std::sort(times.begin(), times.end());
+    double sum = 0;
+    for(size_t i = 0; i < times.size(); ++i) {
+        sum += times[i];
+    }
+    const size_t n = times.size();
+    s.min = times.front();
+    s.max = times.back();
+    s.mean = sum / n;
+    s.median = n % 2 ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2;
+    s.p95 = _Percentile(times, 95);
+    s.p99 = _Percentile(times, 99);
+    return s;
+}
+//----------------------------------------------------------------------------//
+std::string _ReadFile(const std::string & filename)
+{
+    std::ifstream file(filename.c_str());
+    if (!file) {
+        return "";
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+//----------------------------------------------------------------------------//
+gpuip::Buffer::Ptr _Find(const std::vector<gpuip::Buffer::Ptr> & buffers,
+                         const std::string & name)
+{
+    for(size_t i = 0; i < buffers.size(); ++i) {
+        if (buffers[i]->name == name) {
+            return buffers[i];
+        }
+    }
+    return gpuip::Buffer::Ptr();
+}
+//----------------------------------------------------------------------------//
+// Sets up a benchmark in a new image processor, runs it warmup times and
+// then times every phase of each repetition
+bool _Bench(gpuip::GpuEnvironment env,
+            const _Options & o,
+            const _Setup & setup,
+            unsigned int width,
+            unsigned int height,
+            _Result * r)
+{
+    r->env = env;
+    r->name = setup.name;
+    r->width = width;
+    r->height = height;
+    r->type = setup.type;
+    r->channels = setup.channels;
+    r->peak = 0;
+    const size_t bytes = (size_t)width * height * setup.channels *
+            _TypeSize(setup.type);
+    r->bytes = (double)bytes * (setup.uploads.size() + setup.downloads.size());
+
+    gpuip::ImageProcessor::Ptr ip(gpuip::ImageProcessor::Create(env));
+    ip->SetDimensions(width, height);
+    std::vector<gpuip::Buffer::Ptr> buffers;
+    for(size_t i = 0; i < setup.buffers.size(); ++i) {
+        buffers.push_back(ip->CreateBuffer(setup.buffers[i], setup.type,
+                                           setup.channels));
+    }
+    for(size_t i = 0; i < setup.kernels.size(); ++i) {
+        const _KernelDesc & k = setup.kernels[i];
+        gpuip::Kernel::Ptr kernel = ip->CreateKernel(k.name);
+        for(size_t j = 0; j < k.in.size(); ++j) {
+            kernel->inBuffers.push_back(gpuip::Kernel::BufferLink(
+                _Find(buffers, k.in[j].first), k.in[j].second));
+        }
+        for(size_t j = 0; j < k.out.size(); ++j) {
+            kernel->outBuffers.push_back(gpuip::Kernel::BufferLink(
+                _Find(buffers, k.out[j].first), k.out[j].second));
+        }
+        kernel->paramsInt = k.paramsInt;
+        kernel->paramsFloat = k.paramsFloat;
+        kernel->flopsPerPixel = k.flopsPerPixel;
+        kernel->code = k.code.empty() ? ip->BoilerplateCode(kernel) : k.code;
+    }
+
+    std::string & err = r->error;
+    if (ip->Allocate(&err) == GPUIP_ERROR || ip->Build(&err) == GPUIP_ERROR) {
+        return false;
+    }
+
+    // Host memory of the image processor is the fastest to copy from
+    std::vector<void *> uploads, downloads;
+    bool ok = true;
+    for(size_t i = 0; i < setup.uploads.size() && ok; ++i) {
+        void * p = ip->AllocateHostMemory(_Find(buffers, setup.uploads[i]),
+                                          &err);
+        // Each input gets its own synthetic image
+        ok = p != NULL && gpuip::synthetic::Generate(
+            p, setup.type, setup.channels, width, height, o.pattern,
+            o.seed + i, &err);
+        if (p) {
+            uploads.push_back(p);
+        }
+    }
+    for(size_t i = 0; i < setup.downloads.size() && ok; ++i) {
+        void * p = ip->AllocateHostMemory(_Find(buffers, setup.downloads[i]),
+                                          &err);
+        ok = p != NULL;
+        if (ok) {
+            downloads.push_back(p);
+        }
+    }
+
+    std::vector<double> upload, compute, download, total;
+    std::vector<std::vector<double> > kernelTimes(setup.kernels.size());
+    for(int rep = 0; rep < o.warmup + o.repetitions && ok; ++rep) {
+        // Finish before every timestamp, GLSL returns from uploads and runs
+        // before the GPU has done them
+        ok = ok && ip->Finish(&err);
+        const double t0 = _Now();
+        for(size_t i = 0; i < uploads.size() && ok; ++i) {
+            ok = ip->Copy(_Find(buffers, setup.uploads[i]),
+                          gpuip::Buffer::COPY_TO_GPU, uploads[i], &err)
+                    != GPUIP_ERROR;
+        }
+        ok = ok && ip->Finish(&err);
+        const double t1 = _Now();
+        ok = ok && ip->Run(&err) != GPUIP_ERROR && ip->Finish(&err);
+        const double t2 = _Now();
+        for(size_t i = 0; i < downloads.size() && ok; ++i) {
+            ok = ip->Copy(_Find(buffers, setup.downloads[i]),
+                          gpuip::Buffer::COPY_FROM_GPU, downloads[i], &err)
+                    != GPUIP_ERROR;
+        }
+        ok = ok && ip->Finish(&err);
+        const double t3 = _Now();
+        if (rep >= o.warmup) {
+            upload.push_back(t1 - t0);
+            compute.push_back(t2 - t1);
+            download.push_back(t3 - t2);
+            total.push_back(t3 - t0);
+            const std::vector<double> & times = ip->KernelTimes();
+            for(size_t i = 0; i < times.size(); ++i) {
+                kernelTimes[i].push_back(times[i]);
+            }
+        }
+    }
+
+    std::string freeErr;
+    for(size_t i = 0; i < uploads.size(); ++i) {
+        ip->FreeHostMemory(uploads[i], &freeErr);
+    }
+    for(size_t i = 0; i < downloads.size(); ++i) {
+        ip->FreeHostMemory(downloads[i], &freeErr);
+    }
+    if (!ok) {
+        return false;
+    }
+    r->upload = _ComputeStats(upload);
+    r->compute = _ComputeStats(compute);
+    r->download = _ComputeStats(download);
+    r->total = _ComputeStats(total);
+    r->kernels = ip->KernelReports();
+    for(size_t i = 0; i < r->kernels.size(); ++i) {
+        r->kernels[i].time = _ComputeStats(kernelTimes[i]).median;
+    }
+    r->peak = o.peak > 0 ? o.peak : ip->PeakBandwidth();
+    return true;
+}
+//----------------------------------------------------------------------------//
+_KernelDesc _Kernel(const std::string & name,
+                    const std::string & code,
+                    const std::string & in,
+                    const std::string & inArg,
+                    const std::string & out,
+                    const std::string & outArg)
+{
+    _KernelDesc k;
+    k.name = name;
+    k.code = code;
+    k.in.push_back(std::make_pair(in, inArg));
+    k.out.push_back(std::make_pair(out, outArg));
+    k.flopsPerPixel = 0;
+    return k;
+}
+//----------------------------------------------------------------------------//
+// Copy-like kernel of every type and channel count
+std::vector<_Setup> _SweepSetups(const _Options & o)
+{
+    std::vector<_Setup> setups;
+    for(size_t t = 0; t < o.types.size(); ++t) {
+        for(size_t c = 0; c < o.channels.size(); ++c) {
+            _Setup s;
+            s.name = "boilerplate";
+            s.type = o.types[t];
+            s.channels = o.channels[c];
+            s.buffers.push_back("b1");
+            s.buffers.push_back("b2");
+            s.uploads.push_back("b1");
+            s.downloads.push_back("b2");
+            s.kernels.push_back(_Kernel("boilerplate", "", "b1", "src",
+                                        "b2", "dst"));
+            setups.push_back(s);
+        }
+    }
+    return setups;
+}
+//----------------------------------------------------------------------------//
+// Example kernels of an environment that are found in the kernels directory
+std::vector<_Setup> _ExampleSetups(const _Options & o,
+                                   gpuip::GpuEnvironment env)
+{
+    std::vector<_Setup> setups;
+    if (o.kernelsDir.empty()) {
+        return setups;
+    }
+    const std::string dir = o.kernelsDir + "/";
+    const std::string ext = _envExtensions[env];
+    const gpuip::Parameter<int> n("n", 4);
+
+    _Setup base;
+    base.type = gpuip::Buffer::HALF;
+    base.channels = 4;
+    base.buffers.push_back("b1");
+    base.buffers.push_back("b2");
+    base.uploads.push_back("b1");
+
+    const std::string lerp = _ReadFile(dir + "lerp" + ext);
+    if (!lerp.empty()) {
+        _Setup s = base;
+        s.name = "lerp";
+        s.buffers.push_back("b3");
+        s.uploads.push_back("b2");
+        s.downloads.push_back("b3");
+        _KernelDesc k = _Kernel("lerp", lerp, "b1", "a", "b3", "out");
+        k.in.push_back(std::make_pair(std::string("b2"), std::string("b")));
+        k.paramsFloat.push_back(gpuip::Parameter<float>("alpha", 0.5f));
+        k.flopsPerPixel = 3 * 4;
+        s.kernels.push_back(k);
+        setups.push_back(s);
+    }
+
+    // Rough flops per pixel with n = 4: 81 taps of 4 channels, where a
+    // gaussian tap also computes its weight (exp counted as 4)
+    const char * blurs[] = { "box_blur", "gaussian_blur" };
+    const double blurFlops[] = { 81 * 4 + 4, 81 * (4 + 4 + 9) + 4 };
+    for(int i = 0; i < 2; ++i) {
+        const std::string code = _ReadFile(dir + blurs[i] + ext);
+        if (!code.empty()) {
+            _Setup s = base;
+            s.name = blurs[i];
+            s.downloads.push_back("b2");
+            s.kernels.push_back(_Kernel(blurs[i], code, "b1", "input",
+                                        "b2", "output"));
+            s.kernels.back().paramsInt.push_back(n);
+            s.kernels.back().flopsPerPixel = blurFlops[i];
+            setups.push_back(s);
+        }
+    }
+
+    const std::string hor = _ReadFile(dir + "gaussian_blur_hor" + ext);
+    const std::string vert = _ReadFile(dir + "gaussian_blur_vert" + ext);
+    if (!hor.empty() && !vert.empty()) {
+        _Setup s = base;
+        s.name = "gaussian_blur_separable";
+        s.buffers.push_back("b3");
+        s.downloads.push_back("b3");
+        s.kernels.push_back(_Kernel("gaussian_blur_hor", hor, "b1", "input",
+                                    "b2", "output"));
+        s.kernels.back().paramsInt.push_back(n);
+        s.kernels.back().flopsPerPixel = 9 * (4 + 4 + 5) + 4;
+        s.kernels.push_back(_Kernel("gaussian_blur_vert", vert, "b2",
+                                    "input", "b3", "output"));
+        s.kernels.back().paramsInt.push_back(n);
+        s.kernels.back().flopsPerPixel = 9 * (4 + 4 + 5) + 4;
+        setups.push_back(s);
+    }
+    return setups;
+}
+//----------------------------------------------------------------------------//
+std::string _JsonString(const std::string & s)
+{
+    std::string out = "\"";
+    for(size_t i = 0; i < s.size(); ++i) {
+        const unsigned char c = s[i];
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (c < 0x20) {
+            char buf[8];
+            std::sprintf(buf, "\\u%04x", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+//----------------------------------------------------------------------------//
+void _WriteStats(std::FILE * f, const char * name, const _Stats & s)
+{
+    std::fprintf(f, "\"%s\": {\"min\": %.4f, \"median\": %.4f, "
+                 "\"mean\": %.4f, \"p95\": %.4f, \"p99\": %.4f, "
+                 "\"max\": %.4f,\n       \"samples\": [", name, s.min,
+                 s.median, s.mean, s.p95, s.p99, s.max);
+    for(size_t i = 0; i < s.samples.size(); ++i) {
+        std::fprintf(f, "%s%.4f", i ? ", " : "", s.samples[i]);
+    }
+    std::fprintf(f, "]}");
+}
+//----------------------------------------------------------------------------//
+// GB/s of all kernels of a benchmark over the median compute time
+double _Bandwidth(const _Result & r)
+{
+    double bytes = 0;
+    for(size_t i = 0; i < r.kernels.size(); ++i) {
+        bytes += r.kernels[i].bytesRead + r.kernels[i].bytesWritten;
+    }
+    return r.compute.median > 0 ? bytes / (r.compute.median * 1e6) : 0;
+}
+//----------------------------------------------------------------------------//
+void _WriteJson(const _Options & o, const std::vector<_Result> & results)
+{
+    std::FILE * f = std::fopen(o.json.c_str(), "w");
+    if (!f) {
+        _Terminate("gpuip_bench: error: could not write " + o.json);
+    }
+    std::fprintf(f, "{\n  \"unit\": \"ms\",\n  \"warmup\": %d,\n"
+                 "  \"repetitions\": %d,\n  \"pattern\": \"%s\",\n"
+                 "  \"seed\": %u,\n  \"results\": [", o.warmup, o.repetitions,
+                 gpuip::synthetic::PatternName(o.pattern), o.seed);
+    for(size_t i = 0; i < results.size(); ++i) {
+        const _Result & r = results[i];
+        std::fprintf(f, "%s\n    {\"environment\": \"%s\", \"kernel\": %s, "
+                     "\"width\": %u, \"height\": %u, \"type\": \"%s\", "
+                     "\"channels\": %u, \"bytes\": %.0f,\n     ",
+                     i ? "," : "", _envNames[r.env],
+                     _JsonString(r.name).c_str(), r.width, r.height,
+                     _TypeName(r.type), r.channels, r.bytes);
+        if (!r.error.empty()) {
+            std::fprintf(f, "\"error\": %s}", _JsonString(r.error).c_str());
+            continue;
+        }
+        _WriteStats(f, "upload", r.upload);
+        std::fprintf(f, ",\n     ");
+        _WriteStats(f, "compute", r.compute);
+        std::fprintf(f, ",\n     ");
+        _WriteStats(f, "download", r.download);
+        std::fprintf(f, ",\n     ");
+        _WriteStats(f, "total", r.total);
+        std::fprintf(f, ",\n     \"bandwidth\": %.3f, "
+                     "\"peak_bandwidth\": %.3f, \"kernels\": [",
+                     _Bandwidth(r), r.peak);
+        for(size_t k = 0; k < r.kernels.size(); ++k) {
+            const gpuip::KernelReport & kr = r.kernels[k];
+            std::fprintf(f, "%s\n       {\"name\": %s, \"bytes_read\": %.0f, "
+                         "\"bytes_written\": %.0f, \"flops\": %.0f, "
+                         "\"time\": %.4f, \"bandwidth\": %.3f, "
+                         "\"flop_rate\": %.3f, \"intensity\": %.4f}",
+                         k ? "," : "", _JsonString(kr.name).c_str(),
+                         kr.bytesRead, kr.bytesWritten, kr.flops, kr.time,
+                         kr.Bandwidth(), kr.FlopRate(), kr.Intensity());
+        }
+        std::fprintf(f, "]}");
+    }
+    std::fprintf(f, "\n  ]\n}\n");
+    std::fclose(f);
+}
+//----------------------------------------------------------------------------//
+void _PrintResult(const _Result & r)
+{
+    char size[32];
+    std::sprintf(size, "%ux%u", r.width, r.height);
+    std::printf("%-6s %-23s %-9s %-5s %u ", _envNames[r.env], r.name.c_str(),
+                size, _TypeName(r.type), r.channels);
+    if (!r.error.empty()) {
+        std::printf(" failed: %s", r.error.c_str());
+        if (r.error[r.error.size() - 1] != '\n') {
+            std::printf("\n");
+        }
+        return;
+    }
+    std::printf("%9.3f %9.3f %9.3f %9.3f %9.3f %9.3f %9.1f", r.upload.median,
+                r.compute.median, r.download.median, r.total.median,
+                r.total.p95, r.total.p99, _Bandwidth(r));
+    if (r.peak > 0) {
+        std::printf(" %5.0f%%\n", 100 * _Bandwidth(r) / r.peak);
+    } else {
+        std::printf(" %6s\n", "-");
+    }
+}
+//----------------------------------------------------------------------------//
+// Reads the JSON written by _WriteJson. Only what is needed for a
+// comparison is kept, anything else is skipped.
+class _JsonReader
+{
+  public:
+    _JsonReader(const std::string & text) : _text(text), _pos(0) {}
+
+    bool Results(std::vector<_Result> * results)
+    {
+        if (!_Expect('{')) {
+            return false;
+        }
+        if (_Peek() == '}') {
+            return _Expect('}');
+        }
+        do {
+            std::string key;
+            if (!_String(&key) || !_Expect(':')) {
+                return false;
+            }
+            if (key != "results") {
+                if (!_Skip()) {
+                    return false;
+                }
+                continue;
+            }
+            if (!_Expect('[')) {
+                return false;
+            }
+            if (_Peek() == ']') {
+                ++_pos;
+                continue;
+            }
+            do {
+                _Result r;
+                if (!_ReadResult(&r)) {
+                    return false;
+                }
+                results->push_back(r);
+            } while (_Comma());
+            if (!_Expect(']')) {
+                return false;
+            }
+        } while (_Comma());
+        return _Expect('}');
+    }
+
+  private:
+    bool _ReadResult(_Result * r)
+    {
+        r->env = gpuip::OpenCL;
+        r->width = r->height = r->channels = 0;
+        r->type = gpuip::Buffer::FLOAT;
+        r->bytes = 0;
+        r->peak = 0;
+        if (!_Expect('{')) {
+            return false;
+        }
+        do {
+            std::string key, value;
+            double number;
+            if (!_String(&key) || !_Expect(':')) {
+                return false;
+            }
+            bool ok;
+            if (key == "environment") {
+                ok = _String(&value);
+                for(int i = 0; i < 3; ++i) {
+                    if (value == _envNames[i]) {
+                        r->env = gpuip::GpuEnvironment(i);
+                    }
+                }
+            } else if (key == "kernel") {
+                ok = _String(&r->name);
+            } else if (key == "type") {
+                ok = _String(&value);
+                r->type = value == "ubyte" ? gpuip::Buffer::UNSIGNED_BYTE :
+                        (value == "half" ? gpuip::Buffer::HALF :
+                         gpuip::Buffer::FLOAT);
+            } else if (key == "width" || key == "height" ||
+                       key == "channels" || key == "bytes") {
+                ok = _Number(&number);
+                if (key == "width") {
+                    r->width = (unsigned int)number;
+                } else if (key == "height") {
+                    r->height = (unsigned int)number;
+                } else if (key == "channels") {
+                    r->channels = (unsigned int)number;
+                } else {
+                    r->bytes = number;
+                }
+            } else if (key == "error") {
+                ok = _String(&r->error);
+            } else if (key == "upload") {
+                ok = _ReadStats(&r->upload);
+            } else if (key == "compute") {
+                ok = _ReadStats(&r->compute);
+            } else if (key == "download") {
+                ok = _ReadStats(&r->download);
+            } else if (key == "total") {
+                ok = _ReadStats(&r->total);
+            } else {
+                ok = _Skip();
+            }
+            if (!ok) {
+                return false;
+            }
+        } while (_Comma());
+        return _Expect('}');
+    }
+
+    bool _ReadStats(_Stats * s)
+    {
+        if (!_Expect('{')) {
+            return false;
+        }
+        do {
+            std::string key;
+            if (!_String(&key) || !_Expect(':')) {
+                return false;
+            }
+            double * value = NULL;
+            if (key == "min") {
+                value = &s->min;
+            } else if (key == "median") {
+                value = &s->median;
+            } else if (key == "mean") {
+                value = &s->mean;
+            } else if (key == "p95") {
+                value = &s->p95;
+            } else if (key == "p99") {
+                value = &s->p99;
+            } else if (key == "max") {
+                value = &s->max;
+            }
+            if (value) {
+                if (!_Number(value)) {
+                    return false;
+                }
+                continue;
+            }
+            if (key != "samples") {
+                if (!_Skip()) {
+                    return false;
+                }
+                continue;
+            }
+            if (!_Expect('[')) {
+                return false;
+            }
+            if (_Peek() == ']') {
+                ++_pos;
+                continue;
+            }
+            do {
+                double t;
+                if (!_Number(&t)) {
+                    return false;
+                }
+                s->samples.push_back(t);
+            } while (_Comma());
+            if (!_Expect(']')) {
+                return false;
+            }
+        } while (_Comma());
+        return _Expect('}');
+    }
+
+    char _Peek()
+    {
+        while (_pos < _text.size() &&
+               std::isspace((unsigned char)_text[_pos])) {
+            ++_pos;
+        }
+        return _pos < _text.size() ? _text[_pos] : '\0';
+    }
+
+    bool _Expect(char c)
+    {
+        if (_Peek() != c) {
+            return false;
+        }
+        ++_pos;
+        return true;
+    }
+
+    bool _Comma()
+    {
+        return _Expect(',');
+    }
+
+    bool _String(std::string * s)
+    {
+        if (!_Expect('"')) {
+            return false;
+        }
+        s->clear();
+        while (_pos < _text.size() && _text[_pos] != '"') {
+            char c = _text[_pos++];
+            if (c == '\\' && _pos < _text.size()) {
+                c = _text[_pos++];
+                if (c == 'n') {
+                    c = '\n';
+                } else if (c == 'u' && _pos + 4 <= _text.size()) {
+                    c = (char)std::strtol(_text.substr(_pos, 4).c_str(),
+                                          NULL, 16);
+                    _pos += 4;
+                }
+            }
+            (*s) += c;
+        }
+        return _pos++ < _text.size();
+    }
+
+    bool _Number(double * number)
+    {
+        _Peek();
+        const char * begin = _text.c_str() + _pos;
+        char * end;
+        *number = std::strtod(begin, &end);
+        _pos += end - begin;
+        return end != begin;
+    }
+
+    // Skips any value
+    bool _Skip()
+    {
+        const char c = _Peek();
+        if (c == '"') {
+            std::string s;
+            return _String(&s);
+        } else if (c == '{' || c == '[') {
+            const char close = c == '{' ? '}' : ']';
+            ++_pos;
+            if (_Peek() == close) {
+                ++_pos;
+                return true;
+            }
+            do {
+                if (c == '{') {
+                    std::string key;
+                    if (!_String(&key) || !_Expect(':')) {
+                        return false;
+                    }
+                }
+                if (!_Skip()) {
+                    return false;
+                }
+            } while (_Comma());
+            return _Expect(close);
+        }
+        // Numbers, true, false and null
+        const size_t begin = _pos;
+        while (_pos < _text.size() &&
+               (std::isalnum((unsigned char)_text[_pos]) ||
+                _text[_pos] == '-' || _text[_pos] == '+' ||
+                _text[_pos] == '.')) {
+            ++_pos;
+        }
+        return _pos != begin;
+    }
+
+    const std::string & _text;
+    size_t _pos;
+};
+//----------------------------------------------------------------------------//
+// One-sided p-value of the Mann-Whitney U test that the values of b tend to
+// be larger than the values of a. Uses the normal approximation with tie and
+// continuity corrections, which needs about 10 values in each sample.
+double _MannWhitney(const std::vector<double> & a,
+                    const std::vector<double> & b)
+{
+    const size_t n = a.size(), m = b.size(), total = n + m;
+    if (!n || !m) {
+        return 1;
+    }
+    std::vector<std::pair<double, bool> > all; // value, from b
+    for(size_t i = 0; i < n; ++i) {
+        all.push_back(std::make_pair(a[i], false));
+    }
+    for(size_t i = 0; i < m; ++i) {
+        all.push_back(std::make_pair(b[i], true));
+    }
+    std::sort(all.begin(), all.end());
+
+    // Sum of the ranks of b, ties get their average rank
+    double rankSum = 0, ties = 0;
+    for(size_t i = 0; i < total;) {
+        size_t j = i;
+        while (j < total && all[j].first == all[i].first) {
+            ++j;
+        }
+        const double rank = (i + 1 + j) / 2.0;
+        for(size_t k = i; k < j; ++k) {
+            rankSum += all[k].second ? rank : 0;
+        }
+        const double t = j - i;
+        ties += t * t * t - t;
+        i = j;
+    }
+    const double u = rankSum - m * (m + 1) / 2.0;
+    const double mean = n * m / 2.0;
+    const double var = n * m / 12.0 *
+            (total + 1 - ties / ((double)total * (total - 1)));
+    if (var <= 0) {
+        return 1;
+    }
+    const double z = (u - mean - 0.5) / std::sqrt(var);
+    return 0.5 * erfc(z / std::sqrt(2.0));
+}
+//----------------------------------------------------------------------------//
+bool _SameBenchmark(const _Result & a, const _Result & b)
+{
+    return a.env == b.env && a.name == b.name && a.width == b.width &&
+            a.height == b.height && a.type == b.type &&
+            a.channels == b.channels;
+}
+//----------------------------------------------------------------------------//
+// Compares every phase of the results with the baseline. Prints the change
+// of the medians in percent, marked with ! where it is a regression.
+// Returns the number of regressions.
+int _Compare(const _Options & o,
+             const std::vector<_Result> & results,
+             const std::vector<_Result> & baseline)
+{
+    if (!o.quiet) {
+        std::printf("\nchange of the median compared with %s "
+                    "(! regression, alpha %g, threshold %g%%)\n",
+                    o.baseline.c_str(), o.alpha, o.threshold);
+        std::printf("%-6s %-23s %-9s %-5s %s %9s %9s %9s %9s\n",
+                    "env", "kernel", "size", "type", "c", "upload",
+                    "compute", "download", "total");
+    }
+    int regressions = 0;
+    for(size_t i = 0; i < results.size(); ++i) {
+        const _Result & r = results[i];
+        const _Result * b = NULL;
+        for(size_t j = 0; j < baseline.size() && !b; ++j) {
+            if (_SameBenchmark(r, baseline[j])) {
+                b = &baseline[j];
+            }
+        }
+        char size[32];
+        std::sprintf(size, "%ux%u", r.width, r.height);
+        if (!o.quiet) {
+            std::printf("%-6s %-23s %-9s %-5s %u ", _envNames[r.env],
+                        r.name.c_str(), size, _TypeName(r.type), r.channels);
+        }
+        if (!b || !r.error.empty() || !b->error.empty()) {
+            if (!o.quiet) {
+                std::printf(" %s\n", !b ? "not in baseline" :
+                            (r.error.empty() ? "failed in baseline" :
+                             "failed"));
+            }
+            continue;
+        }
+
+        const _Stats * now[] = { &r.upload, &r.compute, &r.download,
+                                 &r.total };
+        const _Stats * then[] = { &b->upload, &b->compute, &b->download,
+                                  &b->total };
+        const char * phases[] = { "upload", "compute", "download", "total" };
+        for(int p = 0; p < 4; ++p) {
+            const double change = then[p]->median > 0 ?
+                    (now[p]->median / then[p]->median - 1) * 100 : 0;
+            const bool regression = change >= o.threshold &&
+                    _MannWhitney(then[p]->samples, now[p]->samples) < o.alpha;
+            if (!o.quiet) {
+                std::printf(" %+7.1f%%%c", change, regression ? '!' : ' ');
+            }
+            if (regression) {
+                ++regressions;
+                std::fflush(stdout);
+                std::fprintf(stderr, "gpuip_bench: %s %s %s %s %u %s is "
+                             "%.1f%% slower (%.3f ms, was %.3f ms)\n",
+                             _envNames[r.env], r.name.c_str(), size,
+                             _TypeName(r.type), r.channels, phases[p],
+                             change, now[p]->median, then[p]->median);
+            }
+        }
+        if (!o.quiet) {
+            std::printf("\n");
+        }
+    }
+    return regressions;
+}
+//----------------------------------------------------------------------------//
+std::vector<_Result> _ReadBaseline(const std::string & filename)
+{
+    const std::string text = _ReadFile(filename);
+    std::vector<_Result> baseline;
+    _JsonReader reader(text);
+    if (text.empty() || !reader.Results(&baseline)) {
+        _Terminate("gpuip_bench: error: could not read the baseline " +
+                   filename);
+    }
+    for(size_t i = 0; i < baseline.size(); ++i) {
+        if (baseline[i].error.empty() &&
+            baseline[i].total.samples.empty()) {
+            _Terminate("gpuip_bench: error: the baseline " + filename +
+                       " has no samples, write it again with -j");
+        }
+    }
+    return baseline;
+}
+//----------------------------------------------------------------------------//
+} // end anonymous namespace
+//----------------------------------------------------------------------------//
+int main(int argc, char ** argv)
+{
+    const _Options o = _ParseArgs(argc, argv);
+    // Read before running, to not wait for a bad file
+    std::vector<_Result> baseline;
+    if (!o.baseline.empty()) {
+        baseline = _ReadBaseline(o.baseline);
+    }
+    if (!o.quiet) {
+        std::printf("%-6s %-23s %-9s %-5s %s %9s %9s %9s %9s %9s %9s %9s "
+                    "%6s\n", "env", "kernel", "size", "type", "c", "upload",
+                    "compute", "download", "total", "p95", "p99", "GB/s",
+                    "peak");
+    }
+
+    std::vector<_Result> results;
+    bool failed = false;
+    for(size_t e = 0; e < o.envs.size(); ++e) {
+        const gpuip::GpuEnvironment env = o.envs[e];
+        if (!gpuip::ImageProcessor::CanCreate(env)) {
+            continue;
+        }
+        std::vector<_Setup> setups = _SweepSetups(o);
+        const std::vector<_Setup> examples = _ExampleSetups(o, env);
+        setups.insert(setups.end(), examples.begin(), examples.end());
+        for(size_t s = 0; s < o.sizes.size(); ++s) {
+            for(size_t i = 0; i < setups.size(); ++i) {
+                _Result r;
+                failed = !_Bench(env, o, setups[i], o.sizes[s].first,
+                                 o.sizes[s].second, &r) || failed;
+                if (!o.quiet) {
+                    _PrintResult(r);
+                    std::fflush(stdout);
+                }
+                results.push_back(r);
+            }
+        }
+    }
+
+    if (!o.json.empty()) {
+        _WriteJson(o, results);
+    }
+    if (!o.baseline.empty() && _Compare(o, results, baseline)) {
+        failed = true;
+    }
+    return failed ? 1 : 0;
+}
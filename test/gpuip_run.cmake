@@ -0,0 +1,58 @@
+# The MIT License (MIT)
+# 
+# Copyright (c) 2014 Per Karlsson
+# 
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+# 
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+# Runs gpuip-run on images written by gpuip-synth, once for a single image
+# and once for a sequence of frames. Called by ctest with SYNTH, RUN, IP (an
+# example *.ip file with buffers buffer1, buffer2 -> buffer3) and DIR.
+
+file(REMOVE_RECURSE ${DIR})
+file(MAKE_DIRECTORY ${DIR})
+
+macro(gpuip_run_test_command)
+  execute_process(COMMAND ${ARGN} RESULT_VARIABLE _result)
+  if(NOT _result EQUAL 0)
+    message(FATAL_ERROR "Failed (${_result}): ${ARGN}")
+  endif()
+endmacro()
+
+foreach(_frame 0001 0002)
+  gpuip_run_test_command(${SYNTH} -s 64x48 --seed 1${_frame}
+                         ${DIR}/a_${_frame}.exr)
+  gpuip_run_test_command(${SYNTH} -s 64x48 --seed 2${_frame}
+                         ${DIR}/b_${_frame}.exr)
+endforeach()
+
+gpuip_run_test_command(${RUN} -f ${IP}
+  -i buffer1 ${DIR}/a_0001.exr -i buffer2 ${DIR}/b_0001.exr
+  -o buffer3 ${DIR}/out.exr)
+if(NOT EXISTS ${DIR}/out.exr)
+  message(FATAL_ERROR "gpuip-run did not write ${DIR}/out.exr")
+endif()
+
+gpuip_run_test_command(${RUN} -f ${IP} --frames 1-2
+  -i buffer1 "${DIR}/a_####.exr" -i buffer2 "${DIR}/b_%04d.exr"
+  -o buffer3 "${DIR}/out_####.exr")
+foreach(_frame 0001 0002)
+  if(NOT EXISTS ${DIR}/out_${_frame}.exr)
+    message(FATAL_ERROR "gpuip-run did not write ${DIR}/out_${_frame}.exr")
+  endif()
+endforeach()
@@ -0,0 +1,96 @@
+# The MIT License (MIT)
+# 
+# Copyright (c) 2014 Per Karlsson
+# 
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+# 
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+# Runs gpuipd on a temporary socket and sends it jobs with gpuip-submit and
+# frames in shared memory with test_gpuipd. Called by ctest with GPUIPD,
+# SUBMIT, SYNTH, CLIENT, IP (an example *.ip file with buffers buffer1,
+# buffer2 -> buffer3) and DIR. The script runs gpuipd and, next to it, itself
+# with STEPS set, which talks to gpuipd and shuts it down when done.
+
+if(NOT STEPS)
+  file(REMOVE_RECURSE ${DIR})
+  file(MAKE_DIRECTORY ${DIR})
+  # Socket paths are short, so the socket is in /tmp rather than in DIR
+  string(RANDOM LENGTH 8 _id)
+  set(SOCKET /tmp/gpuipd-test-${_id}.sock)
+  # The commands of execute_process run at the same time, the result is the
+  # one of the steps. A hanging gpuipd is killed by the timeout.
+  execute_process(
+    COMMAND ${GPUIPD} -s ${SOCKET} ${IP}
+    COMMAND ${CMAKE_COMMAND} -DSTEPS=1 -DSOCKET=${SOCKET}
+      -DSUBMIT=${SUBMIT} -DSYNTH=${SYNTH} -DCLIENT=${CLIENT} -DDIR=${DIR}
+      -P ${CMAKE_CURRENT_LIST_FILE}
+    RESULT_VARIABLE _result
+    TIMEOUT 120)
+  if(NOT _result EQUAL 0)
+    message(FATAL_ERROR "gpuipd test failed (${_result})")
+  endif()
+  return()
+endif()
+
+# Stops gpuipd before failing, so that the test does not wait for it
+macro(gpuipd_test_fail _message)
+  execute_process(COMMAND ${SUBMIT} -s ${SOCKET} --shutdown)
+  message(FATAL_ERROR ${_message})
+endmacro()
+
+macro(gpuipd_test_command)
+  execute_process(COMMAND ${ARGN} RESULT_VARIABLE _result)
+  if(NOT _result EQUAL 0)
+    gpuipd_test_fail("Failed (${_result}): ${ARGN}")
+  endif()
+endmacro()
+
+# gpuipd answers ping once it has loaded the pipeline
+set(_up FALSE)
+foreach(_try RANGE 300)
+  execute_process(COMMAND ${SUBMIT} -s ${SOCKET} --ping
+    RESULT_VARIABLE _result OUTPUT_QUIET ERROR_QUIET)
+  if(_result EQUAL 0)
+    set(_up TRUE)
+    break()
+  endif()
+  execute_process(COMMAND ${CMAKE_COMMAND} -E sleep 0.2)
+endforeach()
+if(NOT _up)
+  gpuipd_test_fail("gpuipd did not answer ping on ${SOCKET}")
+endif()
+
+gpuipd_test_command(${SYNTH} -s 64x48 --seed 1 ${DIR}/a.exr)
+gpuipd_test_command(${SYNTH} -s 64x48 --seed 2 ${DIR}/b.exr)
+
+gpuipd_test_command(${SUBMIT} -s ${SOCKET} -p lerp alpha 0.5
+  -i buffer1 ${DIR}/a.exr -i buffer2 ${DIR}/b.exr -o buffer3 ${DIR}/out.exr)
+if(NOT EXISTS ${DIR}/out.exr)
+  gpuipd_test_fail("gpuipd did not write ${DIR}/out.exr")
+endif()
+
+execute_process(COMMAND ${SUBMIT} -s ${SOCKET}
+  -i buffer1 ${DIR}/a.exr -i buffer4 ${DIR}/b.exr -o buffer3 ${DIR}/out.exr
+  RESULT_VARIABLE _result ERROR_QUIET)
+if(_result EQUAL 0)
+  gpuipd_test_fail("gpuipd ran a job with a missing buffer")
+endif()
+
+gpuipd_test_command(${CLIENT} ${SOCKET})
+
+gpuipd_test_command(${SUBMIT} -s ${SOCKET} --shutdown)
@@ -1,7 +1,12 @@
 #include <gpuip.h>
+#include <gpuip_synthetic.h>
+// The tests are asserts, keep them in release builds
+#undef NDEBUG
 #include <cassert>
 #include <stdlib.h>
 #include <math.h>
+#include <algorithm>
+#include <vector>
 //----------------------------------------------------------------------------//
 const char * opencl_codeA = ""
 " __kernel void                                                              \n"
@@ -99,6 +104,88 @@ const char * opencl_boilerplateB = ""
 "    A[idx] = 0;\n"
 "}";
 //----------------------------------------------------------------------------//
+const char * opencl_image_code = ""
+"__constant sampler_t sampler = CLK_NORMALIZED_COORDS_FALSE |                \n"
+"                               CLK_ADDRESS_CLAMP_TO_EDGE |                   \n"
+"                               CLK_FILTER_NEAREST;                           \n"
+"__kernel void                                                               \n"
+"my_kernelImage(__read_only image2d_t A_image,                               \n"
+"               __write_only image2d_t B_image,                              \n"
+"               const int width,                                             \n"
+"               const int height)                                            \n"
+"{                                                                           \n"
+"    const int x = get_global_id(0);                                         \n"
+"    const int y = get_global_id(1);                                         \n"
+"    if (x >= width || y >= height) {                                        \n"
+"        return;                                                             \n"
+"    }                                                                       \n"
+"    // right neighbour is clamped to the edge of the image                  \n"
+"    const float4 A = read_imagef(A_image, sampler, (int2)(x + 1, y));       \n"
+"    write_imagef(B_image, (int2)(x, y), A * 2);                             \n"
+"}";
+const char * opencl_image_boilerplate = ""
+"__constant sampler_t sampler = CLK_NORMALIZED_COORDS_FALSE |\n"
+"                               CLK_ADDRESS_CLAMP_TO_EDGE |\n"
+"                               CLK_FILTER_NEAREST;\n"
+"\n"
+"__kernel void\n"
+"my_kernelImage(__read_only image2d_t A_image,\n"
+"               __write_only image2d_t B_image,\n"
+"               const int width,\n"
+"               const int height)\n"
+"{\n"
+"    const int x = get_global_id(0);\n"
+"    const int y = get_global_id(1);\n"
+"\n"
+"    // array index\n"
+"    const int idx = x + width * y;\n"
+"\n"
+"    // inside image bounds check\n"
+"    if (x >= width || y >= height) {\n"
+"        return;\n"
+"    }\n"
+"\n"
+"    // image reads (neighbours are read the same way)\n"
+"    const float4 A = read_imagef(A_image, sampler, (int2)(x, y));\n"
+"\n"
+"    // kernel code\n"
+"    float4 B = (float4)(0, 0, 0, 0);\n"
+"\n"
+"    // image writes\n"
+"    write_imagef(B_image, (int2)(x, y), B);\n"
+"}";
+//----------------------------------------------------------------------------//
+const char * opencl_stencil_code = ""
+"#define RADIUS 1                                                            \n"
+"#define TILE 16                                                             \n"
+"__kernel void                                                               \n"
+"my_kernelStencil(__global const float * A,                                  \n"
+"                 __global float * B,                                        \n"
+"                 const int width,                                           \n"
+"                 const int height)                                          \n"
+"{                                                                           \n"
+"    const int x = get_global_id(0);                                         \n"
+"    const int y = get_global_id(1);                                         \n"
+"    __local float A_tile[TILE + 2 * RADIUS][TILE + 2 * RADIUS];             \n"
+"    const int lx = get_local_id(0);                                         \n"
+"    const int ly = get_local_id(1);                                         \n"
+"    for (int j = ly; j < TILE + 2 * RADIUS; j += TILE) {                    \n"
+"        for (int i = lx; i < TILE + 2 * RADIUS; i += TILE) {                \n"
+"            const int gx = clamp(x - lx - RADIUS + i, 0, width - 1);        \n"
+"            const int gy = clamp(y - ly - RADIUS + j, 0, height - 1);       \n"
+"            A_tile[j][i] = A[gx + width * gy];                              \n"
+"        }                                                                   \n"
+"    }                                                                       \n"
+"    barrier(CLK_LOCAL_MEM_FENCE);                                           \n"
+"    if (x >= width || y >= height) {                                        \n"
+"        return;                                                             \n"
+"    }                                                                       \n"
+"    // sum of the left, center and bottom pixels                            \n"
+"    B[x + width * y] = A_tile[ly + RADIUS][lx + RADIUS - 1] +               \n"
+"                       A_tile[ly + RADIUS][lx + RADIUS] +                   \n"
+"                       A_tile[ly + RADIUS + 1][lx + RADIUS];                \n"
+"}";
+//----------------------------------------------------------------------------//
 const char * cuda_codeA = ""
 "__global__ void                                                             \n"
 "my_kernelA(const float * A,                                                 \n"
@@ -249,6 +336,47 @@ const char * glsl_boilerplateB = ""
 "    gl_FragData[0] = vec4(0,0,0,1);\n"
 "}";
 //----------------------------------------------------------------------------//
+const char * glsl_compute_code = ""
+"#version 430\n"
+"#define TILE 16\n"
+"layout(local_size_x = TILE, local_size_y = TILE) in;                       \n"
+"layout(r32f) readonly uniform image2D A;                                   \n"
+"layout(r32f) writeonly uniform image2D B;                                  \n"
+"uniform float incB;                                                        \n"
+"uniform int width;                                                         \n"
+"uniform int height;                                                        \n"
+"\n"
+"void main()                                                                \n"
+"{                                                                          \n"
+"    ivec2 x = ivec2(gl_GlobalInvocationID.xy);                             \n"
+"    if (x.x >= width || x.y >= height) {                                   \n"
+"        return;                                                            \n"
+"    }                                                                      \n"
+"    imageStore(B, x, imageLoad(A, x) * 2 + incB);                          \n"
+"}";
+const char * glsl_compute_boilerplate = ""
+"#version 430\n"
+"#define TILE 16\n"
+"layout(local_size_x = TILE, local_size_y = TILE) in;\n"
+"layout(r32f) readonly uniform image2D A;\n"
+"layout(r32f) writeonly uniform image2D B;\n"
+"uniform float incB;\n"
+"uniform int width;\n"
+"uniform int height;\n"
+"\n"
+"void main()\n"
+"{\n"
+"    ivec2 x = ivec2(gl_GlobalInvocationID.xy);\n"
+"\n"
+"    // inside image bounds check\n"
+"    if (x.x >= width || x.y >= height) {\n"
+"        return;\n"
+"    }\n"
+"\n"
+"    // imageStore to buffer B\n"
+"    imageStore(B, x, vec4(0,0,0,1));\n"
+"}";
+//----------------------------------------------------------------------------//
 inline bool equal(float a, float b)
 {
     return fabs(a-b) < 0.001;
@@ -306,7 +434,7 @@ void test(gpuip::GpuEnvironment env, const char * codeA, const char * codeB,
     for(size_t i = 0; i < data_in.size(); ++i) {
         data_in[i] = i;
     }
-    assert(ip->Copy(b1, gpuip::Buffer::WRITE_DATA,
+    assert(ip->Copy(b1, gpuip::Buffer::COPY_TO_GPU,
                    data_in.data(), &err) >= 0);
 
     assert(ip->Build(&err) >= 0);
@@ -315,9 +443,9 @@ void test(gpuip::GpuEnvironment env, const char * codeA, const char * codeB,
     assert(ip->Run(&err) >= 0);
     
     std::vector<float> data_outA(N), data_outB(N), data_outC(N);
-    assert(ip->Copy(b1, gpuip::Buffer::READ_DATA,data_outA.data(),&err) >= 0);
-    assert(ip->Copy(b2, gpuip::Buffer::READ_DATA,data_outB.data(),&err) >= 0);
-    assert(ip->Copy(b3, gpuip::Buffer::READ_DATA,data_outC.data(),&err) >= 0);
+    assert(ip->Copy(b1, gpuip::Buffer::COPY_FROM_GPU,data_outA.data(),&err) >= 0);
+    assert(ip->Copy(b2, gpuip::Buffer::COPY_FROM_GPU,data_outB.data(),&err) >= 0);
+    assert(ip->Copy(b3, gpuip::Buffer::COPY_FROM_GPU,data_outC.data(),&err) >= 0);
 
     for(unsigned int i = 0; i < N; ++i) {
         // Check first kernel call, where B = A + 0.2, C = A + 0.25
@@ -327,17 +455,466 @@ void test(gpuip::GpuEnvironment env, const char * codeA, const char * codeB,
         // Check second kernel call, where A = B + C
         assert(equal(data_outA[i], data_outB[i] + data_outC[i]));
     }
+
+    // Kernel times follow the kernels, if the environment measures them
+    assert(ip->KernelTimes().empty() || ip->KernelTimes().size() == 2);
+
+    // Traffic of each kernel is the size of its bound buffers
+    const std::vector<gpuip::KernelReport> reports = ip->KernelReports();
+    assert(reports.size() == 2);
+    assert(reports[0].name == kernelA->name);
+    assert(reports[0].bytesRead == N * 4 && reports[0].bytesWritten == N * 8);
+    assert(reports[1].bytesRead == N * 8 && reports[1].bytesWritten == N * 4);
+    assert(reports[0].flops == 0 && reports[0].Intensity() == 0);
+    assert(ip->PeakBandwidth() >= 0);
+
+    // Sizes of 2^32 bytes and more do not wrap, nothing is allocated here
+    gpuip::ImageProcessor::Ptr large(gpuip::ImageProcessor::Create(env));
+    large->SetDimensions(16384, 16384);
+    gpuip::Kernel::Ptr copy = large->CreateKernel("copy");
+    copy->inBuffers.push_back(gpuip::Kernel::BufferLink(
+        large->CreateBuffer("in", gpuip::Buffer::FLOAT, 4), "in"));
+    copy->flopsPerPixel = 1;
+    assert(large->KernelReports()[0].bytesRead == 4294967296.0);
+    assert(large->KernelReports()[0].flops == 268435456.0);
+
+    // Copying in bands of rows gives the same data as a full copy
+    std::vector<float> data_rows(N);
+    for(unsigned int y = 0; y < height; y += 3) {
+        const unsigned int y1 = std::min(y + 3, height);
+        assert(ip->CopyRows(b2, gpuip::Buffer::COPY_FROM_GPU,
+                            &data_rows[y * width], y, y1, &err) >= 0);
+    }
+    assert(data_rows == data_outB);
+    assert(ip->CopyRows(b2, gpuip::Buffer::COPY_FROM_GPU, data_rows.data(),
+                        0, height + 1, &err) == GPUIP_ERROR);
+    err.clear();
+
+    // Without timing every call reports zero time
+    ip->SetTiming(false);
+    assert(!ip->Timing());
+    assert(ip->Run(&err) == 0);
+    assert(ip->KernelTimes().empty());
+    assert(ip->Copy(b1, gpuip::Buffer::COPY_FROM_GPU,
+                    data_outA.data(), &err) == 0);
+    std::cout << "Test passed!" << std::endl;
+}
+//----------------------------------------------------------------------------//
+void test_devices(gpuip::GpuEnvironment env)
+{
+    // Create without a device keeps the device the environment used to pick
+    const gpuip::Device device = gpuip::ImageProcessor::DefaultDevice(env);
+    assert(device.type == gpuip::Device::GPU);
+    assert(device.index == (env == gpuip::CUDA ? GPUIP_FASTEST_DEVICE : 0));
+    if (!gpuip::ImageProcessor::CanCreate(env)) {
+        return;
+    }
+
+    // Every listed device should be possible to create a processor on
+    const std::vector<gpuip::Device> devices =
+            gpuip::ImageProcessor::ListDevices(env);
+    for(size_t i = 0; i < devices.size(); ++i) {
+        std::cout << "Device: " << devices[i].name
+                  << " (" << devices[i].platformName << ")" << std::endl;
+        gpuip::ImageProcessor::Ptr ip(
+            gpuip::ImageProcessor::Create(env, devices[i]));
+        assert(ip.get() != NULL);
+    }
+}
+//----------------------------------------------------------------------------//
+void test_opencl_images()
+{
+    if (!gpuip::ImageProcessor::CanCreate(gpuip::OpenCL)) {
+        return;
+    }
+    std::cout << "Testing OpenCL images..." << std::endl;
+
+    const unsigned int width = 4;
+    const unsigned int height = 4;
+    const unsigned int N = width * height * 4;
+    gpuip::ImageProcessor::Ptr ip(gpuip::ImageProcessor::Create(gpuip::OpenCL));
+    ip->SetDimensions(width, height);
+
+    gpuip::Buffer::Ptr b1 = ip->CreateBuffer("b1", gpuip::Buffer::FLOAT, 4);
+    gpuip::Buffer::Ptr b2 = ip->CreateBuffer("b2", gpuip::Buffer::FLOAT, 4);
+    b1->storage = gpuip::Buffer::IMAGE;
+    b2->storage = gpuip::Buffer::IMAGE;
+
+    gpuip::Kernel::Ptr kernel = ip->CreateKernel("my_kernelImage");
+    kernel->code = opencl_image_code;
+    kernel->inBuffers.push_back(gpuip::Kernel::BufferLink(b1,"A"));
+    kernel->outBuffers.push_back(gpuip::Kernel::BufferLink(b2,"B"));
+    assert(ip->BoilerplateCode(kernel) == std::string(opencl_image_boilerplate));
+
+    std::string err;
+    assert(ip->Allocate(&err) >= 0);
+    std::vector<float> data_in(N), data_out(N);
+    for(size_t i = 0; i < data_in.size(); ++i) {
+        data_in[i] = i;
+    }
+    assert(ip->Copy(b1, gpuip::Buffer::COPY_TO_GPU,
+                    data_in.data(), &err) >= 0);
+    assert(ip->Build(&err) >= 0);
+    assert(ip->Run(&err) >= 0);
+    assert(ip->Copy(b2, gpuip::Buffer::COPY_FROM_GPU,
+                    data_out.data(), &err) >= 0);
+
+    for(unsigned int y = 0; y < height; ++y) {
+        for(unsigned int x = 0; x < width; ++x) {
+            const unsigned int xn = std::min(x + 1, width - 1);
+            for(unsigned int c = 0; c < 4; ++c) {
+                assert(equal(data_out[4 * (x + width * y) + c],
+                             2 * data_in[4 * (xn + width * y) + c]));
+            }
+        }
+    }
     std::cout << "Test passed!" << std::endl;
 }
 //----------------------------------------------------------------------------//
+void test_opencl_stencil()
+{
+    if (!gpuip::ImageProcessor::CanCreate(gpuip::OpenCL)) {
+        return;
+    }
+    std::cout << "Testing OpenCL tiled stencil..." << std::endl;
+
+    // Not a multiple of the tile size, so that the edges of the work groups
+    // and the image are both tested
+    const unsigned int width = 37;
+    const unsigned int height = 21;
+    const unsigned int N = width * height;
+    gpuip::ImageProcessor::Ptr ip(gpuip::ImageProcessor::Create(gpuip::OpenCL));
+    ip->SetDimensions(width, height);
+
+    gpuip::Buffer::Ptr b1 = ip->CreateBuffer("b1", gpuip::Buffer::FLOAT, 1);
+    gpuip::Buffer::Ptr b2 = ip->CreateBuffer("b2", gpuip::Buffer::FLOAT, 1);
+    gpuip::Kernel::Ptr kernel = ip->CreateKernel("my_kernelStencil");
+    kernel->code = opencl_stencil_code;
+    kernel->radius = 1;
+    kernel->inBuffers.push_back(gpuip::Kernel::BufferLink(b1,"A"));
+    kernel->outBuffers.push_back(gpuip::Kernel::BufferLink(b2,"B"));
+
+    std::string err;
+    assert(ip->Allocate(&err) >= 0);
+    std::vector<float> data_in(N), data_out(N);
+    for(size_t i = 0; i < data_in.size(); ++i) {
+        data_in[i] = i;
+    }
+    assert(ip->Copy(b1, gpuip::Buffer::COPY_TO_GPU,
+                    data_in.data(), &err) >= 0);
+    assert(ip->Build(&err) >= 0);
+    assert(ip->Run(&err) >= 0);
+    assert(ip->Copy(b2, gpuip::Buffer::COPY_FROM_GPU,
+                    data_out.data(), &err) >= 0);
+
+    for(unsigned int y = 0; y < height; ++y) {
+        for(unsigned int x = 0; x < width; ++x) {
+            const unsigned int xl = x > 0 ? x - 1 : 0;
+            const unsigned int yb = std::min(y + 1, height - 1);
+            assert(equal(data_out[x + width * y],
+                         data_in[xl + width * y] + data_in[x + width * y] +
+                         data_in[x + width * yb]));
+        }
+    }
+    std::cout << "Test passed!" << std::endl;
+}
+//----------------------------------------------------------------------------//
+void test_boilerplate_stencil(gpuip::GpuEnvironment env)
+{
+    if (!gpuip::ImageProcessor::CanCreate(env)) {
+        return;
+    }
+    std::cout << "Testing " << (env == gpuip::OpenCL ? "OpenCL" : "CUDA")
+              << " tiled stencil boilerplate..." << std::endl;
+
+    const unsigned int width = 37;
+    const unsigned int height = 21;
+    const unsigned int N = width * height;
+    gpuip::ImageProcessor::Ptr ip(gpuip::ImageProcessor::Create(env));
+    ip->SetDimensions(width, height);
+
+    gpuip::Buffer::Ptr b1 = ip->CreateBuffer("b1", gpuip::Buffer::FLOAT, 1);
+    gpuip::Buffer::Ptr b2 = ip->CreateBuffer("b2", gpuip::Buffer::FLOAT, 1);
+    gpuip::Kernel::Ptr kernel = ip->CreateKernel("my_kernelBoilerplate");
+    kernel->radius = 1;
+    kernel->inBuffers.push_back(gpuip::Kernel::BufferLink(b1,"A"));
+    kernel->outBuffers.push_back(gpuip::Kernel::BufferLink(b2,"B"));
+
+    // Generated tile code with the stencil written in place of the output
+    // initialization
+    std::string code = ip->BoilerplateCode(kernel);
+    assert(code.find("A_tile[TILE + 2 * RADIUS][TILE + 2 * RADIUS]") !=
+           std::string::npos);
+    const std::string init = "B[idx] = 0;";
+    const size_t pos = code.find(init);
+    assert(pos != std::string::npos);
+    code.replace(pos, init.size(),
+                 "B[idx] = A_tile[ly + RADIUS][lx + RADIUS - 1] +\n"
+                 "             A_tile[ly + RADIUS][lx + RADIUS] +\n"
+                 "             A_tile[ly + RADIUS + 1][lx + RADIUS];");
+    kernel->code = code;
+
+    std::string err;
+    assert(ip->Allocate(&err) >= 0);
+    std::vector<float> data_in(N), data_out(N);
+    for(size_t i = 0; i < data_in.size(); ++i) {
+        data_in[i] = i;
+    }
+    assert(ip->Copy(b1, gpuip::Buffer::COPY_TO_GPU,
+                    data_in.data(), &err) >= 0);
+    assert(ip->Build(&err) >= 0);
+    assert(ip->Run(&err) >= 0);
+    assert(ip->Copy(b2, gpuip::Buffer::COPY_FROM_GPU,
+                    data_out.data(), &err) >= 0);
+
+    for(unsigned int y = 0; y < height; ++y) {
+        for(unsigned int x = 0; x < width; ++x) {
+            const unsigned int xl = x > 0 ? x - 1 : 0;
+            const unsigned int yb = std::min(y + 1, height - 1);
+            assert(equal(data_out[x + width * y],
+                         data_in[xl + width * y] + data_in[x + width * y] +
+                         data_in[x + width * yb]));
+        }
+    }
+
+    // A tile that can not fit local/shared memory is rejected by Build
+    kernel->radius = 1000;
+    kernel->code = ip->BoilerplateCode(kernel);
+    err.clear();
+    assert(ip->Build(&err) == GPUIP_ERROR);
+    assert(err.find("radius 1000") != std::string::npos);
+    std::cout << "Test passed!" << std::endl;
+}
+//----------------------------------------------------------------------------//
+// Runs two chained radius 1 stencils, b1 -> b2 -> b3, on the devices and
+// returns b2 and b3. The input is uploaded and the output downloaded in
+// bands of rows that do not follow the bands of the devices.
+void run_opencl_stencils(const std::vector<gpuip::Device> & devices,
+                         unsigned int width,
+                         unsigned int height,
+                         int runs,
+                         std::vector<float> * out2,
+                         std::vector<float> * out3)
+{
+    gpuip::ImageProcessor::Ptr ip(
+        gpuip::ImageProcessor::Create(gpuip::OpenCL, devices));
+    ip->SetDimensions(width, height);
+    gpuip::Buffer::Ptr b1 = ip->CreateBuffer("b1", gpuip::Buffer::FLOAT, 1);
+    gpuip::Buffer::Ptr b2 = ip->CreateBuffer("b2", gpuip::Buffer::FLOAT, 1);
+    gpuip::Buffer::Ptr b3 = ip->CreateBuffer("b3", gpuip::Buffer::FLOAT, 1);
+    std::string code2 = opencl_stencil_code;
+    code2.replace(code2.find("my_kernelStencil"), 16, "my_kernelStencil2");
+    gpuip::Kernel::Ptr k1 = ip->CreateKernel("my_kernelStencil");
+    k1->code = opencl_stencil_code;
+    k1->radius = 1;
+    k1->inBuffers.push_back(gpuip::Kernel::BufferLink(b1,"A"));
+    k1->outBuffers.push_back(gpuip::Kernel::BufferLink(b2,"B"));
+    gpuip::Kernel::Ptr k2 = ip->CreateKernel("my_kernelStencil2");
+    k2->code = code2;
+    k2->radius = 1;
+    k2->inBuffers.push_back(gpuip::Kernel::BufferLink(b2,"A"));
+    k2->outBuffers.push_back(gpuip::Kernel::BufferLink(b3,"B"));
+
+    std::string err;
+    assert(ip->Allocate(&err) >= 0);
+    assert(ip->Build(&err) >= 0);
+    const unsigned int N = width * height;
+    std::vector<float> data_in(N);
+    for(size_t i = 0; i < data_in.size(); ++i) {
+        data_in[i] = (i * 7) % 13;
+    }
+    const unsigned int split = height / 3;
+    assert(ip->CopyRows(b1, gpuip::Buffer::COPY_TO_GPU, &data_in[0],
+                        0, split, &err) >= 0);
+    assert(ip->CopyRows(b1, gpuip::Buffer::COPY_TO_GPU,
+                        &data_in[split * width], split, height, &err) >= 0);
+
+    // Later runs balance the bands by the measured throughput
+    out2->assign(N, 0);
+    out3->assign(N, 0);
+    for(int r = 0; r < runs; ++r) {
+        assert(ip->Run(&err) >= 0);
+        assert(ip->Copy(b2, gpuip::Buffer::COPY_FROM_GPU, &(*out2)[0],
+                        &err) >= 0);
+        for(unsigned int y = 0; y < height; y += 5) {
+            const unsigned int y1 = std::min(y + 5, height);
+            assert(ip->CopyRows(b3, gpuip::Buffer::COPY_FROM_GPU,
+                                &(*out3)[y * width], y, y1, &err) >= 0);
+        }
+    }
+}
+//----------------------------------------------------------------------------//
+void test_opencl_multi_device()
+{
+    if (!gpuip::ImageProcessor::CanCreate(gpuip::OpenCL) ||
+        gpuip::ImageProcessor::ListDevices(gpuip::OpenCL).empty()) {
+        return;
+    }
+    std::cout << "Testing OpenCL on several devices..." << std::endl;
+
+    // The same device twice gives two bands that meet mid-image, away from
+    // the edges of the 16x16 work groups
+    const gpuip::Device device =
+            gpuip::ImageProcessor::ListDevices(gpuip::OpenCL).front();
+    const unsigned int width = 37;
+    const unsigned int height = 45;
+    std::vector<float> single2, single3, multi2, multi3;
+    run_opencl_stencils(std::vector<gpuip::Device>(1, device), width, height,
+                        1, &single2, &single3);
+    run_opencl_stencils(std::vector<gpuip::Device>(2, device), width, height,
+                        3, &multi2, &multi3);
+
+    // Left, center and bottom pixels of the first stencil
+    for(unsigned int y = 0; y < height; ++y) {
+        for(unsigned int x = 0; x < width; ++x) {
+            const unsigned int xl = x > 0 ? x - 1 : 0;
+            const unsigned int yb = std::min(y + 1, height - 1);
+            const float in = (x + width * y) * 7 % 13;
+            const float left = (xl + width * y) * 7 % 13;
+            const float bottom = (x + width * yb) * 7 % 13;
+            assert(equal(single2[x + width * y], left + in + bottom));
+        }
+    }
+    for(unsigned int i = 0; i < width * height; ++i) {
+        assert(equal(multi2[i], single2[i]));
+        assert(equal(multi3[i], single3[i]));
+    }
+    std::cout << "Test passed!" << std::endl;
+}
+//----------------------------------------------------------------------------//
+void test_glsl_compute()
+{
+    if (!gpuip::ImageProcessor::CanCreate(gpuip::GLSL)) {
+        return;
+    }
+    std::cout << "Testing GLSL compute shaders..." << std::endl;
+
+    const unsigned int width = 37;
+    const unsigned int height = 21;
+    const unsigned int N = width * height;
+    gpuip::ImageProcessor::Ptr ip(
+        gpuip::ImageProcessor::CreateGLSL(gpuip::COMPUTE_SHADER));
+    ip->SetDimensions(width, height);
+
+    gpuip::Buffer::Ptr b1 = ip->CreateBuffer("b1", gpuip::Buffer::FLOAT, 1);
+    gpuip::Buffer::Ptr b2 = ip->CreateBuffer("b2", gpuip::Buffer::FLOAT, 1);
+    gpuip::Kernel::Ptr kernel = ip->CreateKernel("my_kernelCompute");
+    kernel->code = glsl_compute_code;
+    kernel->inBuffers.push_back(gpuip::Kernel::BufferLink(b1,"A"));
+    kernel->outBuffers.push_back(gpuip::Kernel::BufferLink(b2,"B"));
+    const gpuip::Parameter<float> incB("incB", 0.25);
+    kernel->paramsFloat.push_back(incB);
+    assert(ip->BoilerplateCode(kernel) ==
+           std::string(glsl_compute_boilerplate));
+
+    // Compute shaders need OpenGL 4.3
+    std::string err;
+    if (ip->Allocate(&err) < 0) {
+        std::cout << err << "Test skipped!" << std::endl;
+        return;
+    }
+    std::vector<float> data_in(N), data_out(N);
+    for(size_t i = 0; i < data_in.size(); ++i) {
+        data_in[i] = i;
+    }
+    assert(ip->Copy(b1, gpuip::Buffer::COPY_TO_GPU,
+                    data_in.data(), &err) >= 0);
+    assert(ip->Build(&err) >= 0);
+    assert(ip->Run(&err) >= 0);
+    assert(ip->Copy(b2, gpuip::Buffer::COPY_FROM_GPU,
+                    data_out.data(), &err) >= 0);
+
+    for(unsigned int i = 0; i < N; ++i) {
+        assert(equal(data_out[i], data_in[i] * 2 + incB.value));
+    }
+    std::cout << "Test passed!" << std::endl;
+}
+//----------------------------------------------------------------------------//
+void test_synthetic()
+{
+    using namespace gpuip::synthetic;
+    const unsigned int w = 67, h = 45;
+    const gpuip::Buffer::Type types[] = {
+        gpuip::Buffer::UNSIGNED_BYTE, gpuip::Buffer::HALF,
+        gpuip::Buffer::FLOAT };
+    const unsigned int sizes[] = { 1, 2, 4 };
+    const Pattern patterns[] = { NOISE, GRADIENT, CHECKERBOARD, NATURAL };
+    std::string error;
+    for(int t = 0; t < 3; ++t) {
+        for(unsigned int c = 1; c <= 4; ++c) {
+            for(int p = 0; p < 4; ++p) {
+                Pattern parsed;
+                assert(ParsePattern(PatternName(patterns[p]), &parsed));
+                assert(parsed == patterns[p]);
+
+                // Same arguments give the same image
+                const size_t n = w * h * c;
+                std::vector<unsigned char> a(n * sizes[t]), b(a.size());
+                assert(Generate(&a[0], types[t], c, w, h, patterns[p], 7,
+                                &error));
+                assert(Generate(&b[0], types[t], c, w, h, patterns[p], 7,
+                                &error));
+                assert(a == b);
+
+                // Values are in [0, 1]
+                if (types[t] == gpuip::Buffer::FLOAT) {
+                    const float * f = (const float *)&a[0];
+                    for(size_t i = 0; i < n; ++i) {
+                        assert(f[i] >= 0 && f[i] <= 1);
+                    }
+                } else if (types[t] == gpuip::Buffer::HALF) {
+                    const unsigned short * s = (const unsigned short *)&a[0];
+                    for(size_t i = 0; i < n; ++i) {
+                        assert(s[i] <= 0x3c00); // 1.0, no sign bit
+                    }
+                }
+
+                // Noise depends on the seed
+                if (patterns[p] == NOISE || patterns[p] == NATURAL) {
+                    assert(Generate(&b[0], types[t], c, w, h, patterns[p], 8,
+                                    &error));
+                    assert(a != b);
+                }
+            }
+        }
+    }
+
+    // Exact values of the checkerboard and the gradient ends
+    std::vector<unsigned char> data(w * h * 4);
+    assert(Generate(&data[0], gpuip::Buffer::UNSIGNED_BYTE, 4, w, h,
+                    CHECKERBOARD, 1, &error));
+    assert(data[0] == 0 && data[3] == 0);
+    assert(data[4 * 32] == 255);
+    assert(data[4 * (32 * w + 32)] == 0);
+    std::vector<float> f(w * h * 4);
+    assert(Generate(&f[0], gpuip::Buffer::FLOAT, 4, w, h, GRADIENT, 1,
+                    &error));
+    const size_t last = 4 * (w * h - 1);
+    assert(f[0] == 0 && f[1] == 0 && f[2] == 0 && f[3] == 1);
+    assert(f[last] == 1 && f[last + 1] == 1 && f[last + 2] == 1 &&
+           f[last + 3] == 0);
+    assert(error.empty());
+}
+//----------------------------------------------------------------------------//
 int main()
 {
+    test_synthetic();
+
+    test_devices(gpuip::OpenCL);
+    test_devices(gpuip::CUDA);
+
     test(gpuip::OpenCL, opencl_codeA, opencl_codeB,
          opencl_boilerplateA, opencl_boilerplateB);
+    test_opencl_images();
+    test_opencl_stencil();
+    test_boilerplate_stencil(gpuip::OpenCL);
+    test_opencl_multi_device();
     test(gpuip::CUDA, cuda_codeA, cuda_codeB,
          cuda_boilerplateA, cuda_boilerplateB);
+    test_boilerplate_stencil(gpuip::CUDA);
     test(gpuip::GLSL, glsl_codeA, glsl_codeB,
          glsl_boilerplateA, glsl_boilerplateB);
+    test_glsl_compute();
     return 0;
 }
 //----------------------------------------------------------------------------//
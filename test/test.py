@@ -1,5 +1,7 @@
 import pygpuip
 import numpy
+import os
+import tempfile
 
 opencl_codeA = """
  __kernel void
@@ -314,6 +316,58 @@ def test(env, codeA, codeB, boilerplateA, boilerplateB):
             assert eq(b2[i][j], indata[i][j] + incB)
 
             assert eq(b0[i][j], b1[i][j] + b2[i][j])
+
+    # Copies straight into caller owned arrays and host memory
+    out = numpy.empty((width,height,1), dtype = numpy.float32)
+    assert ip.ReadBufferFromGPU(buffers[1], out) == no_error
+    assert (out == b1).all()
+    staging = ip.AllocateHostMemory(buffers[1])
+    assert staging.shape == (width,height,1)
+    assert ip.ReadBufferFromGPU(buffers[1], staging) == no_error
+    assert (staging == b1).all()
+    assert ip.WriteBufferToGPU(buffers[0], indata) == no_error
+    assert ip.ReadBufferFromGPU(buffers[1], numpy.empty(1)) != no_error
+
+    # Float exr channels are written and read in place without rounding
+    exr = os.path.join(tempfile.mkdtemp(), "test.exr")
+    assert buffers[1].Write(exr, 1, ["Z"]) == no_error
+    assert buffers[2].Read(exr, 1, ["Z"]) == no_error
+    assert (buffers[2].data == b1).all()
+    assert buffers[2].Read(exr, 1) == no_error # no Y channel, filled with 0
+    assert (buffers[2].data == 0).all()
+    options = pygpuip.ExrOptions()
+    options.compression = pygpuip.ExrCompression.NONE
+    options.lineOrder = pygpuip.ExrLineOrder.DECREASING_Y
+    options.chunkRows = 3
+    assert buffers[1].Write(exr, 2, ["Z"], options) == no_error
+    assert buffers[2].Read(exr, 1, ["Z"]) == no_error
+    assert (buffers[2].data == b1).all()
+
+    # Arrays that are not width x height x channels in C order are not written
+    data = buffers[1].data
+    buffers[1].data = data[::2]
+    assert buffers[1].Write(exr) != no_error
+    buffers[1].data = data.reshape(width, height)
+    assert buffers[1].Write(exr) != no_error
+    buffers[1].data = data
+
+    # Streaming decodes the file in bands straight to the gpu
+    assert ip.StreamBufferToGPU(buffers[2], exr, 2, ["Z"]) == no_error
+    assert ip.ReadBufferFromGPU(buffers[2]) == no_error
+    assert (buffers[2].data == b1).all()
+    assert buffers[2].Read(exr + ".missing.exr") != no_error
+    os.remove(exr)
+
+    # Timing of the latest call and cumulative stats
+    assert ip.Run() == no_error
+    assert ip.timing.operation == "Run"
+    assert len(ip.timing.kernels) in (0, 2)
+    stats = ip.stats
+    assert stats.allocations == 2 and stats.builds == 2 and stats.runs == 2
+    assert stats.errors == 1
+    assert stats.bytesUploaded == 3 * N * 4
+    ip.ResetStats()
+    assert ip.stats.runs == 0
     print "Test passed!\n"
 
 if __name__ == '__main__':
@@ -0,0 +1,161 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Per Karlsson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Client of gpuipd that hands frames over in shared memory, run by
+// gpuipd.cmake. The argument is the socket of a gpuipd that serves a single
+// lerp example, which blends the half RGBA buffers buffer1 and buffer2 into
+// buffer3 by the param alpha.
+#include <gpuipd_client.h>
+// The tests are asserts, keep them in release builds
+#undef NDEBUG
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <vector>
+//----------------------------------------------------------------------------//
+const unsigned int width = 40;
+const unsigned int height = 30;
+const size_t values = width * height * 4;
+const size_t imageBytes = values * 2; // half
+// Halfs 0.25 and 0.75, blended exactly by alpha 0 and 1
+const unsigned short halfA = 0x3400;
+const unsigned short halfB = 0x3a00;
+//----------------------------------------------------------------------------//
+std::vector<gpuip::ipc::SharedFrames::Image> lerp_images()
+{
+    const char * names[] = { "buffer1", "buffer2", "buffer3" };
+    std::vector<gpuip::ipc::SharedFrames::Image> images(3);
+    for(size_t i = 0; i < images.size(); ++i) {
+        images[i].buffer = names[i];
+        images[i].offset = i * imageBytes;
+        images[i].type = gpuip::Buffer::HALF;
+        images[i].channels = 4;
+        images[i].output = i == 2;
+    }
+    return images;
+}
+//----------------------------------------------------------------------------//
+void test_shared_frames(const std::string & socketPath)
+{
+    std::cout << "Testing shared memory frames..." << std::endl;
+    gpuip::ipc::SharedFrames frames;
+    std::string err;
+    assert(frames.Open(socketPath, "", 2, 3 * imageBytes, &err));
+    std::vector<gpuip::ipc::SharedFrames::Image> images = lerp_images();
+
+    std::vector<std::vector<std::string> > params(1);
+    params[0].push_back("lerp");
+    params[0].push_back("alpha");
+    params[0].push_back("");
+    for(int alpha = 0; alpha <= 1; ++alpha) {
+        unsigned short * slot = (unsigned short *)frames.Next(&err);
+        assert(slot);
+        std::fill(slot, slot + values, halfA);
+        std::fill(slot + values, slot + 2 * values, halfB);
+        std::fill(slot + 2 * values, slot + 3 * values, 0);
+        params[0][2] = alpha ? "1" : "0";
+        assert(frames.Submit(width, height, images, params, &err));
+        assert(frames.Finish(&err));
+        // The fourth channel is not compared
+        const unsigned short expected = alpha ? halfB : halfA;
+        for(size_t i = 0; i < values; ++i) {
+            assert(i % 4 == 3 || slot[2 * values + i] == expected);
+        }
+    }
+    assert(err.empty());
+
+    // Images that do not fit in a slot are not submitted
+    assert(frames.Next(&err));
+    images[2].offset = 2 * imageBytes + 1;
+    assert(!frames.Submit(width, height, images, params, &err));
+    assert(!err.empty());
+    std::cout << "Test passed!" << std::endl;
+}
+//----------------------------------------------------------------------------//
+// Sends a frame line and returns whether gpuipd processed it
+bool send_frame(int fd,
+                gpuip::ipc::LineReader & reader,
+                size_t outOffset)
+{
+    std::stringstream ss;
+    ss << "frame " << width << " " << height
+       << " in buffer1 0 half 4 in buffer2 " << imageBytes << " half 4"
+       << " out buffer3 " << outOffset << " half 4\n";
+    std::string line;
+    assert(gpuip::ipc::WriteAll(fd, ss.str()));
+    assert(reader.ReadLine(&line));
+    return line.compare(0, 3, "ok ") == 0;
+}
+//----------------------------------------------------------------------------//
+// gpuipd itself rejects images outside their slot, which SharedFrames would
+// not send
+void test_shared_bounds(const std::string & socketPath)
+{
+    std::cout << "Testing shared memory bounds..." << std::endl;
+    const size_t slotBytes = 3 * imageBytes;
+    char name[64];
+    std::sprintf(name, "/gpuip-test-%d", (int)getpid());
+    const int shm = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    assert(shm >= 0);
+    assert(ftruncate(shm, 2 * slotBytes) == 0);
+    close(shm);
+
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    std::string err;
+    assert(gpuip::ipc::SocketAddress(socketPath, &addr, &err));
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    assert(fd >= 0 && connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0);
+    gpuip::ipc::LineReader reader(fd);
+    std::stringstream attach;
+    attach << "attach " << name << " " << slotBytes << "\n";
+    std::string line;
+    assert(gpuip::ipc::WriteAll(fd, attach.str()));
+    assert(reader.ReadLine(&line) && line.compare(0, 3, "ok ") == 0);
+    shm_unlink(name);
+
+    assert(send_frame(fd, reader, 2 * imageBytes));
+    assert(send_frame(fd, reader, slotBytes + 2 * imageBytes));
+    // Across the end of the first slot and past the end of the memory
+    assert(!send_frame(fd, reader, 2 * imageBytes + 2));
+    assert(!send_frame(fd, reader, 2 * slotBytes));
+    assert(send_frame(fd, reader, 2 * imageBytes));
+    close(fd);
+    std::cout << "Test passed!" << std::endl;
+}
+//----------------------------------------------------------------------------//
+int main(int argc, char ** argv)
+{
+    assert(argc == 2);
+    test_shared_frames(argv[1]);
+    test_shared_bounds(argv[1]);
+    return 0;
+}
+//----------------------------------------------------------------------------//
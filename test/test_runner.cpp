@@ -0,0 +1,321 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Per Karlsson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Tests of the native *.ip files, frame sequences and jobs of gpuip-run and
+// gpuipd.
+// Arguments are the *.ip files of the examples.
+#include <settings.h>
+#include <runner.h>
+#include <gpuip_io.h>
+#include <gpuip_synthetic.h>
+// The tests are asserts, keep them in release builds
+#undef NDEBUG
+#include <cassert>
+#include <iostream>
+#include <math.h>
+#include <string>
+#include <vector>
+//----------------------------------------------------------------------------//
+inline bool ends_with(const std::string & s, const std::string & end)
+{
+    return s.size() >= end.size() &&
+            s.compare(s.size() - end.size(), end.size(), end) == 0;
+}
+//----------------------------------------------------------------------------//
+void test_settings(const std::string & file)
+{
+    std::cout << "Testing settings of " << file << "..." << std::endl;
+    gpuip::Settings settings;
+    std::string err;
+    assert(settings.Read(file, &err));
+    assert(err.empty());
+
+    assert(settings.environment == "OpenCL" ||
+           settings.environment == "CUDA" ||
+           settings.environment == "GLSL");
+    assert(!settings.buffers.empty());
+    for(size_t i = 0; i < settings.buffers.size(); ++i) {
+        const gpuip::Settings::Buffer & b = settings.buffers[i];
+        assert(b.type == "half" || b.type == "float" || b.type == "ubyte");
+        assert(b.channels >= 1 && b.channels <= 4);
+        assert(b.input.empty() || b.output.empty());
+    }
+    assert(!settings.kernels.empty());
+    for(size_t i = 0; i < settings.kernels.size(); ++i) {
+        const gpuip::Settings::Kernel & k = settings.kernels[i];
+        assert(!k.code.empty());
+        assert(!k.inBuffers.empty() && !k.outBuffers.empty());
+        for(size_t j = 0; j < k.inBuffers.size(); ++j) {
+            assert(k.inBuffers[j].buffer.empty() ||
+                   settings.GetBuffer(k.inBuffers[j].buffer));
+        }
+        for(size_t j = 0; j < k.outBuffers.size(); ++j) {
+            assert(k.outBuffers[j].buffer.empty() ||
+                   settings.GetBuffer(k.outBuffers[j].buffer));
+        }
+        for(size_t j = 0; j < k.params.size(); ++j) {
+            const gpuip::Settings::Param & p = k.params[j];
+            assert(p.type == "int" || p.type == "float");
+            assert(p.min <= p.value && p.value <= p.max);
+        }
+    }
+    std::cout << "Test passed!" << std::endl;
+}
+//----------------------------------------------------------------------------//
+void test_settings_lerp(const std::string & file)
+{
+    std::cout << "Testing settings values of " << file << "..." << std::endl;
+    gpuip::Settings settings;
+    std::string err;
+    assert(settings.Read(file, &err));
+
+    // Relative paths are resolved against the directory of the file
+    const std::string dir = file.substr(0, file.find_last_of("/\\") + 1);
+    assert(settings.environment == "GLSL");
+    assert(settings.buffers.size() == 3);
+    const gpuip::Settings::Buffer * b1 = settings.GetBuffer("buffer1");
+    assert(b1 && b1->type == "ubyte" && b1->channels == 4);
+    assert(b1->input == dir + "images/lena.png" && b1->output.empty());
+    const gpuip::Settings::Buffer * b3 = settings.GetBuffer("buffer3");
+    assert(b3 && b3->input.empty());
+    assert(b3->output == dir + "output_images/lerp_glsl.png");
+    assert(!settings.GetBuffer("buffer4"));
+
+    gpuip::Settings::Kernel * k = settings.GetKernel("lerp");
+    assert(k && settings.kernels.size() == 1);
+    assert(k->codeFile == dir + "kernels/lerp.glsl");
+    assert(k->radius == 0);
+    assert(k->inBuffers.size() == 2 && k->outBuffers.size() == 1);
+    assert(k->inBuffers[0].name == "a" && k->inBuffers[0].buffer == "buffer1");
+    assert(k->outBuffers[0].buffer == "buffer3");
+    const gpuip::Settings::Param * alpha = k->GetParam("alpha");
+    assert(alpha && alpha->type == "float");
+    assert(alpha->value == 0.35 && alpha->defaultValue == 0.0);
+    assert(!k->GetParam("beta"));
+
+    // A missing file is an error
+    gpuip::Settings missing;
+    assert(!missing.Read(dir + "missing.ip", &err));
+    assert(!err.empty());
+    std::cout << "Test passed!" << std::endl;
+}
+//----------------------------------------------------------------------------//
+void test_frames()
+{
+    std::cout << "Testing frame paths and ranges..." << std::endl;
+    assert(gpuip::FramePath("a_####.exr", 7) == "a_0007.exr");
+    assert(gpuip::FramePath("a_####.exr", 12345) == "a_12345.exr");
+    assert(gpuip::FramePath("a_####.exr", -3) == "a_-003.exr");
+    assert(gpuip::FramePath("a_#", 5) == "a_5");
+    assert(gpuip::FramePath("a_%04d.exr", 7) == "a_0007.exr");
+    assert(gpuip::FramePath("a_%04d.exr", -3) == "a_-003.exr");
+    assert(gpuip::FramePath("a_%d.exr", 42) == "a_42.exr");
+    assert(gpuip::FramePath("dir/a.exr", 7) == "dir/a.exr");
+    assert(gpuip::FramePath("100%.exr", 7) == "100%.exr");
+    assert(gpuip::FramePath("a_%04x.exr", 7) == "a_%04x.exr");
+
+    std::vector<int> frames;
+    std::string err;
+    assert(gpuip::ParseFrames("", &frames, &err));
+    assert(frames.size() == 1 && frames[0] == 0);
+    assert(gpuip::ParseFrames("3", &frames, &err));
+    assert(frames.size() == 1 && frames[0] == 3);
+    assert(gpuip::ParseFrames("1-4", &frames, &err));
+    assert(frames.size() == 4 && frames[0] == 1 && frames[3] == 4);
+    assert(gpuip::ParseFrames("-2-1", &frames, &err));
+    assert(frames.size() == 4 && frames[0] == -2 && frames[3] == 1);
+    assert(gpuip::ParseFrames("-5--3", &frames, &err));
+    assert(frames.size() == 3 && frames[0] == -5 && frames[2] == -3);
+    assert(err.empty());
+    assert(!gpuip::ParseFrames("5-3", &frames, &err));
+    assert(!err.empty());
+    std::cout << "Test passed!" << std::endl;
+}
+//----------------------------------------------------------------------------//
+// 8-bit RGB and RGBA images survive a write and a read, also for widths where
+// the vectorized conversion leaves pixels at the end of the rows
+void test_io_ubyte()
+{
+    std::cout << "Testing 8-bit image io..." << std::endl;
+    const unsigned int widths[] = { 1, 15, 17, 33, 45 };
+    const unsigned int height = 7;
+    for(unsigned int channels = 3; channels <= 4; ++channels) {
+        for(size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w) {
+            const unsigned int width = widths[w];
+            std::vector<unsigned char> data(width * height * channels);
+            for(size_t i = 0; i < data.size(); ++i) {
+                data[i] = (unsigned char)((i * 7 + 13) % 251);
+            }
+            std::string err;
+            assert(gpuip::io::WriteImage(&data[0], gpuip::Buffer::UNSIGNED_BYTE,
+                                         channels, width, height,
+                                         "test_io_ubyte.cimg", &err, 2));
+
+            gpuip::io::ImageReader reader;
+            assert(reader.Open("test_io_ubyte.cimg", &err, 2));
+            assert(reader.Width() == width && reader.Height() == height);
+            std::vector<unsigned char> out(data.size());
+            assert(reader.Read(&out[0], gpuip::Buffer::UNSIGNED_BYTE,
+                               channels, &err));
+            assert(err.empty());
+            assert(out == data);
+        }
+    }
+    std::cout << "Test passed!" << std::endl;
+}
+//----------------------------------------------------------------------------//
+inline bool equal(float a, float b)
+{
+    return fabs(a - b) <= 1e-2f * (1 + fabs(b));
+}
+//----------------------------------------------------------------------------//
+std::vector<float> read_image(const std::string & file,
+                              unsigned int width,
+                              unsigned int height)
+{
+    gpuip::io::ImageReader reader;
+    std::string err;
+    assert(reader.Open(file, &err));
+    assert(reader.Width() == width && reader.Height() == height);
+    std::vector<float> data(width * height * 4);
+    assert(reader.Read(&data[0], gpuip::Buffer::FLOAT, 4, &err));
+    return data;
+}
+//----------------------------------------------------------------------------//
+// Writes a synthetic image and returns its pixels as read back from the file
+std::vector<float> write_synthetic(const std::string & file,
+                                   unsigned int width,
+                                   unsigned int height,
+                                   unsigned int seed)
+{
+    std::vector<float> data(width * height * 4);
+    std::string err;
+    assert(gpuip::synthetic::Generate(&data[0], gpuip::Buffer::FLOAT, 4,
+                                      width, height, gpuip::synthetic::NOISE,
+                                      seed, &err));
+    assert(gpuip::io::WriteImage(&data[0], gpuip::Buffer::FLOAT, 4, width,
+                                 height, file, &err));
+    return read_image(file, width, height);
+}
+//----------------------------------------------------------------------------//
+// out is (1 - alpha) * a + alpha * b, the fourth channel is not compared
+void check_lerp(const std::vector<float> & a,
+                const std::vector<float> & b,
+                const std::vector<float> & out,
+                float alpha)
+{
+    assert(a.size() == out.size() && b.size() == out.size());
+    for(size_t i = 0; i < out.size(); ++i) {
+        if (i % 4 != 3) {
+            assert(equal(out[i], (1 - alpha) * a[i] + alpha * b[i]));
+        }
+    }
+}
+//----------------------------------------------------------------------------//
+// Runs jobs through a lerp example, which blends buffer1 and buffer2 into
+// buffer3 by the param alpha
+void test_runner_jobs(const std::string & file)
+{
+    gpuip::Settings settings;
+    std::string err;
+    assert(settings.Read(file, &err));
+    const gpuip::GpuEnvironment env = settings.environment == "OpenCL" ?
+            gpuip::OpenCL : (settings.environment == "CUDA" ?
+                             gpuip::CUDA : gpuip::GLSL);
+    if (!gpuip::ImageProcessor::CanCreate(env)) {
+        return;
+    }
+    std::cout << "Testing runner jobs with " << file << "..." << std::endl;
+    const float value = settings.GetKernel("lerp")->GetParam("alpha")->value;
+    assert(value != 1);
+
+    gpuip::Runner runner;
+    assert(runner.Init(file, 1, &err));
+
+    const std::vector<float> a = write_synthetic("test_runner_a.exr",
+                                                 64, 48, 1);
+    const std::vector<float> b = write_synthetic("test_runner_b.exr",
+                                                 64, 48, 2);
+    gpuip::Runner::Job job;
+    job.inputs["buffer1"] = "test_runner_a.exr";
+    job.inputs["buffer2"] = "test_runner_b.exr";
+    job.outputs["buffer3"] = "test_runner_out.exr";
+    std::vector<std::string> alpha(3);
+    alpha[0] = "lerp";
+    alpha[1] = "alpha";
+    alpha[2] = "1";
+    job.params.push_back(alpha);
+    assert(runner.Run(job, &err) != GPUIP_ERROR);
+    check_lerp(a, b, read_image("test_runner_out.exr", 64, 48), 1);
+
+    // A job without params gets the values of the file, not the last job
+    job.params.clear();
+    assert(runner.Run(job, &err) != GPUIP_ERROR);
+    check_lerp(a, b, read_image("test_runner_out.exr", 64, 48), value);
+
+    // Inputs of a new size reallocate the buffers
+    const std::vector<float> a2 = write_synthetic("test_runner_a2.exr",
+                                                  40, 30, 3);
+    const std::vector<float> b2 = write_synthetic("test_runner_b2.exr",
+                                                  40, 30, 4);
+    job.inputs["buffer1"] = "test_runner_a2.exr";
+    job.inputs["buffer2"] = "test_runner_b2.exr";
+    alpha[2] = "0";
+    job.params.push_back(alpha);
+    assert(runner.Run(job, &err) != GPUIP_ERROR);
+    check_lerp(a2, b2, read_image("test_runner_out.exr", 40, 30), 0);
+
+    // Unknown buffers and params fail the job, as do inputs of different sizes
+    gpuip::Runner::Job bad = job;
+    bad.inputs["buffer2"] = "test_runner_b.exr";
+    assert(runner.Run(bad, &err) == GPUIP_ERROR);
+    bad = job;
+    bad.outputs["buffer4"] = "test_runner_out.exr";
+    assert(runner.Run(bad, &err) == GPUIP_ERROR);
+    bad = job;
+    bad.params[0][1] = "beta";
+    assert(runner.Run(bad, &err) == GPUIP_ERROR);
+    assert(!err.empty());
+    std::cout << "Test passed!" << std::endl;
+}
+//----------------------------------------------------------------------------//
+int main(int argc, char ** argv)
+{
+    for(int i = 1; i < argc; ++i) {
+        test_settings(argv[i]);
+        if (ends_with(argv[i], "lerp_glsl_ubyte.ip")) {
+            test_settings_lerp(argv[i]);
+        }
+        if (ends_with(argv[i], "lerp_opencl.ip") ||
+            ends_with(argv[i], "lerp_cuda.ip") ||
+            ends_with(argv[i], "lerp_glsl.ip")) {
+            test_runner_jobs(argv[i]);
+        }
+    }
+
+    test_frames();
+    test_io_ubyte();
+    return 0;
+}
+//----------------------------------------------------------------------------//